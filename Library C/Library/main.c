@@ -10,7 +10,14 @@
     - Borrowing and returning books, and viewing the borrowing list;
     - Listing available and borrowed books.
 
-    All data is stored in corresponding .txt files.
+    All data is stored in corresponding .txt files. The files are loaded
+    once at startup into a resident in-memory store; reads are served from
+    memory. Changes are appended to an operation log (library.log) which is
+    periodically compacted back into the .txt files.
+
+    Optionally the data can be kept in a binary format (.bin files) that is
+    memory-mapped on startup; see the BINARY FORMAT section and the
+    --to-binary / --to-text command line options.
     Prepared in accordance with the project guidelines.
 */
 
@@ -18,14 +25,79 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 
-#define MAX_BOOKS 100
-#define MAX_MEMBERS 100
-#define MAX_BORROWS 100
+#define TABLE_INITIAL_CAPACITY 64
+#define INDEX_INITIAL_CAPACITY 64
+#define INDEX_EMPTY            SIZE_MAX   // Marks an unused index slot
+#define INDEX_NOT_FOUND        SIZE_MAX   // Returned when a key is not indexed
 
 #define BOOKS_FILE   "books.txt"
 #define MEMBERS_FILE "members.txt"
 #define BORROWS_FILE "borrows.txt"
+#define LOG_FILE     "library.log"
+#define LOCK_FILE    "library.lock"
+#define SAVE_FILE    "library.save" // Present while the data files are being replaced
+#define SNAPSHOT_FILE "library.snap" // The built store at a point of the log (see SNAPSHOT)
+#define TEMP_SUFFIX  ".tmp"
+
+#define BOOKS_BIN_FILE   "books.bin"
+#define MEMBERS_BIN_FILE "members.bin"
+#define BORROWS_BIN_FILE "borrows.bin"
+
+#define BINARY_FORMAT_VERSION 4
+#define SNAPSHOT_FORMAT_VERSION 2
+
+#define ARCHIVE_DIR            "archive"
+#define ARCHIVE_FORMAT_VERSION 1
+#define ARCHIVE_COMPRESSED     1u  // ArchiveHeader.flags: varint records + member dictionary
+
+#define DATE_OPEN        INT32_MIN // Borrow.returnDay of a loan that is not returned yet
+#define MEMBER_NONE      UINT64_MAX // Not a member key: invalid ID text, or "any member" in queries
+#define LOAN_PERIOD_DAYS 15        // Days a book may be kept before the loan is overdue
+#define DEFAULT_LOAN_LIMIT 0       // Books a member may have on loan at the same time, 0 for no limit
+
+#define MAX_TEXT_FIELDS          8   // Most '|' separated fields on a data file line
+#define MAX_TEXT_BYTES           1000 // Longest title, author, name or phone (UTF-8 bytes)
+#define PARSE_ERROR_REPORT_LIMIT 10  // Malformed lines reported individually per file
+
+#define MAX_TOKEN_BYTES  64  // Longest indexed word (UTF-8 bytes, including '\0')
+#define MAX_BOOK_TOKENS  128 // Most distinct words indexed per book (title + author)
+#define MAX_QUERY_TOKENS 16
+
+#define BATCH_OUTPUT_BUFFER (1 << 20)
+#define LIST_PAGE_LIMIT     100 // Records per page of the "list" batch command by default
+#define LIST_SCREEN_ROWS    20  // Lines the interactive listings show before pausing
+#define SERVER_SOCKET       "library.sock"
+#define IMPORT_RECORD_SIZE  4096     // Longest accepted CSV/TSV record (bytes)
+
+#define LOG_COMPACT_THRESHOLD 1000 // Minimum logged operations before the log is folded into the data files
+#define LOG_LINE_SIZE         4096 // Fits a book or member entry with MAX_TEXT_BYTES fields
+#define COMMIT_WINDOW_US      0    // Default wait for more commits to share one fsync (group commit)
+#define CHECKPOINT_THRESHOLD  1000 // Log entries past the snapshot that make an exit write a new one
+
+#ifndef LIBRARY_STATS
+#define LIBRARY_STATS 1 // Build with -DLIBRARY_STATS=0 to compile the statistics out
+#endif
+#define STATS_FILE    "library.stats"
+#define STATS_BUCKETS 40 // Latency histogram buckets, powers of two from 1 ns
+#define STATS_SAMPLE  16 // Index lookups cost about as much as a clock read: time one in this many
 
 /*
  * STRUCT DEFINITIONS
@@ -33,62 +105,1016 @@
  * Book:   Holds information about a single book (ID, title, author, status).
  * Member: Holds information about a single member (ID, name, phone).
  * Borrow: Holds information about borrowing a book (which book, which member, dates).
+ *
+ * Dates are stored as day numbers (days since 01/01/1970, see parseDate) so
+ * they can be compared and subtracted directly; they are converted to and
+ * from dd/mm/yyyy only when reading input and writing files or output.
+ * Member IDs (always 11 digits) are likewise stored as the number they
+ * spell (see memberKey) and only written out as text.
  */
 
 typedef struct {
-    int  ID;             // Book ID
-    char title[100];     // Book title
-    char author[100];    // Book author
-    int  status;         // 1: available, 0: borrowed
+    int      ID;         // Book ID
+    int      status;     // 1: available, 0: borrowed
+    uint32_t title;      // Book title, offset in library.bookText
+    uint32_t author;     // Book author, offset in library.bookText
 } Book;
 
 typedef struct {
-    char ID[12];         // Member ID number (11 digits + 1 null terminator)
-    char name[50];       // Member name
-    char phone[20];      // Phone number
+    uint64_t ID;         // Member ID number as a member key
+    uint32_t name;       // Member name, offset in library.memberText
+    uint32_t phone;      // Phone number, offset in library.memberText
 } Member;
 
 typedef struct {
-    int  bookID;         // ID of the borrowed book
-    char memberID[12];   // ID number of the member who borrowed the book (11 digits)
-    char borrowDate[11]; // Borrow date (format dd/mm/yyyy: 10 chars + '\0')
-    char returnDate[11]; // Return date (format dd/mm/yyyy: 10 chars + '\0')
+    uint64_t memberID;   // Member key of the member who borrowed the book
+    int      bookID;     // ID of the borrowed book
+    int32_t  borrowDay;  // Borrow date as a day number
+    int32_t  returnDay;  // Return date as a day number, DATE_OPEN if not returned
 } Borrow;
 
+/*
+ * RECORD TABLES
+ * -------------
+ * Heap-allocated arrays that grow geometrically (capacity doubles when full),
+ * so appending is amortized O(1) and memory stays proportional to the number
+ * of records actually loaded. There is no upper limit on the record count.
+ */
+
+typedef struct {
+    Book  *items;
+    size_t count;
+    size_t capacity;
+} BookTable;
+
+typedef struct {
+    Member *items;
+    size_t  count;
+    size_t  capacity;
+} MemberTable;
+
+typedef struct {
+    Borrow *items;
+    size_t  count;
+    size_t  capacity;
+} BorrowTable;
+
+/*
+ * PRIMARY-KEY INDEXES
+ * -------------------
+ * Open-addressing hash tables (linear probing, backward-shift deletion) that
+ * map a record key to its row in a table. Each slot keeps the full 64-bit
+ * hash next to the row number, so a probe sequence walks one contiguous
+ * array and only touches the record itself to confirm a hash match.
+ */
+
+typedef struct {
+    uint64_t hash;       // Hash of the record key
+    size_t   row;        // Row in the record table, INDEX_EMPTY if unused
+} IndexSlot;
+
+typedef struct {
+    IndexSlot *slots;
+    size_t     count;    // Number of occupied slots
+    size_t     capacity; // Always a power of two
+} RowIndex;
+
+// Returns non-zero if the record at `row` has the key pointed to by `key`
+typedef int (*RowMatcher)(size_t row, const void *key);
+
+/*
+ * STRING ARENA
+ * ------------
+ * The text of the books and of the members (titles, authors, names,
+ * phones) is kept out of the records, as NUL-terminated strings packed one
+ * after another in a growing byte array; a record holds the 32-bit offset
+ * of each of its strings. Equal strings are stored once (interned), so a
+ * record is a few small fixed-size fields, text has no per-field size
+ * limit, and an author or name shared by many records costs one copy.
+ * Offset 0 is always the empty string.
+ */
+
+typedef struct {
+    char    *bytes;
+    size_t   length;     // Bytes in use
+    size_t   capacity;
+    RowIndex lookup;     // String hash -> offset, built on first use
+} StringArena;
+
+/*
+ * OPEN LOANS
+ * ----------
+ * The borrow table keeps the whole history, but only the loans that are not
+ * yet returned matter for circulation. Their rows are kept in a dense array
+ * (so they can be listed in O(open loans)) with a hash index from book ID to
+ * position in that array (so a book's open loan is found in O(1)).
+ *
+ * A second array keeps the same loans ordered by borrow date, so loans
+ * borrowed before or between given days (overdue and due-soon reports) are
+ * found by binary search and a scan over just the matching range. Like the
+ * sorted views it is kept in order lazily (see OPEN LOANS), so a borrow or
+ * return does not shift the array.
+ */
+
+typedef struct {
+    int32_t borrowDay;
+    int     bookID;
+} LoanDate;
+
+typedef struct {
+    size_t   *rows;      // Borrow table rows of the open loans
+    size_t    count;
+    size_t    capacity;
+    RowIndex  byBook;    // Borrow.bookID -> position in rows
+    LoanDate *byDate;    // The open loans ordered by (borrowDay, bookID), see openLoanDateBound
+    size_t    dated;     // Entries in byDate, returned loans not yet dropped included
+    size_t    datedSorted; // byDate[0, datedSorted) are in order; the rest were added since
+    size_t    returned;  // Loans returned since the order was last restored
+    size_t    dateCapacity;
+} OpenLoans;
+
+/*
+ * AVAILABILITY
+ * ------------
+ * A bitset parallel to the book table: bit `row` is set when the book in
+ * that row is available. It is kept in step with Book.status, together
+ * with the number of set bits, so the availability counts are O(1) and the
+ * available/borrowed listings skip whole words of the other kind instead
+ * of reading every Book.
+ */
+
+typedef struct {
+    uint64_t *words;
+    size_t    capacity;  // Words allocated
+    size_t    available; // Number of set bits
+} Availability;
+
+/*
+ * MEMBER LOANS
+ * ------------
+ * Adjacency index from a member to all of their borrow records, open and
+ * returned. Each member with at least one loan has a list head found by
+ * hashing the member ID; the borrow rows of a member are chained through
+ * `next`, a link array parallel to the borrow table, in the order they were
+ * recorded. Walking a member's loans therefore costs O(that member's loans)
+ * and the per-member open loan count makes the loan limit an O(1) check.
+ * Borrow rows are never removed, so the chains never need unlinking.
+ */
+
+typedef struct {
+    size_t   first;      // First borrow row of the member
+    size_t   last;       // Last borrow row of the member
+    uint32_t total;      // Number of borrow records
+    uint32_t open;       // Number of them not yet returned
+} MemberLoanList;
+
+typedef struct {
+    MemberLoanList *lists;
+    size_t          count;
+    size_t          capacity;
+    RowIndex        byMember;     // Borrow.memberID -> position in lists
+    size_t         *next;         // Borrow row -> next row of the same member, INDEX_EMPTY at the end
+    size_t          nextCapacity;
+} MemberLoans;
+
+/*
+ * TEXT INDEX
+ * ----------
+ * Inverted index over the words of Book.title and Book.author. Every distinct
+ * (case-folded) word is a term with a posting list of the book IDs that
+ * contain it, kept sorted so lists can be intersected by merging. Terms are
+ * found by hash for exact words and through an alphabetically sorted term
+ * list for prefix searches.
+ */
+
+typedef struct {
+    int   *ids;
+    size_t count;
+    size_t capacity;
+} IdList;
+
+typedef struct {
+    char  *text;         // Case-folded UTF-8 word
+    IdList postings;     // Sorted IDs of the books containing the word
+} Term;
+
+typedef struct {
+    Term     *terms;
+    size_t    count;
+    size_t    capacity;
+    RowIndex  lookup;    // Term text -> position in terms
+    uint32_t *sorted;    // Term positions in strcmp order of their text
+} TextIndex;
+
+/*
+ * SORTED VIEWS
+ * ------------
+ * Book titles, book authors and member names in Turkish alphabetical order
+ * (see SORTED VIEWS). Every entry carries the collation key of its text,
+ * computed once and interned in library.collation, so keeping the order
+ * and searching an alphabetical range only compare bytes. Entries are
+ * ordered by key, then ID.
+ */
+
+typedef enum {
+    VIEW_TITLES,         // Books by Book.title
+    VIEW_AUTHORS,        // Books by Book.author
+    VIEW_NAMES,          // Members by Member.name
+    SORTED_VIEWS
+} SortedViewId;
+
+typedef struct {
+    uint32_t key;        // Collation key, offset in library.collation
+    uint32_t text;       // The text itself, offset in library.bookText or library.memberText
+    uint64_t ID;         // Book.ID or Member.ID
+} ViewEntry;
+
+typedef struct {
+    ViewEntry *entries;
+    size_t     count;
+    size_t     capacity;
+    size_t     sorted;   // entries[0, sorted) are in order; the rest were added since
+    size_t     stale;    // Records removed since the order was last restored
+} SortedView;
+
+/*
+ * LISTING CURSOR
+ * --------------
+ * A listing that is read one matching record at a time (see LISTINGS), so
+ * a page costs O(page) and an export never materializes the result. The
+ * position is a table row, or for open loans alone a position in the
+ * date-ordered open loan index; it can be handed back later to continue.
+ */
+
+typedef enum {
+    LIST_BOOKS,
+    LIST_MEMBERS,
+    LIST_BORROWS
+} ListKind;
+
+typedef struct {
+    ListKind kind;
+    int      status;     // Books: 1 available, 0 borrowed; borrows: 1 open, 0 returned; -1 any
+    uint32_t author;     // Books: author offset in library.bookText, 0 for any
+    uint64_t memberID;   // Borrows: member key, MEMBER_NONE for any
+    int32_t  fromDay;    // Borrows: earliest borrow day
+    int32_t  toDay;      // Borrows: latest borrow day
+    size_t   limit;      // Records per page, 0 for no limit
+    size_t   position;   // Where the search for the next match resumes
+    int      view;       // Books and members: SortedViewId to list in, -1 for table order
+    char     prefix[MAX_TOKEN_BYTES]; // Collation key the sorted text starts with, "" for any
+    int      done;       // 1: no more matches
+} ListCursor;
+
+// Pauses an interactive listing every screenful (see pagerLine)
+typedef struct {
+    size_t shown;        // Lines printed so far
+    size_t screenRows;   // Lines per pause, 0 when output is not a terminal
+    int    stopped;      // 1: the user asked to stop
+} Pager;
+
+/*
+ * RESIDENT STORE
+ * --------------
+ * All records are loaded from disk once at startup (see loadLibrary) and kept
+ * in memory for the lifetime of the program. Every operation reads from this
+ * store; mutations are applied in memory and appended to the operation log.
+ * Several threads and several processes (circulation desks) may share the
+ * store and its files; see CONCURRENCY.
+ */
+
+typedef struct {
+    BookTable   books;
+    MemberTable members;
+    BorrowTable borrows;
+    RowIndex    bookIndex;   // Book.ID   -> row in books
+    RowIndex    memberIndex; // Member.ID -> row in members
+    TextIndex   textIndex;   // Title/author words -> book IDs
+    OpenLoans   openLoans;   // Book.ID -> its not yet returned borrow record
+    MemberLoans memberLoans; // Member ID -> all of the member's borrow records
+    Availability availability; // Book row -> available bit
+    StringArena bookText;    // Titles and authors of the books
+    StringArena memberText;  // Names and phones of the members
+    SortedView  views[SORTED_VIEWS]; // Alphabetical orders of the books and members
+    StringArena collation;   // Collation keys of the sorted texts
+    FILE       *log;         // Operation log, open for appending
+    size_t      logEntries;  // Operations logged since the last compaction
+    size_t      uncommitted; // Operations logged since the last commit
+    int         deferCommit; // 1: log writes are only flushed by commitLog (batch mode)
+    int         binaryFormat;// 1: data files are the .bin files, 0: the .txt files
+
+    pthread_rwlock_t lock;          // Readers share it, writers hold it exclusively
+    int              lockFd;        // LOCK_FILE, flock()ed across processes
+    int              fileLocked;    // 1: this process holds the exclusive file lock
+    uint64_t         logGeneration; // Compaction count recorded in the log's "G" line
+    long             logOffset;     // Log bytes already applied to the store
+    uint64_t         logVersion;    // Commit counter in LOCK_FILE when the log was last applied
+    long             snapshotOffset;  // Log offset of the newest known snapshot, -1 if none
+    size_t           snapshotEntries; // logEntries at that offset
+
+    pthread_mutex_t  syncLock;      // Guards the group commit fields below
+    pthread_cond_t   synced;        // Signalled when durableSeq advances
+    uint64_t         commitSeq;     // Commits written to the log file
+    uint64_t         durableSeq;    // Commits known to be on disk
+    int              logFailed;     // 1: a log write or fsync failed; later commits are not durable
+    int              syncing;       // 1: a thread is running the fsync for a group
+    double           commitWindow;  // Seconds an fsync waits for more commits to join it
+} Library;
+
+/*
+ * OPERATION STATUS
+ * ----------------
+ * Result of a core operation (see CORE OPERATIONS). The interactive menu
+ * turns it into a message; batch mode prints its name.
+ */
+
+typedef enum {
+    LIB_OK = 0,
+    LIB_ERR_INVALID,       // Malformed or out-of-range argument
+    LIB_ERR_EXISTS,        // A record with this ID already exists
+    LIB_ERR_NO_BOOK,       // No book with this ID
+    LIB_ERR_NO_MEMBER,     // No member with this ID
+    LIB_ERR_BORROWED,      // The book is on loan (cannot be borrowed or deleted)
+    LIB_ERR_NOT_BORROWED,  // The book has no open loan
+    LIB_ERR_LIMIT,         // The member already has loanLimit books on loan
+    LIB_ERR_IO             // Applied in memory, but the log could not be written to disk
+} LibStatus;
+
+/*
+ * OPERATION STATISTICS
+ * --------------------
+ * Call counts and a latency histogram for every core operation and for
+ * the I/O phases inside them (see STATISTICS). Bucket b counts the calls
+ * that took less than 2^b nanoseconds (and at least 2^(b-1)).
+ */
+
+typedef enum {
+    STAT_ADD_BOOK,
+    STAT_DELETE_BOOK,
+    STAT_ADD_MEMBER,
+    STAT_BORROW,
+    STAT_RETURN,
+    STAT_SEARCH,
+    STAT_LOAD,       // Loading the whole store
+    STAT_SAVE,       // Writing the whole store (compaction)
+    STAT_CHECKPOINT, // Writing a snapshot
+    STAT_REPLAY,     // Applying log entries
+    STAT_PARSE,      // Phase: reading one data file
+    STAT_LOOKUP,     // Phase: one index lookup (sampled, see STATS_SAMPLE)
+    STAT_WRITE,      // Phase: writing one log entry or data file
+    STAT_SYNC,       // Phase: one fsync (see DURABILITY)
+    STAT_LOCK_WAIT,  // Phase: waiting for the write lock
+    STAT_COUNT
+} StatId;
+
+typedef struct {
+    uint64_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t buckets[STATS_BUCKETS];
+} StatHistogram;
+
+#if LIBRARY_STATS
+#define STAT_START()                   statNow()
+#define STAT_RECORD(id, start)         statRecord((id), statNow() - (start))
+#define STAT_START_SAMPLED()           statSample()
+#define STAT_RECORD_SAMPLED(id, start) do { if(start) STAT_RECORD(id, start); } while(0)
+#else
+#define STAT_START()                   0
+#define STAT_RECORD(id, start)         ((void)(start))
+#define STAT_START_SAMPLED()           0
+#define STAT_RECORD_SAMPLED(id, start) ((void)(start))
+#endif
+
+/*
+ * BINARY FILE HEADER
+ * ------------------
+ * A .bin file is this header followed by `count` records of `recordSize`
+ * bytes each, laid out exactly like the in-memory struct, and then the
+ * table's string arena (`stringSize` bytes; none for borrows).
+ */
+
+typedef struct {
+    char     magic[4];   // "BOOK", "MEMB" or "BORR"
+    uint32_t version;    // BINARY_FORMAT_VERSION
+    uint32_t recordSize; // sizeof(Book), sizeof(Member) or sizeof(Borrow)
+    uint32_t reserved;   // Always 0
+    uint64_t count;      // Number of records
+    uint64_t checksum;   // checksum64() of the record bytes
+    uint64_t stringSize; // Bytes of string arena after the records
+    uint64_t stringChecksum; // checksum64() of the string bytes
+} BinaryHeader;
+
+/*
+ * ARCHIVE SEGMENT HEADER
+ * ----------------------
+ * An archive segment (see ARCHIVE) is this header followed by `payloadSize`
+ * bytes: either `count` ArchivedBorrow records, or, if ARCHIVE_COMPRESSED is
+ * set, a member ID dictionary followed by varint-encoded loans.
+ */
+
+typedef struct {
+    char     magic[4];    // "BARC"
+    uint32_t version;     // ARCHIVE_FORMAT_VERSION
+    uint32_t flags;       // ARCHIVE_COMPRESSED or 0
+    uint32_t memberCount; // Entries in the member dictionary
+    uint64_t count;       // Number of loans
+    int32_t  firstDay;    // Earliest borrow day in the segment
+    int32_t  lastDay;     // Latest borrow day in the segment
+    uint64_t payloadSize; // Bytes following the header
+    uint64_t checksum;    // checksum64() of the payload
+} ArchiveHeader;
+
+// A loan as stored in an uncompressed segment, member ID as text
+typedef struct {
+    int     bookID;
+    char    memberID[12];
+    int32_t borrowDay;
+    int32_t returnDay;
+} ArchivedBorrow;
+
+// Called for every archived loan that matches a history query
+typedef void (*ArchiveVisitor)(const Borrow *borrow, void *ctx);
+
+/*
+ * SNAPSHOT FILE
+ * -------------
+ * A snapshot (see SNAPSHOT) is this header followed by the sections listed
+ * in SnapshotSectionId, in that order: the record tables, the string arenas
+ * and every index, each laid out exactly like its in-memory array.
+ */
+
+typedef enum {
+    SNAP_BOOKS,              // Book
+    SNAP_MEMBERS,            // Member
+    SNAP_BORROWS,            // Borrow
+    SNAP_BOOK_TEXT,          // library.bookText bytes
+    SNAP_MEMBER_TEXT,        // library.memberText bytes
+    SNAP_BOOK_TEXT_LOOKUP,   // IndexSlot, empty if not built yet
+    SNAP_MEMBER_TEXT_LOOKUP, // IndexSlot, empty if not built yet
+    SNAP_BOOK_INDEX,         // IndexSlot
+    SNAP_MEMBER_INDEX,       // IndexSlot
+    SNAP_AVAILABILITY,       // uint64_t bitset words
+    SNAP_OPEN_ROWS,          // size_t
+    SNAP_OPEN_DATES,         // LoanDate
+    SNAP_OPEN_BY_BOOK,       // IndexSlot
+    SNAP_LOAN_LISTS,         // MemberLoanList
+    SNAP_LOAN_NEXT,          // size_t, one per borrow record
+    SNAP_LOAN_BY_MEMBER,     // IndexSlot
+    SNAP_TERMS,              // SnapshotTerm
+    SNAP_TERM_TEXT,          // Term texts, back to back without NULs
+    SNAP_POSTINGS,           // int, the posting lists back to back
+    SNAP_TERM_ORDER,         // uint32_t, TextIndex.sorted
+    SNAP_TERM_LOOKUP,        // IndexSlot
+    SNAP_COLLATION,          // library.collation bytes
+    SNAP_COLLATION_LOOKUP,   // IndexSlot, empty if not built yet
+    SNAP_TITLE_VIEW,         // ViewEntry
+    SNAP_AUTHOR_VIEW,        // ViewEntry
+    SNAP_NAME_VIEW,          // ViewEntry
+    SNAP_SECTIONS
+} SnapshotSectionId;
+
+typedef struct {
+    uint64_t count;      // Elements; occupied slots for an index section
+    uint64_t size;       // Bytes in the file
+    uint64_t checksum;   // checksum64() of those bytes
+} SnapshotSection;
+
+// Identity of a data file, to tell whether it was replaced or edited
+typedef struct {
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime;
+} FileStamp;
+
+typedef struct {
+    char      magic[4];      // "SNAP"
+    uint32_t  version;       // SNAPSHOT_FORMAT_VERSION
+    uint32_t  wordSize;      // sizeof(size_t) of the writer
+    uint32_t  binaryFormat;  // library.binaryFormat of the data files below
+    FileStamp files[3];      // The books, members and borrows data files
+    uint64_t  generation;    // Log generation the snapshot belongs to
+    uint64_t  logOffset;     // Log bytes whose operations it includes
+    uint64_t  logEntries;    // library.logEntries at that point
+    SnapshotSection sections[SNAP_SECTIONS];
+} SnapshotHeader;
+
+// A text index term in SNAP_TERMS
+typedef struct {
+    uint32_t textLength; // Bytes of its text in SNAP_TERM_TEXT
+    uint32_t postings;   // IDs of its posting list in SNAP_POSTINGS
+} SnapshotTerm;
+
+/*
+ * TEXT FIELDS
+ * -----------
+ * The text parser does not copy lines; a field is a pointer into the mapped
+ * file plus its length.
+ */
+
+typedef struct {
+    const char *start;
+    size_t      length;
+} TextField;
+
+// Converts the fields of one line into a record and appends it to `table`.
+// Returns NULL on success or a short description of what is wrong.
+typedef const char *(*RecordParser)(const TextField fields[], void *table);
+
+/*
+ * STRESS TEST WORKER
+ * ------------------
+ * State of one thread of the concurrency stress test (see STRESS TEST).
+ */
+
+typedef struct {
+    unsigned      seed;         // rand_r() state
+    int           writer;       // 1: borrows and returns books, 0: reads
+    double        until;        // Readers stop at this time...
+    volatile int *stop;         // ...or once this is set
+    size_t        reads;
+    size_t        inconsistent; // Reads that saw a book status and open loan disagree
+    size_t        borrowed;     // Successful borrows of a writer
+    size_t        returned;     // Successful returns of a writer
+} StressWorker;
+
+/*
+ * SERVER CONNECTION
+ * -----------------
+ * One client of the server (see SERVER MODE): bytes received but not yet
+ * run as commands, and responses not yet written back.
+ */
+
+typedef struct {
+    int     fd;
+    char   *in;          // Received, not yet complete or processed request bytes
+    size_t  inLength;
+    size_t  inCapacity;
+    char   *out;         // Responses not yet written
+    size_t  outLength;
+    size_t  outCapacity;
+    size_t  outReady;    // Bytes of `out` answering committed requests, which may be sent
+    size_t  outSent;     // Bytes of `out` already written
+    size_t  requests;    // Requests answered; numbers the response lines
+    int     closing;     // 1: the client hung up, drop it once `out` is sent
+} ServerClient;
+
+/*
+ * LOAD GENERATOR WORKER
+ * ---------------------
+ * One connection of the load generator and the latencies it measured.
+ */
+
+typedef struct {
+    const char *socketPath;
+    size_t      requests;    // Requests to send
+    size_t      depth;       // Requests kept in flight (pipelining)
+    int         books;       // Book IDs used are 1..books
+    int         members;     // Member IDs used are the first `members` generated ones (generateMemberID)
+    int         writePercent;// Share of borrow/return requests
+    unsigned    seed;
+    double     *searchLatency, *writeLatency;
+    size_t      searches, writes;
+    size_t      ok, errors;
+    int         failed;      // 1: the connection broke
+} LoadWorker;
+
+/*
+ * LOAN COLUMNS
+ * ------------
+ * Borrow records in columnar form for the analytics (see ANALYTICS): one
+ * array per Borrow field, so a scan streams through exactly the fields it
+ * aggregates.
+ */
+
+typedef struct {
+    int      *bookID;
+    uint64_t *memberID;
+    int32_t  *borrowDay;
+    int32_t  *returnDay;
+    size_t    count;
+    size_t    capacity;  // Capacity of every column
+} LoanColumns;
+
+/*
+ * ANALYTICS
+ * ---------
+ * Loan counts by key (book ID, member key or month number), as an
+ * open-addressing table like RowIndex, and the per-thread state of an
+ * analytics run (see ANALYTICS). Every worker splits what it counts into
+ * one partition per worker by key hash; worker p then merges partition p
+ * of all workers, so the merge runs in parallel too.
+ */
+
+typedef struct {
+    uint64_t key;
+    uint64_t hash;       // Hash of the key
+    uint64_t count;      // Loans, 0 if the slot is unused
+} KeyCount;
+
+typedef struct {
+    KeyCount *slots;
+    size_t    used;      // Number of occupied slots
+    size_t    capacity;  // Always a power of two
+} CountTable;
+
+// What one worker counted, split into partitions by key hash
+typedef struct {
+    CountTable *books;   // Book ID -> loans
+    CountTable *members; // Member key -> loans
+    CountTable *months;  // Month number (see loanMonth) -> loans
+    uint64_t    loans;
+    uint64_t    returned;// Loans with a return date
+    int64_t     loanDays;// Days the returned loans were kept, summed
+} LoanAggregate;
+
+typedef struct AnalyticsRun AnalyticsRun;
+
+typedef struct {
+    AnalyticsRun *run;
+    int           index;      // Worker number, also the partition it merges
+    size_t        from, to;   // Its slice of the copied borrow table
+    LoanAggregate partial;    // The loans it scanned
+    CountTable    books, members, months; // Partition `index` of all partials, merged
+    KeyCount     *topBooks, *topMembers;  // The best of the merged partition
+    size_t        topBookCount, topMemberCount;
+} AnalyticsWorker;
+
+struct AnalyticsRun {
+    LoanColumns      table;        // The borrow table, copied under the read lock
+    char           **segments;     // Archive segment names
+    size_t           segmentCount;
+    size_t           nextSegment;  // Next segment a worker may take, under segmentLock
+    pthread_mutex_t  segmentLock;
+    int32_t          fromDay;      // Borrow day range of the report
+    int32_t          toDay;
+    size_t           top;          // Length of the top books and members lists
+    int              threads;
+    AnalyticsWorker *workers;
+};
+
+// Result of an analytics run
+typedef struct {
+    int32_t   fromDay, toDay;
+    uint64_t  loans;
+    uint64_t  returned;
+    int64_t   loanDays;
+    size_t    books;         // Distinct books borrowed
+    size_t    members;       // Distinct members who borrowed
+    KeyCount *topBooks;      // Most loans first (key: book ID)
+    KeyCount *topMembers;    // Most loans first (key: member key)
+    KeyCount *months;        // Oldest month first (key: month number)
+    size_t    topBookCount, topMemberCount, monthCount;
+    int       threads;
+    double    seconds;
+} LoanReport;
+
+static Library library;
+static int     loanLimit = DEFAULT_LOAN_LIMIT; // --loan-limit, 0 for no limit
+static StatHistogram stats[STAT_COUNT];
+
 /* -- FUNCTION PROTOTYPES -- */
 
+// Store operations
+void    loadLibrary();
+void    freeLibrary();
+Book   *insertBook(const Book *book);
+void    removeBook(size_t row);
+Member *insertMember(const Member *member);
+Borrow *insertBorrow(const Borrow *borrow);
+Borrow *findOpenBorrow(int bookID);
+void    closeBorrow(Borrow *borrow, int32_t returnDay);
+
+// Core operations
+LibStatus   libAddBook(int id, const char *title, const char *author);
+LibStatus   libDeleteBook(int id);
+LibStatus   libAddMember(const char *id, const char *name, const char *phone);
+LibStatus   libBorrowBook(int bookID, const char *memberID, const char *borrowDate);
+LibStatus   libReturnBook(int bookID, const char *returnDate);
+const char *statusName(LibStatus status);
+const char *statusMessage(LibStatus status);
+
+// Operation log
+static void     commitLocked();
+static void     compactLocked();
+static int      compactWithFiles(const char *const extra[], int extraCount);
+static void     releaseFileLock();
+static uint64_t readLogVersion();
+static uint64_t logFileGeneration(FILE *fp);
+static long     logSize();
+static void     trimLog();
+static void     removeTempFiles();
+static int      replaceDataFiles(const char *const paths[], int count, uint64_t generation);
+static void     finishSave(uint64_t generation);
+static void     recoverFiles();
+void   openLog();
+void   closeLog();
+size_t replayLog(FILE *fp);
+void   logOperation(const char *fmt, ...);
+int    commitLog();
+void   compactLibrary();
+
+// Statistics
+uint64_t statNow();
+uint64_t statSample();
+void     statRecord(StatId id, uint64_t ns);
+void     printStats(FILE *out);
+void     dumpStats();
+
+// Concurrency
+void beginRead();
+void endRead();
+void beginWrite();
+int  endWrite();
+void refreshLibrary();
+
+// Durability
+int  syncFile(int fd);
+void syncDirectory(const char *path);
+int  closeDurable(FILE *fp, const char *path);
+int  waitDurable(uint64_t seq);
+
+// Binary format
+int      saveLibraryFiles(uint64_t generation, const char *const extra[], int extraCount);
+void    *mapFile(const char *path, size_t *size);
+void     unmapFile(void *map, size_t size);
+uint64_t checksum64(const void *data, size_t size);
+int      loadBinaryFile(const char *path, const char magic[4], size_t recordSize,
+                        void **items, size_t *count, size_t *capacity, StringArena *strings);
+int      saveBinaryFile(const char *path, const char magic[4], size_t recordSize,
+                        const void *items, size_t count, const StringArena *strings);
+int      convertLibrary(int toBinary);
+
+// Snapshot
+static int  loadSnapshot(FILE *log);
+static int  checkpointLocked();
+int         checkpointLibrary();
+void        checkpointIfStale();
+int         runCheckpoint();
+
+// Archive
+int    archiveLibrary(int compress);
+size_t visitArchive(uint64_t memberID, int32_t fromDay, int32_t toDay,
+                    ArchiveVisitor visit, void *ctx);
+void   collectBorrow(const Borrow *borrow, void *table);
+
+// Text parser
+const char *findDelimiter(const char *p, const char *end);
+size_t      parseDataFile(const char *path, int fieldCount, RecordParser parse, void *table);
+int         parseIntField(const TextField *field, int *value);
+int         parseMemberField(const TextField *field, uint64_t *key);
+int         copyField(char *dst, size_t size, const TextField *field);
+int         parseDateField(const TextField *field, int32_t *day);
+
+// Table operations
+void   *growTable(void *items, size_t *capacity, size_t elemSize);
+Book   *appendBook(BookTable *table);
+Member *appendMember(MemberTable *table);
+Borrow *appendBorrow(BorrowTable *table);
+
+// Index operations
+uint64_t hashBookID(int id);
+uint64_t hashMemberID(uint64_t key);
+size_t   indexFind(const RowIndex *index, uint64_t hash, RowMatcher matches, const void *key);
+void     indexInsert(RowIndex *index, uint64_t hash, size_t row);
+void     indexRemove(RowIndex *index, uint64_t hash, size_t row);
+void     indexMoveRow(RowIndex *index, uint64_t hash, size_t oldRow, size_t newRow);
+void     freeIndex(RowIndex *index);
+void     buildIndexes();
+Book    *findBook(int id);
+Member  *findMember(uint64_t key);
+
+// String arena operations
+uint32_t    internText(StringArena *arena, const char *text, size_t length);
+int         internField(StringArena *arena, const TextField *field, uint32_t *ref);
+const char *bookTitle(const Book *book);
+const char *bookAuthor(const Book *book);
+const char *memberName(const Member *member);
+const char *memberPhone(const Member *member);
+uint32_t    findText(const StringArena *arena, const char *text);
+int         checkStrings(const StringArena *arena, const void *records, size_t refOffset,
+                         size_t recordSize, size_t count);
+void        packStrings();
+void        freeArena(StringArena *arena);
+
+// Open loan operations
+void     openLoanAdd(size_t borrowRow);
+void     openLoanRemove(int bookID);
+size_t   openLoanDateBound(int32_t day);
+void     sortOpenLoanDates();
+void     buildOpenLoans();
+void     freeOpenLoans();
+
+// Availability operations
+static void setAvailableBit(size_t row, int available);
+void     setBookStatus(Book *book, int status);
+size_t   nextBookRow(size_t row, int available);
+size_t   countAvailable();
+void     buildAvailability();
+void     freeAvailability();
+
+// Member loan operations
+void            memberLoansAdd(size_t borrowRow);
+void            memberLoansClose(const Borrow *borrow);
+MemberLoanList *findMemberLoans(uint64_t memberID);
+void            buildMemberLoans();
+void            freeMemberLoans();
+
+// Text index operations
+uint64_t hashString(const char *text);
+uint64_t hashBytes(const char *text, size_t length);
+int      tokenizeText(const char *text, char tokens[][MAX_TOKEN_BYTES], int prefix[], int maxTokens);
+void     textIndexAddBook(const Book *book);
+void     textIndexRemoveBook(const Book *book);
+void     buildTextIndex();
+void     freeTextIndex();
+void     searchText(const char *query, IdList *result);
+void     idListAppend(IdList *list, int id);
+void     freeIdList(IdList *list);
+
+// Sorted view operations
+size_t            collationKey(const char *text, char *out, size_t size);
+void              viewAdd(SortedViewId id, uint32_t text, uint64_t recordID);
+void              viewRemove(SortedViewId id);
+const SortedView *sortedView(SortedViewId id);
+size_t            viewLowerBound(const SortedView *view, const char *key);
+void              pruneSortedViews();
+void              repackSortedViews();
+void              buildSortedViews();
+void              freeSortedViews();
+
+// Listings
+void   listInit(ListCursor *cursor, ListKind kind);
+int    parseListKind(const char *text, ListKind *kind);
+int    listFilter(ListCursor *cursor, const char *arg);
+size_t listNext(ListCursor *cursor);
+void   writeListed(FILE *out, const ListCursor *cursor, size_t row);
+void   pagerInit(Pager *pager);
+int    pagerLine(Pager *pager);
+int    exportRecords(int argc, char *argv[]);
+
 // Book operations
-int  loadBooks(Book books[]);
-void saveBooks(const Book books[], int count);
+size_t loadBooks(BookTable *table);
+int    saveBooks(const BookTable *table);
+void   writeBook(FILE *out, const Book *book);
 void addBook();
 void deleteBook();
 void searchBook();
+void searchBookByText();
 void listBooks();
+void listSortedBooks();
 void listAvailableBooks();
 void listBorrowedBooks();
+void listOverdueLoans();
+void listDueSoonLoans();
 
 // Member operations
-int  loadMembers(Member members[]);
-void saveMembers(const Member members[], int count);
+size_t loadMembers(MemberTable *table);
+int    saveMembers(const MemberTable *table);
+void   writeMember(FILE *out, const Member *member);
 void addMember();
 void searchMember();
 void listMembers();
+void listSortedMembers();
+void listMemberLoans();
 
 // Borrow operations
-int  loadBorrows(Borrow borrows[]);
-void saveBorrows(const Borrow borrows[], int count);
+size_t loadBorrows(BorrowTable *table);
+int    saveBorrows(const BorrowTable *table);
+void   writeBorrow(FILE *out, const Borrow *borrow);
 void borrowBook();
 void returnBook();
 void listBorrows();
+void listOpenLoans();
 
 // Helper functions
 int  isValidMemberID(const char *id);
+uint64_t memberKey(const char *id);
+void formatMemberKey(uint64_t key, char id[12]);
 void clearInputBuffer();
+void readLine(char *buf, size_t size);
+int  splitFields(char *line, char *fields[], int maxFields);
+void copyString(char *dst, size_t size, const char *src);
+int  fileExists(const char *path);
+int  parseDate(const char *text, int32_t *day);
+void formatDate(int32_t day, char out[11]);
+void printUsage(const char *program);
+double nowSeconds();
+
+// Analytics
+int  runAnalytics(int32_t fromDay, int32_t toDay, int threads, size_t top, LoanReport *report);
+void printLoanReport(const LoanReport *report);
+void freeLoanReport(LoanReport *report);
+int  analyticsThreads();
+void loanAnalytics();
+int  runAnalyticsCommand(int argc, char *argv[]);
+
+// Batch mode
+int runBatch(const char *path, size_t commitEvery);
 
-int main()
+// Server mode
+int runServer(const char *socketPath, double commitWindow);
+int runLoadgen(int argc, char *argv[]);
+
+// Bulk import
+int importFile(const char *path, int members);
+
+// Benchmarks
+int         benchParse(const char *path);
+int         runBenchmarks(int argc, char *argv[]);
+int         runStressTest(int threads);
+int         generateLibrary(size_t books, size_t members, size_t borrows, unsigned seed);
+void        generateMemberID(unsigned n, char id[12]);
+const char *sampleWord(unsigned n);
+
+int main(int argc, char *argv[])
 {
     int choice;
 
+    // Options for every mode come first
+    while(argc > 2 && strcmp(argv[1], "--loan-limit") == 0)
+    {
+        char *end;
+        long limit = strtol(argv[2], &end, 10);
+        if(*end != '\0' || limit < 0 || limit > INT32_MAX)
+        {
+            printf("Invalid loan limit: %s\n", argv[2]);
+            return 1;
+        }
+        loanLimit = (int)limit;
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    // Non-interactive command line options
+    if(argc > 1)
+    {
+        if(strcmp(argv[1], "--to-binary") == 0)
+            return convertLibrary(1);
+        if(strcmp(argv[1], "--to-text") == 0)
+            return convertLibrary(0);
+        if(strcmp(argv[1], "--checkpoint") == 0)
+            return runCheckpoint();
+        if(strcmp(argv[1], "--archive") == 0)
+            return archiveLibrary(!(argc > 2 && strcmp(argv[2], "--no-compress") == 0));
+        if(strcmp(argv[1], "--bench-parse") == 0)
+            return benchParse(argc > 2 ? argv[2] : BOOKS_FILE);
+        if(strcmp(argv[1], "--stress") == 0)
+            return runStressTest(argc > 2 ? atoi(argv[2]) : 4);
+        if(strcmp(argv[1], "--batch") == 0)
+        {
+            const char *path = "-";
+            size_t commitEvery = 0;
+            for(int i = 2; i < argc; i++)
+            {
+                if(strcmp(argv[i], "--commit-every") == 0 && i + 1 < argc)
+                    commitEvery = strtoul(argv[++i], NULL, 10);
+                else
+                    path = argv[i];
+            }
+            return runBatch(path, commitEvery);
+        }
+        if(strcmp(argv[1], "--serve") == 0)
+        {
+            const char *socketPath = SERVER_SOCKET;
+            long commitWindow = COMMIT_WINDOW_US;
+            for(int i = 2; i < argc; i++)
+            {
+                if(strcmp(argv[i], "--commit-window") == 0 && i + 1 < argc)
+                    commitWindow = strtol(argv[++i], NULL, 10);
+                else
+                    socketPath = argv[i];
+            }
+            return runServer(socketPath, commitWindow > 0 ? commitWindow / 1e6 : 0);
+        }
+        if(strcmp(argv[1], "--loadgen") == 0)
+            return runLoadgen(argc - 2, argv + 2);
+        if(strcmp(argv[1], "--bench") == 0)
+            return runBenchmarks(argc - 2, argv + 2);
+        if(strcmp(argv[1], "--generate") == 0 && argc > 2)
+        {
+            size_t books   = strtoul(argv[2], NULL, 10);
+            size_t members = argc > 3 ? strtoul(argv[3], NULL, 10) : books / 10 + 1;
+            size_t borrows = argc > 4 ? strtoul(argv[4], NULL, 10) : books;
+            return generateLibrary(books, members, borrows, 1) == 0 ? 0 : 1;
+        }
+        if(strcmp(argv[1], "--import-books") == 0 && argc > 2)
+            return importFile(argv[2], 0);
+        if(strcmp(argv[1], "--import-members") == 0 && argc > 2)
+            return importFile(argv[2], 1);
+        if(strcmp(argv[1], "--export") == 0 && argc > 2)
+            return exportRecords(argc - 2, argv + 2);
+        if(strcmp(argv[1], "--analytics") == 0)
+            return runAnalyticsCommand(argc - 2, argv + 2);
+
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Load all data files into memory once
+    loadLibrary();
+
     // Main loop (runs until the user chooses to exit)
     while (1)
     {
@@ -113,9 +1139,12 @@ int main()
                 printf("2. Kitap Sil\n");
                 printf("3. Kitap Ara\n");
                 printf("4. Kitap Listele\n");
+                printf("5. Başlık/Yazar ile Ara\n");
+                printf("6. Alfabetik Listele\n");
                 printf("Seçiminiz: ");
                 scanf("%d", &bookChoice);
                 clearInputBuffer();
+                refreshLibrary(); // Pick up changes made at other desks
 
                 switch(bookChoice)
                 {
@@ -123,6 +1152,8 @@ int main()
                     case 2: deleteBook();     break;
                     case 3: searchBook();     break;
                     case 4: listBooks();      break;
+                    case 5: searchBookByText(); break;
+                    case 6: listSortedBooks(); break;
                     default: printf("Geçersiz seçim!\n"); break;
                 }
             }
@@ -135,15 +1166,20 @@ int main()
                 printf("1. Üye Ekle\n");
                 printf("2. Üye Ara\n");
                 printf("3. Üye Listele\n");
+                printf("4. Üyenin Ödünçleri\n");
+                printf("5. Alfabetik Listele\n");
                 printf("Seçiminiz: ");
                 scanf("%d", &memberChoice);
                 clearInputBuffer();
+                refreshLibrary(); // Pick up changes made at other desks
 
                 switch(memberChoice)
                 {
                     case 1: addMember();      break;
                     case 2: searchMember();   break;
                     case 3: listMembers();    break;
+                    case 4: listMemberLoans(); break;
+                    case 5: listSortedMembers(); break;
                     default: printf("Geçersiz seçim!\n"); break;
                 }
             }
@@ -156,15 +1192,18 @@ int main()
                 printf("1. Kitap Ödünç Ver\n");
                 printf("2. Kitap İade Al\n");
                 printf("3. Ödünç Listesi\n");
+                printf("4. Açık Ödünçleri Listele\n");
                 printf("Seçiminiz: ");
                 scanf("%d", &borrowChoice);
                 clearInputBuffer();
+                refreshLibrary(); // Pick up changes made at other desks
 
                 switch(borrowChoice)
                 {
                     case 1: borrowBook();  break;
                     case 2: returnBook();  break;
                     case 3: listBorrows(); break;
+                    case 4: listOpenLoans(); break;
                     default: printf("Geçersiz seçim!\n"); break;
                 }
             }
@@ -176,14 +1215,23 @@ int main()
                 printf("\n-- Raporlama --\n");
                 printf("1. Mevcut (Boşta) Kitapları Listele\n");
                 printf("2. Ödünçteki Kitapları Listele\n");
+                printf("3. Gecikmiş Ödünçleri Listele\n");
+                printf("4. Teslim Tarihi Yaklaşan Ödünçler\n");
+                printf("5. İşlem İstatistikleri\n");
+                printf("6. Ödünç Analizleri\n");
                 printf("Seçiminiz: ");
                 scanf("%d", &reportChoice);
                 clearInputBuffer();
+                refreshLibrary(); // Pick up changes made at other desks
 
                 switch(reportChoice)
                 {
                     case 1: listAvailableBooks(); break;
                     case 2: listBorrowedBooks();  break;
+                    case 3: listOverdueLoans();   break;
+                    case 4: listDueSoonLoans();   break;
+                    case 5: printStats(stdout);   break;
+                    case 6: loanAnalytics();      break;
                     default: printf("Geçersiz seçim!\n"); break;
                 }
             }
@@ -191,6 +1239,10 @@ int main()
 
             case 5:
                 printf("Programdan çıkılıyor...\n");
+                if(library.logEntries > 0)
+                    compactLibrary();
+                checkpointIfStale();
+                freeLibrary();
                 return 0;
 
             default:
@@ -204,659 +1256,9077 @@ int main()
 
 /*
     -------------------------
-    BOOK OPERATIONS
+    STORE OPERATIONS
     -------------------------
 */
 
 /**
- * Reads books from the file into the books array.
- * Returns the number of books read.
+ * Loads books, members and borrow records into the resident store, from
+ * the snapshot if it is current or else from their files, and replays the
+ * rest of the log on top. The caller holds the file lock.
  */
-int loadBooks(Book books[])
+static void loadStore()
 {
-    FILE *fp = fopen(BOOKS_FILE, "r");
-    if (fp == NULL)
-        return 0; // If file doesn't exist, return 0
+    uint64_t start = STAT_START();
 
-    int count = 0;
-    while(!feof(fp) && count < MAX_BOOKS)
+    // The binary files take precedence once they have been created
+    library.binaryFormat = fileExists(BOOKS_BIN_FILE) ||
+                           fileExists(MEMBERS_BIN_FILE) ||
+                           fileExists(BORROWS_BIN_FILE);
+
+    library.logGeneration   = 0;
+    library.logOffset       = 0;
+    library.snapshotOffset  = -1;
+    library.snapshotEntries = 0;
+    FILE *fp = fopen(LOG_FILE, "r");
+
+    // A snapshot taken in this log generation already holds the built
+    // store; only the log entries after it need to be applied
+    if(loadSnapshot(fp) == 0)
+        fseek(fp, library.logOffset, SEEK_SET);
+    else if(library.binaryFormat)
     {
-        /*
-            File line format:
-            ID|title|author|status
-        */
-        Book temp;
-        if(fscanf(fp, "%d|%[^|]|%[^|]|%d\n", &temp.ID, temp.title, temp.author, &temp.status) == 4)
+        BookTable   *books   = &library.books;
+        MemberTable *members = &library.members;
+        BorrowTable *borrows = &library.borrows;
+
+        if(loadBinaryFile(BOOKS_BIN_FILE, "BOOK", sizeof(Book),
+                          (void **)&books->items, &books->count, &books->capacity, &library.bookText) != 0 ||
+           loadBinaryFile(MEMBERS_BIN_FILE, "MEMB", sizeof(Member),
+                          (void **)&members->items, &members->count, &members->capacity, &library.memberText) != 0 ||
+           loadBinaryFile(BORROWS_BIN_FILE, "BORR", sizeof(Borrow),
+                          (void **)&borrows->items, &borrows->count, &borrows->capacity, NULL) != 0 ||
+           checkStrings(&library.bookText, books->items, offsetof(Book, title),
+                        sizeof(Book), books->count) != 0 ||
+           checkStrings(&library.memberText, members->items, offsetof(Member, name),
+                        sizeof(Member), members->count) != 0)
         {
-            books[count++] = temp;
+            printf("Failed to load the binary data files!\n");
+            exit(EXIT_FAILURE);
         }
     }
+    else
+    {
+        loadBooks(&library.books);
+        loadMembers(&library.members);
+        loadBorrows(&library.borrows);
+    }
+    if(library.snapshotOffset < 0)
+        buildIndexes();
 
-    fclose(fp);
-    return count;
+    // Re-apply changes made since the last compaction (or the snapshot)
+    library.logEntries = library.snapshotEntries;
+    if(fp != NULL)
+    {
+        library.logEntries += replayLog(fp);
+        fclose(fp);
+    }
+    STAT_RECORD(STAT_LOAD, start);
 }
 
 /**
- * Writes the book data from the array to the file.
+ * Releases the records and indexes of the resident store.
  */
-void saveBooks(const Book books[], int count)
+static void freeStore()
 {
-    FILE *fp = fopen(BOOKS_FILE, "w");
-    if (fp == NULL)
-    {
-        printf("Failed to open file for saving books!\n");
-        return;
-    }
+    free(library.books.items);
+    free(library.members.items);
+    free(library.borrows.items);
+    freeIndex(&library.bookIndex);
+    freeIndex(&library.memberIndex);
+    freeTextIndex();
+    freeSortedViews();
+    freeOpenLoans();
+    freeMemberLoans();
+    freeAvailability();
+    freeArena(&library.bookText);
+    freeArena(&library.memberText);
+    memset(&library.books, 0, sizeof(library.books));
+    memset(&library.members, 0, sizeof(library.members));
+    memset(&library.borrows, 0, sizeof(library.borrows));
+}
 
-    for(int i = 0; i < count; i++)
-    {
-        fprintf(fp, "%d|%s|%s|%d\n",
-                books[i].ID,
-                books[i].title,
-                books[i].author,
-                books[i].status);
-    }
+/**
+ * Loads the resident store. Called once at program startup.
+ */
+void loadLibrary()
+{
+    pthread_rwlock_init(&library.lock, NULL);
+    pthread_mutex_init(&library.syncLock, NULL);
+    pthread_cond_init(&library.synced, NULL);
+    library.commitWindow = COMMIT_WINDOW_US / 1e6;
+    library.lockFd = open(LOCK_FILE, O_RDWR | O_CREAT, 0644);
+    if(library.lockFd < 0)
+        printf("Failed to open the lock file, other desks are not excluded!\n");
 
-    fclose(fp);
+    // Exclusively, so that the files can be repaired after a crash
+    if(library.lockFd >= 0)
+        flock(library.lockFd, LOCK_EX);
+    recoverFiles();
+    loadStore();
+    library.logVersion = readLogVersion();
+    openLog(); // Keep logging
+    library.fileLocked = 1;
+    trimLog();
+    library.fileLocked = 0;
+    if(library.lockFd >= 0)
+        flock(library.lockFd, LOCK_UN);
 }
 
 /**
- * Adds a new book to the system.
+ * Releases the memory held by the resident store.
  */
-void addBook()
+void freeLibrary()
 {
-    Book books[MAX_BOOKS];
-    int count = loadBooks(books);
+    dumpStats();
+    freeStore();
+    closeLog();
+    if(library.lockFd >= 0)
+        close(library.lockFd);
+    pthread_rwlock_destroy(&library.lock);
+    pthread_mutex_destroy(&library.syncLock);
+    pthread_cond_destroy(&library.synced);
+    memset(&library, 0, sizeof(library));
+}
 
-    if(count >= MAX_BOOKS)
-    {
-        printf("Maximum number of books reached!\n");
-        return;
-    }
+/**
+ * Appends a book to the store and indexes it by ID.
+ * The caller is responsible for checking that the ID is unique.
+ * Returns the stored copy.
+ */
+Book *insertBook(const Book *book)
+{
+    Book *slot = appendBook(&library.books);
+    *slot = *book;
+    indexInsert(&library.bookIndex, hashBookID(book->ID), library.books.count - 1);
+    textIndexAddBook(slot);
+    viewAdd(VIEW_TITLES, slot->title, (uint64_t)slot->ID);
+    viewAdd(VIEW_AUTHORS, slot->author, (uint64_t)slot->ID);
+    setBookStatus(slot, slot->status);
+    return slot;
+}
 
-    Book newBook;
-    printf("New Book ID: ");
-    scanf("%d", &newBook.ID);
-    clearInputBuffer();
+/**
+ * Removes the book at the given row. The last book is moved into the freed
+ * row and its index entry is updated accordingly.
+ */
+void removeBook(size_t row)
+{
+    BookTable *books = &library.books;
+    size_t last = books->count - 1;
 
-    // Check for duplicate ID
-    for(int i = 0; i < count; i++)
+    indexRemove(&library.bookIndex, hashBookID(books->items[row].ID), row);
+    textIndexRemoveBook(&books->items[row]);
+    viewRemove(VIEW_TITLES);
+    viewRemove(VIEW_AUTHORS);
+    setAvailableBit(row, 0);
+    if(row != last)
     {
-        if(books[i].ID == newBook.ID)
-        {
-            printf("A book with this ID already exists!\n");
-            return;
-        }
+        books->items[row] = books->items[last];
+        indexMoveRow(&library.bookIndex, hashBookID(books->items[row].ID), last, row);
+        setAvailableBit(row, books->items[row].status == 1);
+        setAvailableBit(last, 0);
+    }
+    books->count--;
+}
+
+/**
+ * Appends a member to the store and indexes it by ID.
+ * The caller is responsible for checking that the ID is unique.
+ * Returns the stored copy.
+ */
+Member *insertMember(const Member *member)
+{
+    Member *slot = appendMember(&library.members);
+    *slot = *member;
+    indexInsert(&library.memberIndex, hashMemberID(member->ID), library.members.count - 1);
+    viewAdd(VIEW_NAMES, slot->name, slot->ID);
+    return slot;
+}
+
+/**
+ * Appends a borrow record to the store and marks the book as borrowed.
+ * Returns the stored copy.
+ */
+Borrow *insertBorrow(const Borrow *borrow)
+{
+    Borrow *slot = appendBorrow(&library.borrows);
+    *slot = *borrow;
+    openLoanAdd(library.borrows.count - 1);
+    memberLoansAdd(library.borrows.count - 1);
+
+    Book *book = findBook(borrow->bookID);
+    if(book != NULL)
+        setBookStatus(book, 0);
+    return slot;
+}
+
+static int openLoanMatches(size_t pos, const void *key)
+{
+    return library.borrows.items[library.openLoans.rows[pos]].bookID == *(const int *)key;
+}
+
+/**
+ * Finds the active (not yet returned) borrow record of a book.
+ * Returns NULL if the book is not currently borrowed.
+ */
+Borrow *findOpenBorrow(int bookID)
+{
+    const OpenLoans *open = &library.openLoans;
+    size_t pos = indexFind(&open->byBook, hashBookID(bookID), openLoanMatches, &bookID);
+    return (pos == INDEX_NOT_FOUND) ? NULL : &library.borrows.items[open->rows[pos]];
+}
+
+/**
+ * Closes a borrow record with the given return date and marks the book as
+ * available again.
+ */
+void closeBorrow(Borrow *borrow, int32_t returnDay)
+{
+    openLoanRemove(borrow->bookID);
+    memberLoansClose(borrow);
+    borrow->returnDay = returnDay;
+
+    Book *book = findBook(borrow->bookID);
+    if(book != NULL)
+        setBookStatus(book, 1);
+}
+
+/*
+    -------------------------
+    CORE OPERATIONS
+    -------------------------
+*/
+
+/*
+    The core operations validate their arguments against the store, apply
+    the change in memory and append it to the operation log. They print
+    nothing; the caller reports the returned status. Each one runs as a
+    single write section (see CONCURRENCY), so the validation sees every
+    change committed by other threads and desks before it.
+*/
+
+/**
+ * Returns 1 if a text value is non-empty, at most MAX_TEXT_BYTES long and
+ * contains no characters that would break the '|'-delimited files.
+ */
+static int isValidText(const char *text)
+{
+    size_t len = strlen(text);
+    return len > 0 && len <= MAX_TEXT_BYTES && strpbrk(text, "|\r\n") == NULL;
+}
+
+static LibStatus addBookLocked(int id, const char *title, const char *author)
+{
+    if(!isValidText(title) || !isValidText(author))
+        return LIB_ERR_INVALID;
+    if(findBook(id) != NULL)
+        return LIB_ERR_EXISTS;
+
+    Book book;
+    book.ID     = id;
+    book.status = 1; // By default, a newly added book is available
+    book.title  = internText(&library.bookText, title, strlen(title));
+    book.author = internText(&library.bookText, author, strlen(author));
+
+    insertBook(&book);
+    logOperation("A|%d|%s|%s|%d", book.ID, title, author, book.status);
+    return LIB_OK;
+}
+
+LibStatus libAddBook(int id, const char *title, const char *author)
+{
+    uint64_t start = STAT_START();
+    beginWrite();
+    LibStatus status = addBookLocked(id, title, author);
+    if(endWrite() != 0 && status == LIB_OK)
+        status = LIB_ERR_IO;
+    STAT_RECORD(STAT_ADD_BOOK, start);
+    return status;
+}
+
+static LibStatus deleteBookLocked(int id)
+{
+    Book *book = findBook(id);
+    if(book == NULL)
+        return LIB_ERR_NO_BOOK;
+    if(findOpenBorrow(id) != NULL)
+        return LIB_ERR_BORROWED; // Its open loan must be returned first
+
+    removeBook((size_t)(book - library.books.items));
+    logOperation("D|%d", id);
+    return LIB_OK;
+}
+
+LibStatus libDeleteBook(int id)
+{
+    uint64_t start = STAT_START();
+    beginWrite();
+    LibStatus status = deleteBookLocked(id);
+    if(endWrite() != 0 && status == LIB_OK)
+        status = LIB_ERR_IO;
+    STAT_RECORD(STAT_DELETE_BOOK, start);
+    return status;
+}
+
+static LibStatus addMemberLocked(const char *id, const char *name, const char *phone)
+{
+    uint64_t key = memberKey(id);
+    if(key == MEMBER_NONE || !isValidText(name) || !isValidText(phone))
+        return LIB_ERR_INVALID;
+    if(findMember(key) != NULL)
+        return LIB_ERR_EXISTS;
+
+    Member member;
+    member.ID    = key;
+    member.name  = internText(&library.memberText, name, strlen(name));
+    member.phone = internText(&library.memberText, phone, strlen(phone));
+
+    insertMember(&member);
+    logOperation("M|%s|%s|%s", id, name, phone);
+    return LIB_OK;
+}
+
+LibStatus libAddMember(const char *id, const char *name, const char *phone)
+{
+    uint64_t start = STAT_START();
+    beginWrite();
+    LibStatus status = addMemberLocked(id, name, phone);
+    if(endWrite() != 0 && status == LIB_OK)
+        status = LIB_ERR_IO;
+    STAT_RECORD(STAT_ADD_MEMBER, start);
+    return status;
+}
+
+static LibStatus borrowBookLocked(int bookID, const char *memberID, const char *borrowDate)
+{
+    int32_t borrowDay;
+    if(parseDate(borrowDate, &borrowDay) != 0)
+        return LIB_ERR_INVALID;
+
+    Book *book = findBook(bookID);
+    if(book == NULL)
+        return LIB_ERR_NO_BOOK;
+    if(book->status == 0)
+        return LIB_ERR_BORROWED;
+    uint64_t key = memberKey(memberID);
+    if(key == MEMBER_NONE || findMember(key) == NULL)
+        return LIB_ERR_NO_MEMBER;
+    const MemberLoanList *loans = findMemberLoans(key);
+    if(loanLimit > 0 && loans != NULL && loans->open >= (uint32_t)loanLimit)
+        return LIB_ERR_LIMIT;
+
+    Borrow borrow;
+    borrow.bookID   = bookID;
+    borrow.memberID = key;
+    borrow.borrowDay = borrowDay;
+    borrow.returnDay = DATE_OPEN; // Until the book is returned
+
+    char date[11];
+    formatDate(borrowDay, date);
+    insertBorrow(&borrow);
+    logOperation("B|%d|%s|%s", borrow.bookID, memberID, date);
+    return LIB_OK;
+}
+
+LibStatus libBorrowBook(int bookID, const char *memberID, const char *borrowDate)
+{
+    uint64_t start = STAT_START();
+    beginWrite();
+    LibStatus status = borrowBookLocked(bookID, memberID, borrowDate);
+    if(endWrite() != 0 && status == LIB_OK)
+        status = LIB_ERR_IO;
+    STAT_RECORD(STAT_BORROW, start);
+    return status;
+}
+
+static LibStatus returnBookLocked(int bookID, const char *returnDate)
+{
+    int32_t returnDay;
+    if(parseDate(returnDate, &returnDay) != 0)
+        return LIB_ERR_INVALID;
+
+    Borrow *borrow = findOpenBorrow(bookID);
+    if(borrow == NULL)
+        return LIB_ERR_NOT_BORROWED;
+    if(returnDay < borrow->borrowDay)
+        return LIB_ERR_INVALID; // Returned before it was borrowed
+
+    char date[11];
+    formatDate(returnDay, date);
+    closeBorrow(borrow, returnDay);
+    logOperation("R|%d|%s", bookID, date);
+    return LIB_OK;
+}
+
+LibStatus libReturnBook(int bookID, const char *returnDate)
+{
+    uint64_t start = STAT_START();
+    beginWrite();
+    LibStatus status = returnBookLocked(bookID, returnDate);
+    if(endWrite() != 0 && status == LIB_OK)
+        status = LIB_ERR_IO;
+    STAT_RECORD(STAT_RETURN, start);
+    return status;
+}
+
+/**
+ * Returns a short machine-readable name for a status.
+ */
+const char *statusName(LibStatus status)
+{
+    switch(status)
+    {
+        case LIB_OK:               return "ok";
+        case LIB_ERR_INVALID:      return "invalid";
+        case LIB_ERR_EXISTS:       return "exists";
+        case LIB_ERR_NO_BOOK:      return "no_book";
+        case LIB_ERR_NO_MEMBER:    return "no_member";
+        case LIB_ERR_BORROWED:     return "borrowed";
+        case LIB_ERR_NOT_BORROWED: return "not_borrowed";
+        case LIB_ERR_LIMIT:        return "limit";
+        case LIB_ERR_IO:           return "io";
+    }
+    return "unknown";
+}
+
+/**
+ * Returns the message shown to the user for a failed operation.
+ */
+const char *statusMessage(LibStatus status)
+{
+    switch(status)
+    {
+        case LIB_OK:               return "Operation successful!";
+        case LIB_ERR_INVALID:      return "Invalid input!";
+        case LIB_ERR_EXISTS:       return "A record with this ID already exists!";
+        case LIB_ERR_NO_BOOK:      return "No book found with this ID!";
+        case LIB_ERR_NO_MEMBER:    return "No member found with this ID!";
+        case LIB_ERR_BORROWED:     return "This book is already borrowed!";
+        case LIB_ERR_NOT_BORROWED: return "No active borrow record found for this book!";
+        case LIB_ERR_LIMIT:        return "This member has reached the loan limit!";
+        case LIB_ERR_IO:           return "The change could not be written to disk!";
+    }
+    return "Unknown error!";
+}
+
+/*
+    -------------------------
+    OPERATION LOG
+    -------------------------
+*/
+
+/*
+    Each mutation is appended to LOG_FILE as one line instead of rewriting
+    the data files. The line starts with the checksum of the entry (8 hex
+    digits of checksum64) and a space:
+
+        A|ID|title|author|status            (book added)
+        D|ID                                (book deleted)
+        M|ID|name|phone                     (member added)
+        B|bookID|memberID|borrowDate        (book borrowed)
+        R|bookID|returnDate                 (book returned)
+        G|generation                        (first line: compactions so far,
+                                             without a checksum)
+
+    Once the log holds at least LOG_COMPACT_THRESHOLD entries and a quarter
+    as many entries as there are records (and on exit), the in-memory state
+    is written to the data files and the log is emptied. Tying the threshold
+    to the store size keeps the rewrite cost per operation constant. On startup the log is
+    replayed on top of the .txt files. Replay skips operations whose effect
+    is already present, so a log that survived a compaction is harmless.
+    Replay stops at the first line that is incomplete or fails its
+    checksum: that is where a crash interrupted a write, and the writer
+    that next holds the file lock cuts it off (trimLog). Lines without a
+    checksum, from logs written before checksums were added, are accepted.
+*/
+
+/**
+ * Opens the operation log for appending.
+ */
+void openLog()
+{
+    FILE *log = fopen(LOG_FILE, "a");
+    if(log == NULL)
+        printf("Failed to open the operation log!\n");
+
+    pthread_mutex_lock(&library.syncLock); // waitDurable reads it
+    library.log = log;
+    pthread_mutex_unlock(&library.syncLock);
+}
+
+/**
+ * Closes the operation log.
+ */
+void closeLog()
+{
+    if(library.log != NULL)
+    {
+        // Not while a group fsync is using the descriptor
+        pthread_mutex_lock(&library.syncLock);
+        while(library.syncing)
+            pthread_cond_wait(&library.synced, &library.syncLock);
+        fclose(library.log);
+        library.log = NULL;
+        pthread_mutex_unlock(&library.syncLock);
+    }
+}
+
+/**
+ * Applies a single log line to the in-memory store.
+ * Returns 1 if the line was a valid operation, 0 otherwise.
+ */
+static int applyLogLine(char *line)
+{
+    char *f[5];
+    int n = splitFields(line, f, 5);
+    if(n < 2 || f[0][1] != '\0')
+        return 0;
+
+    switch(f[0][0])
+    {
+        case 'A':
+        {
+            if(n != 5) return 0;
+            Book book;
+            book.ID = atoi(f[1]);
+            if(findBook(book.ID) == NULL)
+            {
+                book.status = atoi(f[4]);
+                book.title  = internText(&library.bookText, f[2], strlen(f[2]));
+                book.author = internText(&library.bookText, f[3], strlen(f[3]));
+                insertBook(&book);
+            }
+            return 1;
+        }
+        case 'D':
+        {
+            Book *book = findBook(atoi(f[1]));
+            if(book != NULL)
+                removeBook((size_t)(book - library.books.items));
+            return 1;
+        }
+        case 'M':
+        {
+            if(n != 4) return 0;
+            Member member;
+            member.ID = memberKey(f[1]);
+            if(member.ID == MEMBER_NONE) return 0;
+            if(findMember(member.ID) == NULL)
+            {
+                member.name  = internText(&library.memberText, f[2], strlen(f[2]));
+                member.phone = internText(&library.memberText, f[3], strlen(f[3]));
+                insertMember(&member);
+            }
+            return 1;
+        }
+        case 'B':
+        {
+            if(n != 4) return 0;
+            Borrow borrow;
+            borrow.bookID   = atoi(f[1]);
+            borrow.memberID = memberKey(f[2]);
+            if(borrow.memberID == MEMBER_NONE) return 0;
+            if(parseDate(f[3], &borrow.borrowDay) != 0) return 0;
+            borrow.returnDay = DATE_OPEN;
+            Book *book = findBook(borrow.bookID);
+            if(book != NULL && book->status == 1)
+                insertBorrow(&borrow);
+            return 1;
+        }
+        case 'R':
+        {
+            if(n != 3) return 0;
+            int32_t returnDay;
+            if(parseDate(f[2], &returnDay) != 0) return 0;
+            Borrow *borrow = findOpenBorrow(atoi(f[1]));
+            if(borrow != NULL)
+                closeBorrow(borrow, returnDay);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the commit counter kept in the first bytes of LOCK_FILE.
+ */
+static uint64_t readLogVersion()
+{
+    uint64_t version = 0;
+    if(library.lockFd < 0 || pread(library.lockFd, &version, sizeof(version), 0) != (ssize_t)sizeof(version))
+        return 0;
+    return version;
+}
+
+/**
+ * Reads the first line of the log (`fp` at its start) and returns its
+ * generation: 0 for a log that was never compacted, or no log at all.
+ */
+static uint64_t logFileGeneration(FILE *fp)
+{
+    char line[LOG_LINE_SIZE];
+    if(fp != NULL && fgets(line, sizeof(line), fp) != NULL && line[0] == 'G' && line[1] == '|')
+        return strtoull(line + 2, NULL, 10);
+    return 0;
+}
+
+/**
+ * Records the current end of the log as applied after this process has
+ * written to it, and bumps the commit counter so other desks catch up.
+ * The caller holds the exclusive file lock.
+ */
+static void publishLog()
+{
+    struct stat st;
+    if(library.log != NULL && fstat(fileno(library.log), &st) == 0)
+        library.logOffset = (long)st.st_size;
+
+    if(library.fileLocked)
+    {
+        uint64_t version = readLogVersion() + 1;
+        if(pwrite(library.lockFd, &version, sizeof(version), 0) == (ssize_t)sizeof(version))
+            library.logVersion = version;
+    }
+}
+
+/**
+ * Returns the entry of a log line, or NULL if its checksum does not match.
+ */
+static char *checkLogLine(char *line)
+{
+    if(line[0] == '\0' || line[1] == '|')
+        return line; // Generation line, or an entry from before checksums
+
+    char *end;
+    unsigned long sum = strtoul(line, &end, 16);
+    if(end != line + 8 || *end != ' ' || sum != (unsigned)checksum64(end + 1, strlen(end + 1)))
+        return NULL;
+    return end + 1;
+}
+
+/**
+ * Re-applies the operations in the log from the current position of `fp`
+ * to the in-memory store, and advances library.logOffset past them. It
+ * stops at a line without its newline or with a bad checksum (see
+ * OPERATION LOG). Returns the number of log entries found.
+ */
+size_t replayLog(FILE *fp)
+{
+    uint64_t start = STAT_START();
+    char line[LOG_LINE_SIZE];
+    size_t entries = 0;
+    long offset = ftell(fp);
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        size_t len = strcspn(line, "\n");
+        if(line[len] != '\n')
+            break;
+        line[len] = '\0';
+
+        char *entry = checkLogLine(line);
+        if(entry == NULL)
+            break;
+        offset += (long)len + 1;
+
+        if(entry[0] == 'G' && entry[1] == '|')
+            library.logGeneration = strtoull(entry + 2, NULL, 10);
+        else if(applyLogLine(entry))
+            entries++;
+    }
+
+    library.logOffset = offset;
+    STAT_RECORD(STAT_REPLAY, start);
+    return entries;
+}
+
+/**
+ * Appends one operation (printf-style, without the newline) to the log.
+ * Unless commits are deferred, the operation is committed right away.
+ */
+void logOperation(const char *fmt, ...)
+{
+    if(library.log == NULL)
+    {
+        printf("Operation log is not available, change kept in memory only!\n");
+        return;
+    }
+
+    uint64_t start = STAT_START();
+    char entry[LOG_LINE_SIZE - 10];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(entry, sizeof(entry), fmt, args);
+    va_end(args);
+    fprintf(library.log, "%08x %s\n", (unsigned)checksum64(entry, strlen(entry)), entry);
+    library.logEntries++;
+    library.uncommitted++;
+    STAT_RECORD(STAT_WRITE, start);
+
+    if(!library.deferCommit)
+        commitLocked();
+}
+
+/**
+ * Writes the whole in-memory store to the data files and empties the log,
+ * leaving only a new generation line so other desks know to reload.
+ * The caller is inside a write section.
+ */
+static void compactLocked()
+{
+    compactWithFiles(NULL, 0);
+}
+
+/**
+ * compactLocked that also moves the synced temporary files of `extra`
+ * (archive segments) into place as part of the same save.
+ * Returns 0 on success, -1 if nothing was saved.
+ */
+static int compactWithFiles(const char *const extra[], int extraCount)
+{
+    uint64_t start = STAT_START();
+    if(library.log != NULL)
+        fflush(library.log);
+    if(saveLibraryFiles(library.logGeneration + 1, extra, extraCount) != 0)
+    {
+        printf("Failed to save the data files, the changes stay in the log!\n");
+        return -1;
+    }
+
+    closeLog();
+    finishSave(library.logGeneration + 1);
+    library.logGeneration++;
+    openLog();
+    publishLog();
+    library.logEntries  = 0;
+    library.uncommitted = 0;
+
+    // Everything committed so far is now in the synced data files
+    pthread_mutex_lock(&library.syncLock);
+    library.durableSeq = library.commitSeq;
+    library.logFailed  = 0;
+    pthread_mutex_unlock(&library.syncLock);
+    STAT_RECORD(STAT_SAVE, start);
+
+    // The old snapshot belongs to the previous generation
+    library.snapshotOffset  = -1;
+    library.snapshotEntries = 0;
+    checkpointLocked();
+    return 0;
+}
+
+/**
+ * Flushes the logged operations to the log file, and compacts the log once
+ * it has grown large relative to the store. Does nothing if no operation
+ * was logged since the last commit, so read-only work never bumps the
+ * commit counter or costs an fsync. The caller is inside a write section.
+ */
+static void commitLocked()
+{
+    if(library.uncommitted == 0)
+        return;
+    library.uncommitted = 0;
+
+    if(library.log != NULL)
+    {
+        uint64_t start = STAT_START();
+        int failed = fflush(library.log) != 0;
+        publishLog();
+        STAT_RECORD(STAT_WRITE, start);
+
+        // Made durable by waitDurable once the locks are released
+        pthread_mutex_lock(&library.syncLock);
+        library.commitSeq++;
+        if(failed)
+            library.logFailed = 1;
+        pthread_mutex_unlock(&library.syncLock);
+    }
+
+    size_t records = library.books.count + library.members.count + library.borrows.count;
+    if(library.logEntries >= LOG_COMPACT_THRESHOLD && library.logEntries >= records / 4)
+        compactLocked();
+}
+
+/**
+ * Commits the deferred log writes (batch mode), lets other desks write and
+ * returns once the commit is on disk. Returns 0 on success, -1 if the
+ * commit could not be made durable (see waitDurable).
+ */
+int commitLog()
+{
+    beginWrite();
+    commitLocked();
+    uint64_t seq = library.commitSeq;
+    releaseFileLock();
+    endWrite();
+    return waitDurable(seq);
+}
+
+/**
+ * Writes the whole in-memory store to the data files and empties the log.
+ */
+void compactLibrary()
+{
+    beginWrite();
+    compactLocked();
+    endWrite();
+}
+
+/*
+    -------------------------
+    CONCURRENCY
+    -------------------------
+*/
+
+/*
+    Readers and writers are separated at two levels:
+
+    - Within a process, library.lock is a reader-writer lock. Searches,
+      listings and reports run between beginRead/endRead and proceed in
+      parallel; every core operation (and log commit or compaction) runs
+      between beginWrite/endWrite, one at a time. A reader therefore always
+      sees the store as it was between two complete operations.
+
+    - Between processes (several desks on the same files), writers also
+      hold an exclusive flock() on LOCK_FILE. Before validating an
+      operation, a writer applies whatever other desks have appended to the
+      log since it last looked (syncLog), so no update is lost or applied
+      against stale state, and its own line lands right after them. A
+      compaction starts a new log generation; a desk that sees a different
+      generation reloads the data files, which then hold everything.
+
+    Every commit bumps a counter stored in LOCK_FILE, so finding out
+    whether other desks wrote anything costs one pread(). Readers do not
+    take the file lock: at most every REFRESH_INTERVAL seconds a reader
+    checks the counter and, if it moved, catches up before reading. Other
+    desks' changes therefore show up with a short delay, while each read
+    still sees one consistent state.
+
+    In batch mode (deferred commits) the file lock is kept from the first
+    write until the commit, so a batch of writes is committed as a group.
+*/
+
+#define REFRESH_INTERVAL 0.05
+
+static double checkedAt; // When readers last looked for changes from other desks
+
+/**
+ * Applies the log entries other desks committed since this process last
+ * read the log, or reloads the store if the log was compacted meanwhile.
+ * The caller holds library.lock exclusively and the file lock.
+ */
+static void syncLog()
+{
+    library.logVersion = readLogVersion();
+    FILE *fp = fopen(LOG_FILE, "r");
+    if(fp == NULL)
+        return;
+
+    if(logFileGeneration(fp) != library.logGeneration)
+    {
+        // Another desk compacted: the data files now hold its changes
+        fclose(fp);
+        freeStore();
+        loadStore();
+        return;
+    }
+
+    fseek(fp, library.logOffset, SEEK_SET);
+    library.logEntries += replayLog(fp);
+    fclose(fp);
+}
+
+/**
+ * Releases the cross-process file lock if this process holds it.
+ */
+static void releaseFileLock()
+{
+    if(library.fileLocked)
+    {
+        flock(library.lockFd, LOCK_UN);
+        library.fileLocked = 0;
+    }
+}
+
+/**
+ * Catches up with changes committed by other desks, if the log changed.
+ */
+void refreshLibrary()
+{
+    pthread_rwlock_wrlock(&library.lock);
+    checkedAt = nowSeconds();
+
+    if(!library.fileLocked && library.lockFd >= 0 && readLogVersion() != library.logVersion)
+    {
+        flock(library.lockFd, LOCK_SH);
+        syncLog();
+        flock(library.lockFd, LOCK_UN);
+    }
+    pthread_rwlock_unlock(&library.lock);
+}
+
+/**
+ * Starts a read section: the store does not change until endRead.
+ */
+void beginRead()
+{
+    pthread_rwlock_rdlock(&library.lock);
+    if(nowSeconds() - checkedAt >= REFRESH_INTERVAL)
+    {
+        pthread_rwlock_unlock(&library.lock);
+        refreshLibrary();
+        pthread_rwlock_rdlock(&library.lock);
+    }
+}
+
+void endRead()
+{
+    pthread_rwlock_unlock(&library.lock);
+}
+
+/**
+ * Starts a write section: excludes all other threads and desks, and brings
+ * the store up to date with the changes they committed.
+ */
+void beginWrite()
+{
+    uint64_t start = STAT_START();
+    pthread_rwlock_wrlock(&library.lock);
+    int lockFile = !library.fileLocked && library.lockFd >= 0;
+    if(lockFile)
+        flock(library.lockFd, LOCK_EX);
+    STAT_RECORD(STAT_LOCK_WAIT, start);
+
+    if(lockFile)
+    {
+        library.fileLocked = 1;
+        if(readLogVersion() != library.logVersion || logSize() != library.logOffset)
+        {
+            syncLog();
+            trimLog();
+        }
+    }
+}
+
+/**
+ * Ends a write section and, unless commits are deferred, waits until what
+ * it committed is on disk. With deferred commits the file lock is kept
+ * until commitLog. Returns -1 if the commit could not be made durable.
+ */
+int endWrite()
+{
+    int deferred = library.deferCommit;
+    uint64_t seq = library.commitSeq;
+    if(!deferred)
+        releaseFileLock();
+    pthread_rwlock_unlock(&library.lock);
+    return deferred ? 0 : waitDurable(seq);
+}
+
+/*
+    -------------------------
+    DURABILITY
+    -------------------------
+*/
+
+/*
+    A change is durable once its log line has been fsync()ed. Writers do
+    not each call fsync: a writer that finds no fsync running becomes the
+    leader, optionally waits library.commitWindow (--commit-window) for
+    more commits to arrive, and syncs the log once for every commit
+    written so far; the others wait for it (waitDurable). A longer window
+    means fewer fsyncs and more throughput under load, at the price of
+    that much extra latency per commit.
+
+    If flushing or syncing the log fails (EIO, ENOSPC), durableSeq stays
+    where it was and library.logFailed is set: waitDurable then fails for
+    every commit not yet on disk, and the operations report LIB_ERR_IO.
+    Such a change is still applied in memory, so it is not undone; it is
+    only uncertain whether it survives a crash. A failed fsync may have
+    dropped the written pages, so retrying it proves nothing; the log only
+    counts as sound again after a compaction has rewritten the data files.
+
+    The data files are never rewritten in place. A save writes every file
+    under TEMP_SUFFIX and syncs it, then creates SAVE_FILE (which names the
+    files and the new log generation), renames the files into place and
+    only then resets the log and removes SAVE_FILE. After a crash,
+    recoverFiles finishes a save if SAVE_FILE exists, or discards its
+    temporary files if not, so the data files always match the log.
+*/
+
+/**
+ * Forces a file's data to stable storage (a full flush on macOS, where
+ * plain fsync may leave it in the drive cache). Returns 0 on success.
+ */
+int syncFile(int fd)
+{
+    uint64_t start = STAT_START();
+    int result;
+#ifdef F_FULLFSYNC
+    result = fcntl(fd, F_FULLFSYNC);
+    if(result != 0)
+        result = fsync(fd);
+#else
+    result = fsync(fd);
+#endif
+    STAT_RECORD(STAT_SYNC, start);
+    return result;
+}
+
+/**
+ * Makes the creation, renaming and removal of files in a directory durable.
+ */
+void syncDirectory(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd >= 0)
+    {
+        syncFile(fd);
+        close(fd);
+    }
+}
+
+/**
+ * Flushes, syncs and closes a file that was just written.
+ * Returns 0 on success; on failure the file at `path` is removed.
+ */
+int closeDurable(FILE *fp, const char *path)
+{
+    int ok = fflush(fp) == 0 && syncFile(fileno(fp)) == 0;
+    if(fclose(fp) != 0 || !ok)
+    {
+        printf("Failed to write %s!\n", path);
+        remove(path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns once commit number `seq` (library.commitSeq) is on disk, running
+ * the fsync for the whole group of pending commits if no other thread is.
+ * Returns 0 on success, -1 if the log could not be written or synced.
+ */
+int waitDurable(uint64_t seq)
+{
+    int result = 0;
+    pthread_mutex_lock(&library.syncLock);
+    while(library.durableSeq < seq)
+    {
+        if(library.logFailed)
+        {
+            result = -1;
+            break;
+        }
+        if(library.syncing)
+        {
+            pthread_cond_wait(&library.synced, &library.syncLock);
+            continue;
+        }
+
+        library.syncing = 1;
+        if(library.commitWindow > 0)
+        {
+            // Let more commits join this fsync
+            pthread_mutex_unlock(&library.syncLock);
+            struct timespec window = { (time_t)library.commitWindow,
+                                       (long)((library.commitWindow - (time_t)library.commitWindow) * 1e9) };
+            nanosleep(&window, NULL);
+            pthread_mutex_lock(&library.syncLock);
+        }
+        uint64_t target = library.commitSeq;
+        int fd = (library.log != NULL) ? fileno(library.log) : -1;
+        pthread_mutex_unlock(&library.syncLock);
+
+        // closeLog waits while `syncing` is set, so the descriptor stays open
+        int failed = fd >= 0 && syncFile(fd) != 0;
+
+        pthread_mutex_lock(&library.syncLock);
+        if(failed)
+            library.logFailed = 1;
+        else if(target > library.durableSeq)
+            library.durableSeq = target;
+        library.syncing = 0;
+        pthread_cond_broadcast(&library.synced);
+    }
+    pthread_mutex_unlock(&library.syncLock);
+    return result;
+}
+
+/**
+ * Returns the current size of the log file, or -1.
+ */
+static long logSize()
+{
+    struct stat st;
+    if(library.log == NULL || fstat(fileno(library.log), &st) != 0)
+        return -1;
+    return (long)st.st_size;
+}
+
+/**
+ * Cuts off what follows the last complete, intact log line: the remains of
+ * a write interrupted by a crash, which would otherwise corrupt the next
+ * entry appended. The caller holds the exclusive file lock.
+ */
+static void trimLog()
+{
+    long size = logSize();
+    if(!library.fileLocked || size <= library.logOffset)
+        return;
+
+    fflush(library.log);
+    if(ftruncate(fileno(library.log), library.logOffset) == 0)
+    {
+        syncFile(fileno(library.log));
+        printf("Discarded %ld byte(s) of an interrupted log write.\n", size - library.logOffset);
+    }
+}
+
+/**
+ * Removes the temporary files of an unfinished save, archive segments
+ * included.
+ */
+static void removeTempFiles()
+{
+    const char *files[] = { BOOKS_FILE, MEMBERS_FILE, BORROWS_FILE,
+                            BOOKS_BIN_FILE, MEMBERS_BIN_FILE, BORROWS_BIN_FILE, SNAPSHOT_FILE };
+    for(size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    {
+        char temp[64];
+        snprintf(temp, sizeof(temp), "%s" TEMP_SUFFIX, files[i]);
+        remove(temp);
+    }
+
+    DIR *dir = opendir(ARCHIVE_DIR);
+    if(dir == NULL)
+        return;
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if(len > 8 && strcmp(entry->d_name + len - 8, ".arc" TEMP_SUFFIX) == 0)
+        {
+            char temp[300];
+            snprintf(temp, sizeof(temp), "%s/%s", ARCHIVE_DIR, entry->d_name);
+            remove(temp);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * Makes a rename into the directory of `path` durable, if that is not the
+ * current directory (which every save syncs anyway).
+ */
+static void syncParentDirectory(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    if(slash == NULL)
+        return;
+    char dir[64];
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path), path);
+    syncDirectory(dir);
+}
+
+/**
+ * Moves the synced temporary files of `paths` into place, recording the
+ * save in SAVE_FILE first so that a crash midway is finished on restart.
+ * Returns 0 on success.
+ */
+static int replaceDataFiles(const char *const paths[], int count, uint64_t generation)
+{
+    FILE *fp = fopen(SAVE_FILE TEMP_SUFFIX, "w");
+    if(fp == NULL)
+    {
+        removeTempFiles();
+        return -1;
+    }
+    fprintf(fp, "G|%llu\n", (unsigned long long)generation);
+    for(int i = 0; i < count; i++)
+        fprintf(fp, "%s\n", paths[i]);
+    if(closeDurable(fp, SAVE_FILE TEMP_SUFFIX) != 0 || rename(SAVE_FILE TEMP_SUFFIX, SAVE_FILE) != 0)
+    {
+        removeTempFiles();
+        return -1;
+    }
+    syncDirectory(".");
+
+    // From here on the save is completed, now or by recoverFiles
+    for(int i = 0; i < count; i++)
+    {
+        char temp[80];
+        snprintf(temp, sizeof(temp), "%s" TEMP_SUFFIX, paths[i]);
+        rename(temp, paths[i]);
+        syncParentDirectory(paths[i]);
+    }
+    syncDirectory(".");
+    return 0;
+}
+
+/**
+ * Ends a save: starts the log over at `generation` and removes SAVE_FILE.
+ * The log must be closed.
+ */
+static void finishSave(uint64_t generation)
+{
+    FILE *fp = fopen(LOG_FILE, "w");
+    if(fp != NULL)
+    {
+        fprintf(fp, "G|%llu\n", (unsigned long long)generation);
+        closeDurable(fp, LOG_FILE);
+    }
+    remove(SAVE_FILE);
+    syncDirectory(".");
+}
+
+/**
+ * Repairs the data files after a crash: finishes a save that had begun
+ * replacing them, or drops the temporary files of one that had not.
+ * The caller holds the exclusive file lock.
+ */
+static void recoverFiles()
+{
+    FILE *fp = fopen(SAVE_FILE, "r");
+    if(fp == NULL)
+    {
+        removeTempFiles();
+        remove(SAVE_FILE TEMP_SUFFIX);
+        return;
+    }
+
+    char line[64];
+    unsigned long long generation = 0;
+    if(fgets(line, sizeof(line), fp) != NULL && line[0] == 'G' && line[1] == '|')
+        generation = strtoull(line + 2, NULL, 10);
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        line[strcspn(line, "\n")] = '\0';
+        char temp[80];
+        snprintf(temp, sizeof(temp), "%s" TEMP_SUFFIX, line);
+        if(fileExists(temp))
+        {
+            rename(temp, line);
+            syncParentDirectory(line);
+        }
+    }
+    fclose(fp);
+    syncDirectory(".");
+
+    finishSave(generation);
+    printf("Finished saving the data files after an interruption.\n");
+}
+
+/*
+    -------------------------
+    SNAPSHOT
+    -------------------------
+*/
+
+/*
+    Loading the data files means parsing every record and rebuilding every
+    index, which grows with the catalog. SNAPSHOT_FILE holds the store as it
+    was after some operation of the log, fully built: the record tables and
+    string arenas and the ID, open loan, member loan, availability and text
+    indexes, each written as its raw array (see SnapshotHeader). Loading it
+    is a checksum pass and one copy per array, after which only the log
+    entries that follow its log offset are replayed; restart time then
+    depends on the log written since the snapshot, not on the store size.
+
+    A snapshot is used only if it belongs to the current log generation,
+    the log is at least as long as its offset, and the data files are the
+    ones it was taken over (same inode, size and modification time); any
+    other snapshot is ignored and the store is rebuilt from the data files.
+    The log is synced before a snapshot is written, so the entries it
+    includes can no longer be lost and replaced by different ones.
+
+    A snapshot is written (renamed into place like a data file) after every
+    compaction, by --checkpoint, and when the interactive menu, batch mode
+    or the server exits with CHECKPOINT_THRESHOLD or more log entries past
+    the last one, or without one. The file is specific to the machine that
+    wrote it (struct layout, byte order), like the binary data files.
+*/
+
+// Element size of each snapshot section
+static const size_t snapshotElemSize[SNAP_SECTIONS] = {
+    sizeof(Book), sizeof(Member), sizeof(Borrow), 1, 1, sizeof(IndexSlot), sizeof(IndexSlot),
+    sizeof(IndexSlot), sizeof(IndexSlot), sizeof(uint64_t), sizeof(size_t), sizeof(LoanDate),
+    sizeof(IndexSlot), sizeof(MemberLoanList), sizeof(size_t), sizeof(IndexSlot),
+    sizeof(SnapshotTerm), 1, sizeof(int), sizeof(uint32_t), sizeof(IndexSlot),
+    1, sizeof(IndexSlot), sizeof(ViewEntry), sizeof(ViewEntry), sizeof(ViewEntry)
+};
+
+/**
+ * Returns 1 if a snapshot section holds the slots of a RowIndex.
+ */
+static int isIndexSection(int id)
+{
+    return id == SNAP_BOOK_TEXT_LOOKUP || id == SNAP_MEMBER_TEXT_LOOKUP || id == SNAP_BOOK_INDEX ||
+           id == SNAP_MEMBER_INDEX || id == SNAP_OPEN_BY_BOOK || id == SNAP_LOAN_BY_MEMBER ||
+           id == SNAP_TERM_LOOKUP || id == SNAP_COLLATION_LOOKUP;
+}
+
+/**
+ * Records the identity of the data files in the current format.
+ */
+static void stampDataFiles(FileStamp stamps[3])
+{
+    static const char *const textPaths[] = { BOOKS_FILE, MEMBERS_FILE, BORROWS_FILE };
+    static const char *const binPaths[]  = { BOOKS_BIN_FILE, MEMBERS_BIN_FILE, BORROWS_BIN_FILE };
+    const char *const *paths = library.binaryFormat ? binPaths : textPaths;
+
+    for(int i = 0; i < 3; i++)
+    {
+        struct stat st;
+        memset(&stamps[i], 0, sizeof(stamps[i]));
+        if(stat(paths[i], &st) == 0)
+        {
+            stamps[i].inode = (uint64_t)st.st_ino;
+            stamps[i].size  = (uint64_t)st.st_size;
+            stamps[i].mtime = (uint64_t)st.st_mtime;
+        }
+    }
+}
+
+/**
+ * Points a snapshot section at an array of `count` elements (or, for an
+ * index, at its slots) and computes its checksum.
+ */
+static void setSection(SnapshotHeader *header, const void *data[], int id, const void *items, size_t count)
+{
+    SnapshotSection *section = &header->sections[id];
+    section->count    = count;
+    section->size     = count * snapshotElemSize[id];
+    section->checksum = checksum64(section->size > 0 ? items : "", section->size);
+    data[id] = items;
+}
+
+static void setIndexSection(SnapshotHeader *header, const void *data[], int id, const RowIndex *index)
+{
+    setSection(header, data, id, index->slots, index->capacity);
+    header->sections[id].count = index->count;
+}
+
+/**
+ * Writes the whole store as SNAPSHOT_FILE, taken at the current log offset.
+ * Returns 0 on success, -1 on failure (the previous snapshot is kept).
+ */
+static int writeSnapshot()
+{
+    SnapshotHeader header;
+    const void *data[SNAP_SECTIONS];
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SNAP", 4);
+    header.version      = SNAPSHOT_FORMAT_VERSION;
+    header.wordSize     = sizeof(size_t);
+    header.binaryFormat = (uint32_t)library.binaryFormat;
+    stampDataFiles(header.files);
+    header.generation = library.logGeneration;
+    header.logOffset  = (uint64_t)library.logOffset;
+    header.logEntries = library.logEntries;
+
+    // Store the sorted views and the open loan date index in order
+    for(int i = 0; i < SORTED_VIEWS; i++)
+        sortedView((SortedViewId)i);
+    sortOpenLoanDates();
+
+    // The text index terms are separate allocations: flatten them
+    const TextIndex *ti = &library.textIndex;
+    size_t textBytes = 0, postings = 0;
+    for(size_t i = 0; i < ti->count; i++)
+    {
+        textBytes += strlen(ti->terms[i].text);
+        postings  += ti->terms[i].postings.count;
+    }
+    SnapshotTerm *terms = malloc((ti->count + 1) * sizeof(SnapshotTerm));
+    char *termText      = malloc(textBytes + 1);
+    int *termPostings   = malloc((postings + 1) * sizeof(int));
+    if(terms == NULL || termText == NULL || termPostings == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    textBytes = postings = 0;
+    for(size_t i = 0; i < ti->count; i++)
+    {
+        const Term *term = &ti->terms[i];
+        terms[i].textLength = (uint32_t)strlen(term->text);
+        terms[i].postings   = (uint32_t)term->postings.count;
+        memcpy(termText + textBytes, term->text, terms[i].textLength);
+        if(term->postings.count > 0)
+            memcpy(termPostings + postings, term->postings.ids, term->postings.count * sizeof(int));
+        textBytes += terms[i].textLength;
+        postings  += term->postings.count;
+    }
+
+    const OpenLoans   *open = &library.openLoans;
+    const MemberLoans *ml   = &library.memberLoans;
+    setSection(&header, data, SNAP_BOOKS, library.books.items, library.books.count);
+    setSection(&header, data, SNAP_MEMBERS, library.members.items, library.members.count);
+    setSection(&header, data, SNAP_BORROWS, library.borrows.items, library.borrows.count);
+    setSection(&header, data, SNAP_BOOK_TEXT, library.bookText.bytes, library.bookText.length);
+    setSection(&header, data, SNAP_MEMBER_TEXT, library.memberText.bytes, library.memberText.length);
+    setIndexSection(&header, data, SNAP_BOOK_TEXT_LOOKUP, &library.bookText.lookup);
+    setIndexSection(&header, data, SNAP_MEMBER_TEXT_LOOKUP, &library.memberText.lookup);
+    setIndexSection(&header, data, SNAP_BOOK_INDEX, &library.bookIndex);
+    setIndexSection(&header, data, SNAP_MEMBER_INDEX, &library.memberIndex);
+    setSection(&header, data, SNAP_AVAILABILITY, library.availability.words, (library.books.count + 63) / 64);
+    setSection(&header, data, SNAP_OPEN_ROWS, open->rows, open->count);
+    setSection(&header, data, SNAP_OPEN_DATES, open->byDate, open->count);
+    setIndexSection(&header, data, SNAP_OPEN_BY_BOOK, &open->byBook);
+    setSection(&header, data, SNAP_LOAN_LISTS, ml->lists, ml->count);
+    setSection(&header, data, SNAP_LOAN_NEXT, ml->next, library.borrows.count);
+    setIndexSection(&header, data, SNAP_LOAN_BY_MEMBER, &ml->byMember);
+    setSection(&header, data, SNAP_TERMS, terms, ti->count);
+    setSection(&header, data, SNAP_TERM_TEXT, termText, textBytes);
+    setSection(&header, data, SNAP_POSTINGS, termPostings, postings);
+    setSection(&header, data, SNAP_TERM_ORDER, ti->sorted, ti->count);
+    setIndexSection(&header, data, SNAP_TERM_LOOKUP, &ti->lookup);
+    setSection(&header, data, SNAP_COLLATION, library.collation.bytes, library.collation.length);
+    setIndexSection(&header, data, SNAP_COLLATION_LOOKUP, &library.collation.lookup);
+    for(int i = 0; i < SORTED_VIEWS; i++)
+        setSection(&header, data, SNAP_TITLE_VIEW + i, library.views[i].entries, library.views[i].count);
+
+    FILE *fp = fopen(SNAPSHOT_FILE TEMP_SUFFIX, "wb");
+    int ok = fp != NULL && fwrite(&header, sizeof(header), 1, fp) == 1;
+    for(int i = 0; ok && i < SNAP_SECTIONS; i++)
+        ok = header.sections[i].size == 0 || fwrite(data[i], (size_t)header.sections[i].size, 1, fp) == 1;
+    free(terms);
+    free(termText);
+    free(termPostings);
+
+    if(!ok)
+    {
+        if(fp != NULL)
+            fclose(fp);
+        remove(SNAPSHOT_FILE TEMP_SUFFIX);
+        return -1;
+    }
+    if(closeDurable(fp, SNAPSHOT_FILE TEMP_SUFFIX) != 0 || rename(SNAPSHOT_FILE TEMP_SUFFIX, SNAPSHOT_FILE) != 0)
+        return -1;
+    syncDirectory(".");
+    return 0;
+}
+
+/**
+ * Returns a heap copy of a snapshot section, or NULL if it is empty.
+ */
+static void *copySection(const unsigned char *base, const SnapshotSection *section)
+{
+    if(section->size == 0)
+        return NULL;
+    void *copy = malloc((size_t)section->size);
+    if(copy == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, base, (size_t)section->size);
+    return copy;
+}
+
+/**
+ * Sets up a RowIndex from the slots of a snapshot section.
+ */
+static void copyIndexSection(RowIndex *index, const unsigned char *base, const SnapshotSection *section)
+{
+    index->slots    = copySection(base, section);
+    index->capacity = (size_t)(section->size / sizeof(IndexSlot));
+    index->count    = (size_t)section->count;
+}
+
+/**
+ * Returns 0 if the sections of a snapshot fit the file, match their
+ * checksums and agree with each other, and stores where each one starts.
+ */
+static int checkSnapshot(const SnapshotHeader *header, const unsigned char *payload, size_t payloadSize,
+                         size_t offsets[SNAP_SECTIONS])
+{
+    const SnapshotSection *s = header->sections;
+    uint64_t offset = 0;
+    for(int i = 0; i < SNAP_SECTIONS; i++)
+    {
+        uint64_t elems = s[i].size / snapshotElemSize[i];
+        if(s[i].size > payloadSize - offset || s[i].size % snapshotElemSize[i] != 0 ||
+           (isIndexSection(i) ? (elems & (elems - 1)) != 0 || s[i].count > elems : s[i].count != elems) ||
+           checksum64(payload + offset, (size_t)s[i].size) != s[i].checksum)
+            return -1;
+        offsets[i] = (size_t)offset;
+        offset += s[i].size;
+    }
+
+    // The term table must account for exactly the text and postings stored
+    uint64_t textBytes = 0, postings = 0;
+    for(uint64_t i = 0; i < s[SNAP_TERMS].count; i++)
+    {
+        SnapshotTerm term;
+        memcpy(&term, payload + offsets[SNAP_TERMS] + i * sizeof(SnapshotTerm), sizeof(term));
+        if(term.textLength == 0 || term.textLength >= MAX_TOKEN_BYTES)
+            return -1;
+        textBytes += term.textLength;
+        postings  += term.postings;
+    }
+
+    return (offset == payloadSize &&
+            s[SNAP_AVAILABILITY].count == (s[SNAP_BOOKS].count + 63) / 64 &&
+            s[SNAP_OPEN_DATES].count == s[SNAP_OPEN_ROWS].count &&
+            s[SNAP_LOAN_NEXT].count == s[SNAP_BORROWS].count &&
+            s[SNAP_TERM_TEXT].count == textBytes &&
+            s[SNAP_POSTINGS].count == postings &&
+            s[SNAP_TERM_ORDER].count == s[SNAP_TERMS].count &&
+            s[SNAP_TITLE_VIEW].count == s[SNAP_BOOKS].count &&
+            s[SNAP_AUTHOR_VIEW].count == s[SNAP_BOOKS].count &&
+            s[SNAP_NAME_VIEW].count == s[SNAP_MEMBERS].count) ? 0 : -1;
+}
+
+/**
+ * Rebuilds the text index from the flattened terms of a snapshot.
+ */
+static void copyTextIndex(const unsigned char *payload, const SnapshotSection *s, const size_t offsets[])
+{
+    TextIndex *ti = &library.textIndex;
+    size_t count = (size_t)s[SNAP_TERMS].count;
+    const unsigned char *text = payload + offsets[SNAP_TERM_TEXT];
+    const unsigned char *ids  = payload + offsets[SNAP_POSTINGS];
+
+    ti->terms = calloc(count > 0 ? count : 1, sizeof(Term));
+    if(ti->terms == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < count; i++)
+    {
+        SnapshotTerm info;
+        memcpy(&info, payload + offsets[SNAP_TERMS] + i * sizeof(SnapshotTerm), sizeof(info));
+        Term *term = &ti->terms[i];
+        term->text = malloc(info.textLength + 1);
+        term->postings.ids = malloc(info.postings > 0 ? info.postings * sizeof(int) : 1);
+        if(term->text == NULL || term->postings.ids == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(term->text, text, info.textLength);
+        term->text[info.textLength] = '\0';
+        memcpy(term->postings.ids, ids, info.postings * sizeof(int));
+        term->postings.count = term->postings.capacity = info.postings;
+        text += info.textLength;
+        ids  += info.postings * sizeof(int);
+    }
+
+    ti->sorted   = copySection(payload + offsets[SNAP_TERM_ORDER], &s[SNAP_TERM_ORDER]);
+    ti->count    = count;
+    ti->capacity = count;
+    copyIndexSection(&ti->lookup, payload + offsets[SNAP_TERM_LOOKUP], &s[SNAP_TERM_LOOKUP]);
+}
+
+/**
+ * Loads the store from SNAPSHOT_FILE if it is current for the log `log`
+ * (see SNAPSHOT), setting the log generation and offset it was taken at.
+ * Returns 0 on success; -1 if there is no usable snapshot, with the store
+ * left empty and `log` back at its start.
+ */
+static int loadSnapshot(FILE *log)
+{
+    struct stat st;
+    if(log == NULL || !fileExists(SNAPSHOT_FILE) || fstat(fileno(log), &st) != 0)
+        return -1;
+
+    size_t fileSize = 0;
+    unsigned char *map = mapFile(SNAPSHOT_FILE, &fileSize);
+    if(map == NULL || fileSize < sizeof(SnapshotHeader))
+    {
+        unmapFile(map, fileSize);
+        return -1;
+    }
+
+    const SnapshotHeader *header = (const SnapshotHeader *)map;
+    const unsigned char *payload = map + sizeof(SnapshotHeader);
+    const SnapshotSection *s = header->sections;
+    FileStamp files[3];
+    stampDataFiles(files);
+    uint64_t generation = logFileGeneration(log);
+    rewind(log);
+
+    // A snapshot of other data files or another log generation is just stale
+    size_t offsets[SNAP_SECTIONS];
+    if(memcmp(header->magic, "SNAP", 4) != 0 || header->version != SNAPSHOT_FORMAT_VERSION ||
+       header->wordSize != sizeof(size_t) || header->binaryFormat != (uint32_t)library.binaryFormat ||
+       memcmp(header->files, files, sizeof(files)) != 0 || header->generation != generation ||
+       header->logOffset > (uint64_t)st.st_size)
+    {
+        unmapFile(map, fileSize);
+        return -1;
+    }
+    if(checkSnapshot(header, payload, fileSize - sizeof(SnapshotHeader), offsets) != 0)
+    {
+        printf("%s: damaged, rebuilding the indexes from the data files.\n", SNAPSHOT_FILE);
+        unmapFile(map, fileSize);
+        return -1;
+    }
+
+    library.books.items      = copySection(payload + offsets[SNAP_BOOKS], &s[SNAP_BOOKS]);
+    library.books.count      = library.books.capacity = (size_t)s[SNAP_BOOKS].count;
+    library.members.items    = copySection(payload + offsets[SNAP_MEMBERS], &s[SNAP_MEMBERS]);
+    library.members.count    = library.members.capacity = (size_t)s[SNAP_MEMBERS].count;
+    library.borrows.items    = copySection(payload + offsets[SNAP_BORROWS], &s[SNAP_BORROWS]);
+    library.borrows.count    = library.borrows.capacity = (size_t)s[SNAP_BORROWS].count;
+
+    library.bookText.bytes   = copySection(payload + offsets[SNAP_BOOK_TEXT], &s[SNAP_BOOK_TEXT]);
+    library.bookText.length  = library.bookText.capacity = (size_t)s[SNAP_BOOK_TEXT].count;
+    library.memberText.bytes = copySection(payload + offsets[SNAP_MEMBER_TEXT], &s[SNAP_MEMBER_TEXT]);
+    library.memberText.length = library.memberText.capacity = (size_t)s[SNAP_MEMBER_TEXT].count;
+    copyIndexSection(&library.bookText.lookup, payload + offsets[SNAP_BOOK_TEXT_LOOKUP], &s[SNAP_BOOK_TEXT_LOOKUP]);
+    copyIndexSection(&library.memberText.lookup, payload + offsets[SNAP_MEMBER_TEXT_LOOKUP], &s[SNAP_MEMBER_TEXT_LOOKUP]);
+    copyIndexSection(&library.bookIndex, payload + offsets[SNAP_BOOK_INDEX], &s[SNAP_BOOK_INDEX]);
+    copyIndexSection(&library.memberIndex, payload + offsets[SNAP_MEMBER_INDEX], &s[SNAP_MEMBER_INDEX]);
+
+    Availability *bits = &library.availability;
+    bits->words     = copySection(payload + offsets[SNAP_AVAILABILITY], &s[SNAP_AVAILABILITY]);
+    bits->capacity  = (size_t)s[SNAP_AVAILABILITY].count;
+    bits->available = 0;
+    for(size_t i = 0; i < bits->capacity; i++)
+        bits->available += (size_t)__builtin_popcountll(bits->words[i]);
+
+    OpenLoans *open = &library.openLoans;
+    open->rows     = copySection(payload + offsets[SNAP_OPEN_ROWS], &s[SNAP_OPEN_ROWS]);
+    open->byDate   = copySection(payload + offsets[SNAP_OPEN_DATES], &s[SNAP_OPEN_DATES]);
+    open->count    = open->capacity = (size_t)s[SNAP_OPEN_ROWS].count;
+    open->dated    = open->datedSorted = open->dateCapacity = open->count;
+    copyIndexSection(&open->byBook, payload + offsets[SNAP_OPEN_BY_BOOK], &s[SNAP_OPEN_BY_BOOK]);
+
+    MemberLoans *ml = &library.memberLoans;
+    ml->lists        = copySection(payload + offsets[SNAP_LOAN_LISTS], &s[SNAP_LOAN_LISTS]);
+    ml->count        = ml->capacity = (size_t)s[SNAP_LOAN_LISTS].count;
+    ml->next         = copySection(payload + offsets[SNAP_LOAN_NEXT], &s[SNAP_LOAN_NEXT]);
+    ml->nextCapacity = (size_t)s[SNAP_LOAN_NEXT].count;
+    copyIndexSection(&ml->byMember, payload + offsets[SNAP_LOAN_BY_MEMBER], &s[SNAP_LOAN_BY_MEMBER]);
+
+    copyTextIndex(payload, s, offsets);
+
+    library.collation.bytes  = copySection(payload + offsets[SNAP_COLLATION], &s[SNAP_COLLATION]);
+    library.collation.length = library.collation.capacity = (size_t)s[SNAP_COLLATION].count;
+    copyIndexSection(&library.collation.lookup, payload + offsets[SNAP_COLLATION_LOOKUP], &s[SNAP_COLLATION_LOOKUP]);
+    for(int i = 0; i < SORTED_VIEWS; i++)
+    {
+        SortedView *view = &library.views[i];
+        view->entries = copySection(payload + offsets[SNAP_TITLE_VIEW + i], &s[SNAP_TITLE_VIEW + i]);
+        view->count   = view->capacity = view->sorted = (size_t)s[SNAP_TITLE_VIEW + i].count;
+    }
+
+    library.logGeneration   = header->generation;
+    library.logOffset       = (long)header->logOffset;
+    library.snapshotOffset  = library.logOffset;
+    library.snapshotEntries = (size_t)header->logEntries;
+    unmapFile(map, fileSize);
+    return 0;
+}
+
+/**
+ * Writes a snapshot of the store at the current end of the log. The caller
+ * is inside a write section with every logged operation committed.
+ * Returns 0 on success.
+ */
+static int checkpointLocked()
+{
+    if(library.log == NULL)
+        return -1; // Without the log there is no offset to replay from
+
+    uint64_t start = STAT_START();
+    fflush(library.log);
+    if(syncFile(fileno(library.log)) != 0 || writeSnapshot() != 0)
+    {
+        printf("Failed to write the snapshot, the next start rebuilds the indexes!\n");
+        return -1;
+    }
+    library.snapshotOffset  = library.logOffset;
+    library.snapshotEntries = library.logEntries;
+    STAT_RECORD(STAT_CHECKPOINT, start);
+    return 0;
+}
+
+/**
+ * Commits what is logged and writes a snapshot of the store.
+ * Returns 0 on success.
+ */
+int checkpointLibrary()
+{
+    beginWrite();
+    commitLocked();
+    int result = checkpointLocked();
+    releaseFileLock();
+    endWrite();
+    return result;
+}
+
+/**
+ * Writes a snapshot before exiting if there is none for this log
+ * generation or the log has grown CHECKPOINT_THRESHOLD entries past it.
+ */
+void checkpointIfStale()
+{
+    if(library.snapshotOffset < 0 || library.logEntries - library.snapshotEntries >= CHECKPOINT_THRESHOLD)
+        checkpointLibrary();
+}
+
+/**
+ * Loads the library and writes a snapshot of it (--checkpoint).
+ * Returns the process exit code.
+ */
+int runCheckpoint()
+{
+    loadLibrary();
+    double start = nowSeconds();
+    int result = checkpointLibrary();
+    if(result == 0)
+        printf("Snapshot of %zu books, %zu members and %zu borrow records written to %s in %.3f s.\n",
+               library.books.count, library.members.count, library.borrows.count,
+               SNAPSHOT_FILE, nowSeconds() - start);
+    freeLibrary();
+    return result == 0 ? 0 : 1;
+}
+
+/*
+    -------------------------
+    STATISTICS
+    -------------------------
+*/
+
+/*
+    The core operations, loading/saving the store and the I/O phases inside
+    them (parsing a data file, an index lookup, writing a log entry or data
+    file, an fsync, waiting for the write lock) record how long
+    they took in `stats`. Recording is a clock read and a few relaxed
+    atomic additions; index lookups, which are about as cheap as a clock
+    read, are timed only once in STATS_SAMPLE calls, so their count is the
+    number of timed calls. Building with -DLIBRARY_STATS=0 removes it all.
+
+    The numbers are shown by the "stats" batch command and the report
+    menu, and written to STATS_FILE when the library is closed. Times are
+    per process and cover everything since it started.
+*/
+
+static const char *const statNames[STAT_COUNT] = {
+    "addBook", "deleteBook", "addMember", "borrowBook", "returnBook", "search",
+    "load", "save", "checkpoint", "replay", "parse", "lookup", "write", "sync", "lockWait"
+};
+
+/**
+ * Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t statNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Returns a timestamp for one call in STATS_SAMPLE (per thread), 0 for
+ * the calls that are not timed.
+ */
+uint64_t statSample()
+{
+    static __thread unsigned calls;
+    return (++calls % STATS_SAMPLE == 0) ? statNow() : 0;
+}
+
+/**
+ * Adds one call that took `ns` nanoseconds to a statistic.
+ * Safe to call from parallel readers.
+ */
+void statRecord(StatId id, uint64_t ns)
+{
+    StatHistogram *h = &stats[id];
+    int bucket = (ns == 0) ? 0 : 64 - __builtin_clzll(ns);
+    if(bucket >= STATS_BUCKETS)
+        bucket = STATS_BUCKETS - 1;
+
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->totalNs, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&h->maxNs, __ATOMIC_RELAXED);
+    while(ns > max && !__atomic_compare_exchange_n(&h->maxNs, &max, ns, 1,
+                                                  __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+}
+
+/**
+ * Returns an upper bound, in microseconds, of the latency below which the
+ * given fraction of the calls finished (from the histogram buckets).
+ */
+static double statPercentile(const StatHistogram *h, double fraction)
+{
+    uint64_t target = (uint64_t)(h->count * fraction), seen = 0;
+    for(int b = 0; b < STATS_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if(seen > target || seen == h->count)
+        {
+            uint64_t bound = (uint64_t)1 << b;
+            return (bound < h->maxNs ? bound : h->maxNs) / 1e3;
+        }
+    }
+    return h->maxNs / 1e3;
+}
+
+/**
+ * Prints a table of every statistic that has recorded calls.
+ */
+void printStats(FILE *out)
+{
+    fprintf(out, "%-12s %10s %10s %10s %10s %10s %12s\n",
+            "operation", "count", "avg us", "p50 us", "p99 us", "max us", "total ms");
+    for(int i = 0; i < STAT_COUNT; i++)
+    {
+        const StatHistogram *h = &stats[i];
+        if(h->count == 0)
+            continue;
+        fprintf(out, "%-12s %10llu %10.1f %10.1f %10.1f %10.1f %12.1f\n",
+                statNames[i], (unsigned long long)h->count,
+                h->totalNs / 1e3 / h->count,
+                statPercentile(h, 0.50), statPercentile(h, 0.99),
+                h->maxNs / 1e3, h->totalNs / 1e6);
+    }
+    if(!LIBRARY_STATS)
+        fprintf(out, "(statistics are compiled out)\n");
+}
+
+/**
+ * Writes the statistics table to STATS_FILE, if anything was recorded.
+ */
+void dumpStats()
+{
+    int recorded = 0;
+    for(int i = 0; i < STAT_COUNT; i++)
+        recorded |= (stats[i].count > 0);
+    if(!recorded)
+        return;
+
+    // Desks may close at the same time: each writes its own file first
+    char tmp[64];
+    snprintf(tmp, sizeof(tmp), "%s.%ld", STATS_FILE, (long)getpid());
+    FILE *fp = fopen(tmp, "w");
+    if(fp == NULL)
+        return;
+    printStats(fp);
+    if(fclose(fp) == 0)
+        rename(tmp, STATS_FILE);
+    else
+        remove(tmp);
+}
+
+/*
+    -------------------------
+    BINARY FORMAT
+    -------------------------
+*/
+
+/**
+ * Writes the whole in-memory store to the data files, in whichever format
+ * the library is currently using, and starts log generation `generation`
+ * (see DURABILITY). The synced temporary files of `extra` (archive
+ * segments) are moved into place by the same save. Returns 0 on success;
+ * on failure the old files and the log are left as they were and every
+ * temporary file is removed.
+ */
+int saveLibraryFiles(uint64_t generation, const char *const extra[], int extraCount)
+{
+    const char *const *paths;
+    int failed;
+    packStrings();
+    if(library.binaryFormat)
+    {
+        static const char *const binPaths[] = { BOOKS_BIN_FILE, MEMBERS_BIN_FILE, BORROWS_BIN_FILE };
+        paths = binPaths;
+        failed = saveBinaryFile(BOOKS_BIN_FILE, "BOOK", sizeof(Book),
+                                library.books.items, library.books.count, &library.bookText) != 0 ||
+                 saveBinaryFile(MEMBERS_BIN_FILE, "MEMB", sizeof(Member),
+                                library.members.items, library.members.count, &library.memberText) != 0 ||
+                 saveBinaryFile(BORROWS_BIN_FILE, "BORR", sizeof(Borrow),
+                                library.borrows.items, library.borrows.count, NULL) != 0;
+    }
+    else
+    {
+        static const char *const textPaths[] = { BOOKS_FILE, MEMBERS_FILE, BORROWS_FILE };
+        paths = textPaths;
+        failed = saveBooks(&library.books) != 0 ||
+                 saveMembers(&library.members) != 0 ||
+                 saveBorrows(&library.borrows) != 0;
+    }
+
+    if(failed)
+    {
+        removeTempFiles();
+        return -1;
+    }
+    if(extraCount == 0)
+        return replaceDataFiles(paths, 3, generation);
+
+    const char **all = malloc((size_t)(3 + extraCount) * sizeof(*all));
+    if(all == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(all, paths, 3 * sizeof(*all));
+    memcpy(all + 3, extra, (size_t)extraCount * sizeof(*all));
+    int result = replaceDataFiles(all, 3 + extraCount, generation);
+    free(all);
+    return result;
+}
+
+/**
+ * Maps a whole file read-only into memory for a sequential pass.
+ * Returns NULL if the file is missing, empty or cannot be mapped.
+ */
+void *mapFile(const char *path, size_t *size)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+        return NULL;
+
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    *size = (size_t)st.st_size;
+    return map;
+}
+
+/**
+ * Releases a mapping created by mapFile.
+ */
+void unmapFile(void *map, size_t size)
+{
+    if(map != NULL)
+        munmap(map, size);
+}
+
+/**
+ * Computes a 64-bit checksum of a block of bytes, eight bytes at a time.
+ */
+uint64_t checksum64(const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    uint64_t h = 0xcbf29ce484222325ULL ^ size;
+
+    for(; size >= 8; p += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ word) * 0x100000001b3ULL;
+        h ^= h >> 29;
+    }
+    for(; size > 0; p++, size--)
+        h = (h ^ *p) * 0x100000001b3ULL;
+
+    return h;
+}
+
+/**
+ * Memory-maps a binary data file, validates its header and checksums, and
+ * copies the records into a record array (allocated to the exact size) and
+ * the strings into `strings` (NULL for a table without strings).
+ * A missing file is treated as an empty table.
+ * Returns 0 on success, -1 if the file is damaged or incompatible.
+ */
+int loadBinaryFile(const char *path, const char magic[4], size_t recordSize,
+                   void **items, size_t *count, size_t *capacity, StringArena *strings)
+{
+    if(!fileExists(path))
+        return 0; // If file doesn't exist, the table stays empty
+
+    uint64_t start = STAT_START();
+    size_t fileSize = 0;
+    void *map = mapFile(path, &fileSize);
+    if(map == NULL || fileSize < sizeof(BinaryHeader))
+    {
+        printf("%s: file is too short or cannot be read!\n", path);
+        unmapFile(map, fileSize);
+        return -1;
+    }
+
+    const BinaryHeader *header = map;
+    const unsigned char *records = (const unsigned char *)map + sizeof(BinaryHeader);
+    size_t payload = fileSize - sizeof(BinaryHeader);
+    int result = -1;
+
+    if(memcmp(header->magic, magic, 4) != 0)
+        printf("%s: not a library data file!\n", path);
+    else if(header->version != BINARY_FORMAT_VERSION || header->recordSize != recordSize)
+        printf("%s: unsupported format version %u!\n", path, header->version);
+    else if(header->stringSize > payload || (strings == NULL && header->stringSize != 0) ||
+            header->count != (payload - header->stringSize) / recordSize ||
+            (payload - header->stringSize) % recordSize != 0)
+        printf("%s: record count does not match file size!\n", path);
+    else if(checksum64(records, payload - header->stringSize) != header->checksum ||
+            checksum64(records + (payload - header->stringSize), header->stringSize) != header->stringChecksum)
+        printf("%s: checksum mismatch!\n", path);
+    else
+        result = 0;
+
+    if(result == 0 && header->count > 0)
+    {
+        size_t n = (size_t)header->count;
+        void *copy = realloc(*items, n * recordSize);
+        if(copy == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(copy, records, n * recordSize);
+        *items    = copy;
+        *count    = n;
+        *capacity = n;
+    }
+    if(result == 0 && header->stringSize > 0)
+    {
+        // The lookup is built when the first new string is interned
+        freeArena(strings);
+        strings->length = strings->capacity = (size_t)header->stringSize;
+        strings->bytes = malloc(strings->length);
+        if(strings->bytes == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(strings->bytes, records + header->count * recordSize, strings->length);
+    }
+
+    unmapFile(map, fileSize);
+    STAT_RECORD(STAT_PARSE, start);
+    return result;
+}
+
+/**
+ * Writes a record array and its strings (if any) as a binary data file
+ * (header + raw records + string arena) to the temporary file next to
+ * `path`. Returns 0 on success, -1 on failure.
+ */
+int saveBinaryFile(const char *path, const char magic[4], size_t recordSize,
+                   const void *items, size_t count, const StringArena *strings)
+{
+    uint64_t start = STAT_START();
+    char temp[64];
+    snprintf(temp, sizeof(temp), "%s" TEMP_SUFFIX, path);
+    FILE *fp = fopen(temp, "wb");
+    if(fp == NULL)
+    {
+        printf("Failed to open %s for writing!\n", path);
+        return -1;
+    }
+
+    BinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, 4);
+    header.version    = BINARY_FORMAT_VERSION;
+    header.recordSize = (uint32_t)recordSize;
+    header.count      = count;
+    header.checksum   = checksum64(items, count * recordSize);
+    size_t stringSize = (strings != NULL) ? strings->length : 0;
+    header.stringSize     = stringSize;
+    header.stringChecksum = checksum64(stringSize > 0 ? strings->bytes : "", stringSize);
+
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             (count == 0 || fwrite(items, recordSize, count, fp) == count) &&
+             (stringSize == 0 || fwrite(strings->bytes, 1, stringSize, fp) == stringSize);
+    STAT_RECORD(STAT_WRITE, start);
+    if(!ok)
+    {
+        fclose(fp);
+        printf("Failed to write %s!\n", path);
+        return -1;
+    }
+    return closeDurable(fp, temp);
+}
+
+/**
+ * Converts the data files between the text and binary formats. The current
+ * data (including any pending log entries) is loaded, written out in the
+ * requested format, and the files of the other format are removed.
+ * Returns the process exit code.
+ */
+int convertLibrary(int toBinary)
+{
+    loadLibrary();
+
+    library.binaryFormat = toBinary;
+    compactLibrary();
+
+    if(toBinary)
+    {
+        remove(BOOKS_FILE);
+        remove(MEMBERS_FILE);
+        remove(BORROWS_FILE);
+    }
+    else
+    {
+        remove(BOOKS_BIN_FILE);
+        remove(MEMBERS_BIN_FILE);
+        remove(BORROWS_BIN_FILE);
+    }
+
+    printf("Converted %zu books, %zu members and %zu borrow records to %s format.\n",
+           library.books.count, library.members.count, library.borrows.count,
+           toBinary ? "binary" : "text");
+    freeLibrary();
+    return 0;
+}
+
+/*
+    -------------------------
+    ARCHIVE
+    -------------------------
+*/
+
+/*
+    --archive [--no-compress] moves every returned loan out of the borrow
+    table into immutable archive segments, one per year of the borrow date
+    and archiving run:
+
+        archive/borrows-<yyyy>-<seq>.arc
+
+    A segment is never modified once written; archiving again adds segments
+    with the next sequence number. Afterwards the borrow data file only
+    holds the open loans, so loading and saving it no longer costs
+    O(history). The segments and the new data files are one save (see
+    DURABILITY): the segments are written under TEMP_SUFFIX and named in
+    SAVE_FILE next to the data files, so after a crash recoverFiles either
+    moves all of them into place or discards all of them. A loan is thus
+    never both archived and in the borrow file, nor lost.
+
+    Compressed segments keep the loans ordered by borrow day:
+
+        member dictionary  memberCount sorted 12-byte member IDs
+        per loan (varint)  borrow day - previous borrow day, loan length in
+                           days, book ID, member dictionary index
+
+    --no-compress writes fixed-size ArchivedBorrow records instead. Both
+    keep member IDs as text, so segments do not depend on how the borrow
+    table stores them.
+
+    History queries (the full borrow list, a member's loans, a date range)
+    only open the segments when they run. The day range in the header lets
+    a date query skip whole segments, and the dictionary lets a member query
+    skip the segments that member does not appear in.
+*/
+
+/**
+ * Appends an unsigned LEB128 varint to a growable byte buffer.
+ */
+static void putVarint(uint8_t **buf, size_t *size, size_t *capacity, uint64_t value)
+{
+    while(*size + 10 > *capacity)
+        *buf = growTable(*buf, capacity, 1);
+    do
+    {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        (*buf)[(*size)++] = byte | (value != 0 ? 0x80 : 0);
+    } while(value != 0);
+}
+
+/**
+ * Reads a varint and advances *p past it. Returns 0 on success, -1 if the
+ * data ends in the middle of it.
+ */
+static int getVarint(const uint8_t **p, const uint8_t *end, uint64_t *value)
+{
+    uint64_t v = 0;
+    for(int shift = 0; shift < 64 && *p < end; shift += 7)
+    {
+        uint8_t byte = *(*p)++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if((byte & 0x80) == 0)
+        {
+            *value = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Maps signed values to unsigned ones so small magnitudes stay short varints
+static uint64_t zigzagEncode(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static int64_t  zigzagDecode(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+static int compareBorrowDays(const void *a, const void *b)
+{
+    const Borrow *x = a, *y = b;
+    if(x->borrowDay != y->borrowDay)
+        return (x->borrowDay < y->borrowDay) ? -1 : 1;
+    return (x->bookID > y->bookID) - (x->bookID < y->bookID);
+}
+
+static int compareMemberKeys(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+static int compareSegmentNames(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Returns the calendar year of a day number.
+ */
+static int dayYear(int32_t day)
+{
+    char date[11];
+    formatDate(day, date);
+    return atoi(date + 6);
+}
+
+/**
+ * Writes loans (sorted by borrow day) as an archive segment at `path`.
+ * Returns 0 on success, -1 on failure.
+ */
+static int writeSegment(const char *path, const Borrow *loans, size_t count, int compress)
+{
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "BARC", 4);
+    header.version  = ARCHIVE_FORMAT_VERSION;
+    header.count    = count;
+    header.firstDay = loans[0].borrowDay;
+    header.lastDay  = loans[count - 1].borrowDay;
+
+    uint8_t *payload = NULL;
+    size_t size = 0, capacity = 0;
+
+    if(!compress)
+    {
+        payload = malloc(count * sizeof(ArchivedBorrow));
+        if(payload == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        for(size_t i = 0; i < count; i++)
+        {
+            ArchivedBorrow record;
+            memset(&record, 0, sizeof(record));
+            record.bookID    = loans[i].bookID;
+            record.borrowDay = loans[i].borrowDay;
+            record.returnDay = loans[i].returnDay;
+            formatMemberKey(loans[i].memberID, record.memberID);
+            memcpy(payload + i * sizeof(record), &record, sizeof(record));
+        }
+        size = count * sizeof(ArchivedBorrow);
+    }
+    else
+    {
+        header.flags = ARCHIVE_COMPRESSED;
+
+        // Member dictionary: the distinct member IDs of the segment, sorted
+        char (*dict)[12] = malloc(count * sizeof(*dict));
+        if(dict == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        for(size_t i = 0; i < count; i++)
+            formatMemberKey(loans[i].memberID, dict[i]);
+        qsort(dict, count, sizeof(*dict), compareMemberKeys);
+        size_t members = 0;
+        for(size_t i = 0; i < count; i++)
+        {
+            if(members == 0 || strcmp(dict[members - 1], dict[i]) != 0)
+                memcpy(dict[members++], dict[i], sizeof(dict[i]));
+        }
+        header.memberCount = (uint32_t)members;
+
+        while(capacity < members * sizeof(*dict))
+            payload = growTable(payload, &capacity, 1);
+        memcpy(payload, dict, members * sizeof(*dict));
+        size = members * sizeof(*dict);
+
+        int32_t previous = header.firstDay;
+        for(size_t i = 0; i < count; i++)
+        {
+            const Borrow *loan = &loans[i];
+            char id[12];
+            formatMemberKey(loan->memberID, id);
+            const char (*entry)[12] = bsearch(id, dict, members, sizeof(*dict), compareMemberKeys);
+            putVarint(&payload, &size, &capacity, (uint64_t)(loan->borrowDay - previous));
+            putVarint(&payload, &size, &capacity, zigzagEncode((int64_t)loan->returnDay - loan->borrowDay));
+            putVarint(&payload, &size, &capacity, zigzagEncode(loan->bookID));
+            putVarint(&payload, &size, &capacity, (uint64_t)(entry - (const char (*)[12])dict));
+            previous = loan->borrowDay;
+        }
+        free(dict);
+    }
+
+    header.payloadSize = size;
+    header.checksum    = checksum64(payload, size);
+
+    FILE *fp = fopen(path, "wb");
+    int ok = fp != NULL &&
+             fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(payload, 1, size, fp) == size;
+    free(payload);
+
+    if(!ok)
+    {
+        printf("Failed to write %s!\n", path);
+        if(fp != NULL)
+            fclose(fp);
+        remove(path);
+        return -1;
+    }
+    return closeDurable(fp, path);
+}
+
+/**
+ * Decodes the loans of one segment and passes those that match the member
+ * key (MEMBER_NONE: any) and borrow day range to `visit`.
+ * Returns the number of loans visited, or -1 if the segment is damaged.
+ */
+static long visitSegment(const char *path, uint64_t memberID, int32_t fromDay, int32_t toDay,
+                         ArchiveVisitor visit, void *ctx)
+{
+    size_t fileSize = 0;
+    void *map = mapFile(path, &fileSize);
+    if(map == NULL || fileSize < sizeof(ArchiveHeader))
+    {
+        unmapFile(map, fileSize);
+        return -1;
+    }
+
+    const ArchiveHeader *header = map;
+    const uint8_t *p   = (const uint8_t *)map + sizeof(ArchiveHeader);
+    const uint8_t *end = (const uint8_t *)map + fileSize;
+    const char (*dict)[12] = (const void *)p;
+    long visited = 0;
+
+    if(memcmp(header->magic, "BARC", 4) != 0 || header->version != ARCHIVE_FORMAT_VERSION ||
+       header->payloadSize != fileSize - sizeof(ArchiveHeader) ||
+       checksum64(p, (size_t)header->payloadSize) != header->checksum)
+        visited = -1;
+    else if(header->lastDay < fromDay || header->firstDay > toDay)
+        ; // No loan of this segment is in the range
+    else if((header->flags & ARCHIVE_COMPRESSED) == 0)
+    {
+        if(header->payloadSize != header->count * sizeof(ArchivedBorrow))
+            visited = -1;
+        for(size_t i = 0; visited >= 0 && i < header->count; i++)
+        {
+            ArchivedBorrow record;
+            memcpy(&record, p + i * sizeof(record), sizeof(record));
+            record.memberID[sizeof(record.memberID) - 1] = '\0';
+
+            Borrow loan;
+            loan.memberID  = memberKey(record.memberID);
+            loan.bookID    = record.bookID;
+            loan.borrowDay = record.borrowDay;
+            loan.returnDay = record.returnDay;
+            if((memberID == MEMBER_NONE || loan.memberID == memberID) &&
+               loan.borrowDay >= fromDay && loan.borrowDay <= toDay)
+            {
+                visit(&loan, ctx);
+                visited++;
+            }
+        }
+    }
+    else if(header->payloadSize < (uint64_t)header->memberCount * sizeof(*dict))
+        visited = -1;
+    else
+    {
+        size_t members = header->memberCount;
+        size_t target = SIZE_MAX;
+        if(memberID != MEMBER_NONE)
+        {
+            char id[12];
+            formatMemberKey(memberID, id);
+            const char (*entry)[12] = bsearch(id, dict, members, sizeof(*dict), compareMemberKeys);
+            if(entry == NULL)
+            {
+                unmapFile(map, fileSize);
+                return 0; // The member has no loans in this segment
+            }
+            target = (size_t)(entry - dict);
+        }
+
+        p += members * sizeof(*dict);
+        int32_t day = header->firstDay;
+        for(size_t i = 0; i < header->count; i++)
+        {
+            uint64_t delta, length, book, member;
+            if(getVarint(&p, end, &delta) != 0 || getVarint(&p, end, &length) != 0 ||
+               getVarint(&p, end, &book) != 0 || getVarint(&p, end, &member) != 0 ||
+               member >= members)
+            {
+                visited = -1;
+                break;
+            }
+            day += (int32_t)delta;
+            if(day > toDay)
+                break; // Loans are in borrow day order
+            if((target != SIZE_MAX && member != target) || day < fromDay)
+                continue;
+
+            char id[12];
+            memcpy(id, dict[member], sizeof(id));
+            id[sizeof(id) - 1] = '\0';
+
+            Borrow loan;
+            loan.memberID  = memberKey(id);
+            loan.bookID    = (int)zigzagDecode(book);
+            loan.borrowDay = day;
+            loan.returnDay = (int32_t)(day + zigzagDecode(length));
+            visit(&loan, ctx);
+            visited++;
+        }
+    }
+
+    unmapFile(map, fileSize);
+    return visited;
+}
+
+/**
+ * Returns the sorted names of the archive segments (caller frees each name
+ * and the array) and stores their number in *count.
+ */
+static char **listSegments(size_t *count)
+{
+    char **names = NULL;
+    size_t capacity = 0;
+    *count = 0;
+
+    DIR *dir = opendir(ARCHIVE_DIR);
+    if(dir == NULL)
+        return NULL;
+
+    struct dirent *entry;
+    while((entry = readdir(dir)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if(strncmp(entry->d_name, "borrows-", 8) != 0 || len < 4 ||
+           strcmp(entry->d_name + len - 4, ".arc") != 0)
+            continue;
+        if(*count == capacity)
+            names = growTable(names, &capacity, sizeof(char *));
+        names[(*count)++] = strdup(entry->d_name);
+    }
+    closedir(dir);
+
+    qsort(names, *count, sizeof(char *), compareSegmentNames);
+    return names;
+}
+
+/**
+ * Runs a history query over every archive segment: each archived loan of
+ * `memberID` (MEMBER_NONE: any member) borrowed in [fromDay, toDay] is passed to
+ * `visit`, oldest segment first. Damaged segments are reported and skipped.
+ * Returns the number of loans visited.
+ */
+size_t visitArchive(uint64_t memberID, int32_t fromDay, int32_t toDay,
+                    ArchiveVisitor visit, void *ctx)
+{
+    size_t count = 0, visited = 0;
+    char **names = listSegments(&count);
+
+    for(size_t i = 0; i < count; i++)
+    {
+        char path[300];
+        snprintf(path, sizeof(path), "%s/%s", ARCHIVE_DIR, names[i]);
+        long n = visitSegment(path, memberID, fromDay, toDay, visit, ctx);
+        if(n < 0)
+            printf("%s: damaged archive segment skipped!\n", path);
+        else
+            visited += (size_t)n;
+        free(names[i]);
+    }
+    free(names);
+    return visited;
+}
+
+/**
+ * ArchiveVisitor that appends the loan to a BorrowTable.
+ */
+void collectBorrow(const Borrow *borrow, void *table)
+{
+    *appendBorrow(table) = *borrow;
+}
+
+/**
+ * Moves all returned loans into new archive segments and rewrites the data
+ * files with only the open loans left in the borrow table.
+ * Returns the process exit code.
+ */
+int archiveLibrary(int compress)
+{
+    loadLibrary();
+    beginWrite(); // Other desks wait until the borrow file is rewritten
+
+    BorrowTable *borrows = &library.borrows;
+    Borrow *closed = malloc((borrows->count > 0 ? borrows->count : 1) * sizeof(Borrow));
+    if(closed == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t closedCount = 0, kept = 0;
+    for(size_t i = 0; i < borrows->count; i++)
+    {
+        if(borrows->items[i].returnDay == DATE_OPEN)
+            borrows->items[kept++] = borrows->items[i];
+        else
+            closed[closedCount++] = borrows->items[i];
+    }
+
+    if(closedCount == 0)
+    {
+        printf("No returned loans to archive.\n");
+        free(closed);
+        endWrite();
+        freeLibrary();
+        return 0;
+    }
+
+    qsort(closed, closedCount, sizeof(Borrow), compareBorrowDays);
+    mkdir(ARCHIVE_DIR, 0755);
+
+    // Write every segment under a temporary name, one per year
+    char (*paths)[64] = malloc(closedCount * sizeof(*paths));
+    const char **names = malloc(closedCount * sizeof(*names));
+    if(paths == NULL || names == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    int segments = 0;
+    int failed = 0;
+    for(size_t start = 0, stop; start < closedCount && !failed; start = stop)
+    {
+        int year = dayYear(closed[start].borrowDay);
+        for(stop = start; stop < closedCount && dayYear(closed[stop].borrowDay) == year; stop++)
+            ;
+
+        char temp[80];
+        for(unsigned seq = 0; ; seq++)
+        {
+            snprintf(paths[segments], sizeof(paths[segments]), "%s/borrows-%04d-%04u.arc", ARCHIVE_DIR, year, seq);
+            if(!fileExists(paths[segments]))
+                break;
+        }
+        snprintf(temp, sizeof(temp), "%s" TEMP_SUFFIX, paths[segments]);
+        if(writeSegment(temp, closed + start, stop - start, compress) != 0)
+            failed = 1;
+        else
+        {
+            names[segments] = paths[segments];
+            segments++;
+        }
+    }
+    free(closed);
+
+    // The segments are moved into place by the same save that drops the
+    // archived loans from the borrow file, so a crash leaves both or neither
+    if(!failed)
+    {
+        syncDirectory(ARCHIVE_DIR);
+        syncDirectory(".");
+        borrows->count = kept;
+        buildOpenLoans();
+        buildMemberLoans();
+        failed = compactWithFiles(names, segments) != 0;
+    }
+    else
+        removeTempFiles();
+    free(names);
+    free(paths);
+    endWrite();
+
+    if(failed)
+    {
+        printf("Archiving failed; the borrow records were left unchanged.\n");
+        freeLibrary();
+        return 1;
+    }
+
+    printf("Archived %zu returned loan(s) into %d segment(s); %zu loan(s) remain in the borrow file.\n",
+           closedCount, segments, kept);
+    freeLibrary();
+    return 0;
+}
+
+/*
+    -------------------------
+    TABLE OPERATIONS
+    -------------------------
+*/
+
+/**
+ * Doubles the capacity of a record array (or allocates the initial one).
+ * Exits the program if memory cannot be allocated.
+ * Returns the (possibly moved) array.
+ */
+void *growTable(void *items, size_t *capacity, size_t elemSize)
+{
+    size_t newCapacity = (*capacity == 0) ? TABLE_INITIAL_CAPACITY : *capacity * 2;
+    void *grown = realloc(items, newCapacity * elemSize);
+    if(grown == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = newCapacity;
+    return grown;
+}
+
+/**
+ * Reserves a new slot at the end of the book table and returns it.
+ */
+Book *appendBook(BookTable *table)
+{
+    if(table->count == table->capacity)
+        table->items = growTable(table->items, &table->capacity, sizeof(Book));
+    return &table->items[table->count++];
+}
+
+/**
+ * Reserves a new slot at the end of the member table and returns it.
+ */
+Member *appendMember(MemberTable *table)
+{
+    if(table->count == table->capacity)
+        table->items = growTable(table->items, &table->capacity, sizeof(Member));
+    return &table->items[table->count++];
+}
+
+/**
+ * Reserves a new slot at the end of the borrow table and returns it.
+ */
+Borrow *appendBorrow(BorrowTable *table)
+{
+    if(table->count == table->capacity)
+        table->items = growTable(table->items, &table->capacity, sizeof(Borrow));
+    return &table->items[table->count++];
+}
+
+/*
+    -------------------------
+    INDEX OPERATIONS
+    -------------------------
+*/
+
+/**
+ * Mixes the bits of a 64-bit value (splitmix64 finalizer) so that
+ * sequential keys spread evenly over the slots.
+ */
+static uint64_t mixHash(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Hashes a book ID.
+ */
+uint64_t hashBookID(int id)
+{
+    return mixHash((uint64_t)(uint32_t)id);
+}
+
+/**
+ * Hashes a string (FNV-1a, then mixed).
+ */
+uint64_t hashString(const char *text)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(; *text != '\0'; text++)
+    {
+        h ^= (unsigned char)*text;
+        h *= 0x100000001b3ULL;
+    }
+    return mixHash(h);
+}
+
+/**
+ * Hashes `length` bytes of text; equal to hashString of the same string.
+ */
+uint64_t hashBytes(const char *text, size_t length)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < length; i++)
+    {
+        h ^= (unsigned char)text[i];
+        h *= 0x100000001b3ULL;
+    }
+    return mixHash(h);
+}
+
+/**
+ * Hashes a member key.
+ */
+uint64_t hashMemberID(uint64_t key)
+{
+    return mixHash(key);
+}
+
+/**
+ * Returns the row whose key matches, or INDEX_NOT_FOUND.
+ */
+size_t indexFind(const RowIndex *index, uint64_t hash, RowMatcher matches, const void *key)
+{
+    if(index->capacity == 0)
+        return INDEX_NOT_FOUND;
+
+    size_t mask = index->capacity - 1;
+    for(size_t pos = hash & mask; index->slots[pos].row != INDEX_EMPTY; pos = (pos + 1) & mask)
+    {
+        if(index->slots[pos].hash == hash && matches(index->slots[pos].row, key))
+            return index->slots[pos].row;
+    }
+    return INDEX_NOT_FOUND;
+}
+
+/**
+ * Places a hash/row pair in the first free slot of its probe sequence.
+ */
+static void indexPlace(IndexSlot *slots, size_t capacity, uint64_t hash, size_t row)
+{
+    size_t mask = capacity - 1;
+    size_t pos = hash & mask;
+    while(slots[pos].row != INDEX_EMPTY)
+        pos = (pos + 1) & mask;
+    slots[pos].hash = hash;
+    slots[pos].row  = row;
+}
+
+/**
+ * Resizes the slot array to the given power-of-two capacity.
+ */
+static void indexResize(RowIndex *index, size_t newCapacity)
+{
+    IndexSlot *slots = malloc(newCapacity * sizeof(IndexSlot));
+    if(slots == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < newCapacity; i++)
+        slots[i].row = INDEX_EMPTY;
+
+    for(size_t i = 0; i < index->capacity; i++)
+    {
+        if(index->slots[i].row != INDEX_EMPTY)
+            indexPlace(slots, newCapacity, index->slots[i].hash, index->slots[i].row);
+    }
+
+    free(index->slots);
+    index->slots    = slots;
+    index->capacity = newCapacity;
+}
+
+/**
+ * Adds a row to the index. The table is kept at most 70% full.
+ */
+void indexInsert(RowIndex *index, uint64_t hash, size_t row)
+{
+    if((index->count + 1) * 10 > index->capacity * 7)
+        indexResize(index, index->capacity == 0 ? INDEX_INITIAL_CAPACITY : index->capacity * 2);
+
+    indexPlace(index->slots, index->capacity, hash, row);
+    index->count++;
+}
+
+/**
+ * Returns the slot position holding the given hash/row pair, or INDEX_NOT_FOUND.
+ */
+static size_t indexSlotOf(const RowIndex *index, uint64_t hash, size_t row)
+{
+    if(index->capacity == 0)
+        return INDEX_NOT_FOUND;
+
+    size_t mask = index->capacity - 1;
+    for(size_t pos = hash & mask; index->slots[pos].row != INDEX_EMPTY; pos = (pos + 1) & mask)
+    {
+        if(index->slots[pos].row == row)
+            return pos;
+    }
+    return INDEX_NOT_FOUND;
+}
+
+/**
+ * Removes a row from the index. Later entries of the same probe run are
+ * shifted back into the hole, so no tombstones are left behind.
+ */
+void indexRemove(RowIndex *index, uint64_t hash, size_t row)
+{
+    size_t hole = indexSlotOf(index, hash, row);
+    if(hole == INDEX_NOT_FOUND)
+        return;
+
+    size_t mask = index->capacity - 1;
+    for(size_t next = (hole + 1) & mask; index->slots[next].row != INDEX_EMPTY; next = (next + 1) & mask)
+    {
+        size_t home = index->slots[next].hash & mask;
+        // The entry may fill the hole only if the hole lies between its home slot and itself
+        if(((next - home) & mask) >= ((next - hole) & mask))
+        {
+            index->slots[hole] = index->slots[next];
+            hole = next;
+        }
+    }
+    index->slots[hole].row = INDEX_EMPTY;
+    index->count--;
+}
+
+/**
+ * Updates the row number of an indexed record that was moved in its table.
+ */
+void indexMoveRow(RowIndex *index, uint64_t hash, size_t oldRow, size_t newRow)
+{
+    size_t pos = indexSlotOf(index, hash, oldRow);
+    if(pos != INDEX_NOT_FOUND)
+        index->slots[pos].row = newRow;
+}
+
+/**
+ * Releases the memory held by an index.
+ */
+void freeIndex(RowIndex *index)
+{
+    free(index->slots);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * Rebuilds the book and member indexes from the loaded tables.
+ */
+void buildIndexes()
+{
+    freeIndex(&library.bookIndex);
+    freeIndex(&library.memberIndex);
+
+    for(size_t i = 0; i < library.books.count; i++)
+        indexInsert(&library.bookIndex, hashBookID(library.books.items[i].ID), i);
+    for(size_t i = 0; i < library.members.count; i++)
+        indexInsert(&library.memberIndex, hashMemberID(library.members.items[i].ID), i);
+
+    buildAvailability();
+    buildOpenLoans();
+    buildMemberLoans();
+    buildTextIndex();
+    buildSortedViews();
+}
+
+static int bookRowMatches(size_t row, const void *key)
+{
+    return library.books.items[row].ID == *(const int *)key;
+}
+
+static int memberRowMatches(size_t row, const void *key)
+{
+    return library.members.items[row].ID == *(const uint64_t *)key;
+}
+
+/**
+ * Looks up a book by ID through the index.
+ * Returns a pointer into the book table, or NULL if there is no such book.
+ */
+Book *findBook(int id)
+{
+    uint64_t start = STAT_START_SAMPLED();
+    size_t row = indexFind(&library.bookIndex, hashBookID(id), bookRowMatches, &id);
+    STAT_RECORD_SAMPLED(STAT_LOOKUP, start);
+    return (row == INDEX_NOT_FOUND) ? NULL : &library.books.items[row];
+}
+
+/**
+ * Looks up a member by ID through the index.
+ * Returns a pointer into the member table, or NULL if there is no such member.
+ */
+Member *findMember(uint64_t key)
+{
+    uint64_t start = STAT_START_SAMPLED();
+    size_t row = indexFind(&library.memberIndex, hashMemberID(key), memberRowMatches, &key);
+    STAT_RECORD_SAMPLED(STAT_LOOKUP, start);
+    return (row == INDEX_NOT_FOUND) ? NULL : &library.members.items[row];
+}
+
+/*
+    -------------------------
+    TEXT PARSER
+    -------------------------
+*/
+
+/*
+    The .txt data files are parsed straight out of a read-only mapping.
+    Delimiters are located eight bytes at a time: XOR-ing a word with a
+    repeated delimiter byte turns matching bytes into zero bytes, which the
+    classic "has zero byte" bit trick detects without a per-byte branch.
+*/
+
+#define REPEAT_BYTE(b) (0x0101010101010101ULL * (uint8_t)(b))
+
+static inline uint64_t zeroByteMask(uint64_t word)
+{
+    return (word - REPEAT_BYTE(0x01)) & ~word & REPEAT_BYTE(0x80);
+}
+
+/**
+ * Returns a pointer to the first '|' or '\n' in [p, end), or end.
+ */
+const char *findDelimiter(const char *p, const char *end)
+{
+    while(end - p >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        if(zeroByteMask(word ^ REPEAT_BYTE('|')) | zeroByteMask(word ^ REPEAT_BYTE('\n')))
+            break;
+        p += 8;
+    }
+    while(p < end && *p != '|' && *p != '\n')
+        p++;
+    return p;
+}
+
+/**
+ * Parses a '|'-delimited data file. Every non-blank line must have exactly
+ * `fieldCount` fields; each line is handed to `parse` to build a record.
+ * Malformed lines are skipped and reported with their line number.
+ * Returns the number of records loaded.
+ */
+size_t parseDataFile(const char *path, int fieldCount, RecordParser parse, void *table)
+{
+    uint64_t start = STAT_START();
+    size_t size = 0;
+    const char *data = mapFile(path, &size);
+    if(data == NULL)
+        return 0; // If file doesn't exist (or is empty), return 0
+
+    const char *p   = data;
+    const char *end = data + size;
+    size_t lineNo = 0, loaded = 0, rejected = 0;
+
+    while(p < end)
+    {
+        TextField fields[MAX_TEXT_FIELDS];
+        int n = 0;
+        lineNo++;
+
+        // Split the line into fields
+        for(;;)
+        {
+            const char *d = findDelimiter(p, end);
+            if(n < MAX_TEXT_FIELDS)
+            {
+                fields[n].start  = p;
+                fields[n].length = (size_t)(d - p);
+            }
+            n++;
+            if(d == end || *d == '\n')
+            {
+                p = (d == end) ? end : d + 1;
+                break;
+            }
+            p = d + 1;
+        }
+
+        // Tolerate Windows line endings
+        TextField *last = &fields[(n < MAX_TEXT_FIELDS ? n : MAX_TEXT_FIELDS) - 1];
+        if(last->length > 0 && last->start[last->length - 1] == '\r')
+            last->length--;
+
+        if(n == 1 && fields[0].length == 0)
+            continue; // Blank line
+
+        const char *error;
+        char message[64];
+        if(n != fieldCount)
+        {
+            snprintf(message, sizeof(message), "expected %d fields, found %d", fieldCount, n);
+            error = message;
+        }
+        else
+        {
+            error = parse(fields, table);
+        }
+
+        if(error == NULL)
+        {
+            loaded++;
+        }
+        else if(++rejected <= PARSE_ERROR_REPORT_LIMIT)
+        {
+            printf("%s:%zu: skipped malformed line (%s)\n", path, lineNo, error);
+        }
+    }
+
+    if(rejected > PARSE_ERROR_REPORT_LIMIT)
+        printf("%s: %zu malformed lines skipped in total\n", path, rejected);
+
+    unmapFile((void *)data, size);
+    STAT_RECORD(STAT_PARSE, start);
+    return loaded;
+}
+
+/**
+ * Parses a decimal integer field (optional leading '-').
+ * Returns 0 on success, -1 if the field is not a valid int.
+ */
+int parseIntField(const TextField *field, int *value)
+{
+    const char *p = field->start;
+    size_t len = field->length;
+    int negative = 0;
+
+    if(len > 0 && *p == '-')
+    {
+        negative = 1;
+        p++;
+        len--;
+    }
+    if(len == 0 || len > 10)
+        return -1;
+
+    long long v = 0;
+    for(size_t i = 0; i < len; i++)
+    {
+        if(p[i] < '0' || p[i] > '9')
+            return -1;
+        v = v * 10 + (p[i] - '0');
+    }
+    if(negative)
+        v = -v;
+    if(v < INT32_MIN || v > INT32_MAX)
+        return -1;
+
+    *value = (int)v;
+    return 0;
+}
+
+/**
+ * Parses an 11-digit member ID field into its member key (see memberKey).
+ * Returns 0 on success, -1 if the field is not a valid member ID.
+ */
+int parseMemberField(const TextField *field, uint64_t *key)
+{
+    if(field->length != 11)
+        return -1;
+
+    uint64_t v = 0;
+    for(size_t i = 0; i < 11; i++)
+    {
+        if(field->start[i] < '0' || field->start[i] > '9')
+            return -1;
+        v = v * 10 + (uint64_t)(field->start[i] - '0');
+    }
+    *key = v;
+    return 0;
+}
+
+/**
+ * Copies a non-empty field into a fixed-size string buffer.
+ * Returns 0 on success, -1 if the field is empty or does not fit.
+ */
+int copyField(char *dst, size_t size, const TextField *field)
+{
+    if(field->length == 0 || field->length >= size)
+        return -1;
+    memcpy(dst, field->start, field->length);
+    dst[field->length] = '\0';
+    return 0;
+}
+
+/**
+ * Parses a dd/mm/yyyy field into a day number.
+ * Returns 0 on success, -1 if the field is not a valid date.
+ */
+int parseDateField(const TextField *field, int32_t *day)
+{
+    char date[11];
+    if(field->length != 10)
+        return -1;
+    memcpy(date, field->start, 10);
+    date[10] = '\0';
+    return parseDate(date, day);
+}
+
+/*
+    -------------------------
+    STRING ARENA
+    -------------------------
+*/
+
+typedef struct {
+    const StringArena *arena;
+    const char        *text;
+    size_t             length;
+} ArenaKey;
+
+static int arenaTextMatches(size_t offset, const void *key)
+{
+    const ArenaKey *k = key;
+    const char *stored = k->arena->bytes + offset;
+    return strncmp(stored, k->text, k->length) == 0 && stored[k->length] == '\0';
+}
+
+/**
+ * Indexes every string of an arena by its hash. Arenas loaded from a
+ * binary file are built lazily, by the first string interned into them.
+ */
+static void buildArenaLookup(StringArena *arena)
+{
+    freeIndex(&arena->lookup);
+    for(size_t offset = 0; offset < arena->length; )
+    {
+        size_t length = strlen(arena->bytes + offset);
+        indexInsert(&arena->lookup, hashBytes(arena->bytes + offset, length), offset);
+        offset += length + 1;
+    }
+}
+
+/**
+ * Returns the offset of `length` bytes of text in the arena, adding the
+ * text (NUL-terminated) if the arena does not hold it yet. The arena may
+ * move, so pointers into it are only valid until the next call.
+ */
+uint32_t internText(StringArena *arena, const char *text, size_t length)
+{
+    if(arena->length == 0)
+    {
+        // Offset 0 is the empty string
+        if(arena->capacity == 0)
+            arena->bytes = growTable(arena->bytes, &arena->capacity, 1);
+        arena->bytes[0] = '\0';
+        arena->length = 1;
+    }
+    if(arena->lookup.count == 0)
+        buildArenaLookup(arena);
+
+    uint64_t hash = hashBytes(text, length);
+    ArenaKey key = { arena, text, length };
+    size_t found = indexFind(&arena->lookup, hash, arenaTextMatches, &key);
+    if(found != INDEX_NOT_FOUND)
+        return (uint32_t)found;
+
+    if(arena->length + length + 1 > UINT32_MAX)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    while(arena->length + length + 1 > arena->capacity)
+        arena->bytes = growTable(arena->bytes, &arena->capacity, 1);
+
+    size_t offset = arena->length;
+    memcpy(arena->bytes + offset, text, length);
+    arena->bytes[offset + length] = '\0';
+    arena->length += length + 1;
+    indexInsert(&arena->lookup, hash, offset);
+    return (uint32_t)offset;
+}
+
+/**
+ * Interns a text field read from a data file into `*ref`.
+ * Returns -1 if the field is empty or longer than MAX_TEXT_BYTES.
+ */
+int internField(StringArena *arena, const TextField *field, uint32_t *ref)
+{
+    if(field->length == 0 || field->length > MAX_TEXT_BYTES)
+        return -1;
+    *ref = internText(arena, field->start, field->length);
+    return 0;
+}
+
+/**
+ * Returns the offset of a string the arena already holds, or 0 if it does
+ * not hold it. Never builds the lookup, so parallel readers may call it.
+ */
+uint32_t findText(const StringArena *arena, const char *text)
+{
+    size_t length = strlen(text);
+    if(length == 0)
+        return 0;
+
+    if(arena->lookup.count > 0)
+    {
+        ArenaKey key = { arena, text, length };
+        size_t found = indexFind(&arena->lookup, hashBytes(text, length), arenaTextMatches, &key);
+        return (found == INDEX_NOT_FOUND) ? 0 : (uint32_t)found;
+    }
+    for(size_t offset = 0; offset < arena->length; offset += strlen(arena->bytes + offset) + 1)
+    {
+        if(strcmp(arena->bytes + offset, text) == 0)
+            return (uint32_t)offset;
+    }
+    return 0;
+}
+
+const char *bookTitle(const Book *book)
+{
+    return library.bookText.bytes + book->title;
+}
+
+const char *bookAuthor(const Book *book)
+{
+    return library.bookText.bytes + book->author;
+}
+
+const char *memberName(const Member *member)
+{
+    return library.memberText.bytes + member->name;
+}
+
+const char *memberPhone(const Member *member)
+{
+    return library.memberText.bytes + member->phone;
+}
+
+/**
+ * Checks a table's string references after loading it from a binary file:
+ * the arena must start with the empty string and end with a NUL, and the
+ * two consecutive offsets at `refOffset` in every record must fall inside
+ * it. Returns 0 if they do, -1 otherwise.
+ */
+int checkStrings(const StringArena *arena, const void *records, size_t refOffset,
+                 size_t recordSize, size_t count)
+{
+    if(count == 0)
+        return 0;
+    if(arena->length == 0 || arena->bytes[0] != '\0' || arena->bytes[arena->length - 1] != '\0')
+        return -1;
+
+    const unsigned char *p = (const unsigned char *)records + refOffset;
+    for(size_t i = 0; i < count; i++, p += recordSize)
+    {
+        uint32_t ref[2];
+        memcpy(ref, p, sizeof(ref));
+        if(ref[0] >= arena->length || ref[1] >= arena->length)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * Moves a string into a fresh arena and returns its new offset.
+ */
+static uint32_t repackText(StringArena *to, const StringArena *from, uint32_t offset)
+{
+    const char *text = from->bytes + offset;
+    return internText(to, text, strlen(text));
+}
+
+/**
+ * Rebuilds both arenas with only the strings the records still use, in
+ * record order. Strings of deleted records otherwise stay in the arena
+ * until the next load; this runs before the data files are saved, under
+ * the write lock.
+ */
+void packStrings()
+{
+    pruneSortedViews(); // While their text offsets still tell deleted records apart
+    StringArena books = {0}, members = {0};
+    for(size_t i = 0; i < library.books.count; i++)
+    {
+        Book *book = &library.books.items[i];
+        book->title  = repackText(&books, &library.bookText, book->title);
+        book->author = repackText(&books, &library.bookText, book->author);
+    }
+    for(size_t i = 0; i < library.members.count; i++)
+    {
+        Member *member = &library.members.items[i];
+        member->name  = repackText(&members, &library.memberText, member->name);
+        member->phone = repackText(&members, &library.memberText, member->phone);
+    }
+
+    freeArena(&library.bookText);
+    freeArena(&library.memberText);
+    library.bookText   = books;
+    library.memberText = members;
+    repackSortedViews();
+}
+
+/**
+ * Releases the memory held by an arena.
+ */
+void freeArena(StringArena *arena)
+{
+    free(arena->bytes);
+    freeIndex(&arena->lookup);
+    memset(arena, 0, sizeof(*arena));
+}
+
+/*
+    -------------------------
+    OPEN LOANS
+    -------------------------
+*/
+
+/*
+    The date index is not kept in order on every change: shifting a sorted
+    array would make each return, and each borrow dated before the newest
+    open loan, cost O(open loans). A borrow appends its entry unsorted and
+    a return only counts it. The first reader after a change that needs the
+    order (openLoanDateBound) drops the returned loans, sorts the new
+    entries and merges them in, in O(open loans) once for all the changes
+    since. Writers restore the order themselves once the unsorted and
+    returned entries exceed half the open loans, so the index stays within
+    1.5 times its size and the reader's merge stays bounded.
+
+    The trade-off: a report that follows every single write pays the
+    O(open loans) pass each time, as the shifting did, while bursts of
+    borrows and returns (batch runs, log replay, busy desks) pay it once.
+    As with the sorted views, the order is only restored while no other
+    reader can be holding positions in the index (see sortedView).
+*/
+
+static pthread_mutex_t dateLock = PTHREAD_MUTEX_INITIALIZER; // Readers restoring the date order
+
+/**
+ * qsort comparator ordering open loans by borrow day, then book ID.
+ */
+static int compareLoanDates(const void *a, const void *b)
+{
+    const LoanDate *x = a, *y = b;
+    if(x->borrowDay != y->borrowDay)
+        return (x->borrowDay < y->borrowDay) ? -1 : 1;
+    return (x->bookID > y->bookID) - (x->bookID < y->bookID);
+}
+
+/**
+ * Appends an open loan to both arrays without restoring the date order.
+ */
+static void appendOpenLoan(size_t borrowRow)
+{
+    OpenLoans *open = &library.openLoans;
+    if(open->count == open->capacity)
+        open->rows = growTable(open->rows, &open->capacity, sizeof(size_t));
+    if(open->dated == open->dateCapacity)
+        open->byDate = growTable(open->byDate, &open->dateCapacity, sizeof(LoanDate));
+
+    const Borrow *borrow = &library.borrows.items[borrowRow];
+    open->rows[open->count] = borrowRow;
+    open->byDate[open->dated].borrowDay = borrow->borrowDay;
+    open->byDate[open->dated].bookID    = borrow->bookID;
+    indexInsert(&open->byBook, hashBookID(borrow->bookID), open->count);
+    open->count++;
+    open->dated++;
+}
+
+/**
+ * Restores the order of the date index when too many returned loans or
+ * unsorted new ones have piled up for the next reader to handle cheaply.
+ * Called by writers only.
+ */
+static void boundOpenLoanDates()
+{
+    const OpenLoans *open = &library.openLoans;
+    if(open->dated - open->datedSorted + open->returned > open->count / 2 + INDEX_INITIAL_CAPACITY)
+        sortOpenLoanDates();
+}
+
+/**
+ * Registers the borrow record at the given row as an open loan.
+ */
+void openLoanAdd(size_t borrowRow)
+{
+    appendOpenLoan(borrowRow);
+    boundOpenLoanDates();
+}
+
+/**
+ * Removes a book's open loan. The last open loan takes its position; the
+ * date index entry stays until the order is next restored.
+ */
+void openLoanRemove(int bookID)
+{
+    OpenLoans *open = &library.openLoans;
+    size_t pos = indexFind(&open->byBook, hashBookID(bookID), openLoanMatches, &bookID);
+    if(pos == INDEX_NOT_FOUND)
+        return;
+
+    size_t last = open->count - 1;
+    indexRemove(&open->byBook, hashBookID(bookID), pos);
+    if(pos != last)
+    {
+        open->rows[pos] = open->rows[last];
+        indexMoveRow(&open->byBook, hashBookID(library.borrows.items[open->rows[pos]].bookID), last, pos);
+    }
+    open->count--;
+    open->returned++;
+    boundOpenLoanDates();
+}
+
+/**
+ * Returns non-zero if a date index entry is still an open loan.
+ */
+static int loanDateCurrent(const LoanDate *entry)
+{
+    const Borrow *borrow = findOpenBorrow(entry->bookID);
+    return borrow != NULL && borrow->borrowDay == entry->borrowDay;
+}
+
+/**
+ * Brings the date index in order: drops the entries of returned loans,
+ * sorts the ones added since and merges them in. Readers may call it in
+ * parallel: the first one after a change does the work, the others wait.
+ */
+void sortOpenLoanDates()
+{
+    OpenLoans *open = &library.openLoans;
+    pthread_mutex_lock(&dateLock);
+    if(open->datedSorted == open->dated && open->returned == 0)
+    {
+        pthread_mutex_unlock(&dateLock);
+        return;
+    }
+
+    // Drop returned loans, keeping the sorted and the new entries apart
+    size_t out = 0, sorted = 0;
+    for(size_t i = 0; i < open->dated; i++)
+    {
+        if(i == open->datedSorted)
+            sorted = out;
+        if(loanDateCurrent(&open->byDate[i]))
+            open->byDate[out++] = open->byDate[i];
+    }
+    if(open->datedSorted == open->dated)
+        sorted = out;
+
+    // Merge the sorted new entries in from the back. Loans are mostly
+    // recorded in date order, so this is usually a plain append.
+    size_t added = out - sorted;
+    if(added > 0)
+    {
+        qsort(open->byDate + sorted, added, sizeof(LoanDate), compareLoanDates);
+        LoanDate *copy = malloc(added * sizeof(LoanDate));
+        if(copy == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(1);
+        }
+        memcpy(copy, open->byDate + sorted, added * sizeof(LoanDate));
+        size_t i = sorted, j = added, k = out;
+        while(j > 0)
+        {
+            if(i > 0 && compareLoanDates(&open->byDate[i - 1], &copy[j - 1]) > 0)
+                open->byDate[--k] = open->byDate[--i];
+            else
+                open->byDate[--k] = copy[--j];
+        }
+        free(copy);
+    }
+
+    // A loan returned and borrowed again on the same day is in twice
+    size_t n = 0;
+    for(size_t i = 0; i < out; i++)
+    {
+        if(n == 0 || compareLoanDates(&open->byDate[n - 1], &open->byDate[i]) != 0)
+            open->byDate[n++] = open->byDate[i];
+    }
+    open->dated = open->datedSorted = n;
+    open->returned = 0;
+    pthread_mutex_unlock(&dateLock);
+}
+
+/**
+ * Returns the position of the first open loan in date order that was
+ * borrowed on or after `day` (the open loan count if there is none).
+ * Restores the order first, so positions in open->byDate up to
+ * open->count are valid until the store next changes.
+ */
+size_t openLoanDateBound(int32_t day)
+{
+    sortOpenLoanDates();
+    const OpenLoans *open = &library.openLoans;
+    size_t lo = 0, hi = open->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(open->byDate[mid].borrowDay < day)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Rebuilds the open loan index from the borrow table and makes every
+ * book's status agree with it: a book is borrowed exactly when it has an
+ * open loan. Requires the book index and availability bitset to be built.
+ */
+void buildOpenLoans()
+{
+    freeOpenLoans();
+
+    const BorrowTable *borrows = &library.borrows;
+    for(size_t i = 0; i < borrows->count; i++)
+    {
+        if(borrows->items[i].returnDay == DATE_OPEN &&
+           findOpenBorrow(borrows->items[i].bookID) == NULL)
+            appendOpenLoan(i);
+    }
+    qsort(library.openLoans.byDate, library.openLoans.count, sizeof(LoanDate), compareLoanDates);
+    library.openLoans.datedSorted = library.openLoans.dated;
+
+    size_t corrected = 0;
+    for(size_t i = 0; i < library.books.count; i++)
+    {
+        Book *book = &library.books.items[i];
+        int status = (findOpenBorrow(book->ID) == NULL) ? 1 : 0;
+        if(book->status != status)
+        {
+            setBookStatus(book, status);
+            corrected++;
+        }
+    }
+    if(corrected > 0)
+        printf("Corrected the status of %zu book(s) to match the borrow records.\n", corrected);
+}
+
+/**
+ * Releases the memory held by the open loan index.
+ */
+void freeOpenLoans()
+{
+    free(library.openLoans.rows);
+    free(library.openLoans.byDate);
+    freeIndex(&library.openLoans.byBook);
+    memset(&library.openLoans, 0, sizeof(library.openLoans));
+}
+
+/*
+    -------------------------
+    AVAILABILITY
+    -------------------------
+*/
+
+/**
+ * Sets or clears the availability bit of a book row, growing the bitset
+ * as needed and keeping the count of available books.
+ */
+static void setAvailableBit(size_t row, int available)
+{
+    Availability *bits = &library.availability;
+    while(row / 64 >= bits->capacity)
+    {
+        size_t old = bits->capacity;
+        bits->words = growTable(bits->words, &bits->capacity, sizeof(uint64_t));
+        memset(&bits->words[old], 0, (bits->capacity - old) * sizeof(uint64_t));
+    }
+
+    uint64_t mask = 1ULL << (row % 64);
+    int was = (bits->words[row / 64] & mask) != 0;
+    if(available && !was)
+    {
+        bits->words[row / 64] |= mask;
+        bits->available++;
+    }
+    else if(!available && was)
+    {
+        bits->words[row / 64] &= ~mask;
+        bits->available--;
+    }
+}
+
+/**
+ * Changes a book's status. Every status change goes through here so the
+ * availability bitset stays in step with the book table.
+ */
+void setBookStatus(Book *book, int status)
+{
+    book->status = status;
+    setAvailableBit((size_t)(book - library.books.items), status == 1);
+}
+
+/**
+ * Returns the first book row at or after `row` that is available
+ * (`available` = 1) or borrowed (`available` = 0), or the book count if
+ * there is none. Rows are visited 64 at a time, so walking all books of
+ * one kind costs O(books / 64 + matches).
+ */
+size_t nextBookRow(size_t row, int available)
+{
+    const Availability *bits = &library.availability;
+    size_t count = library.books.count;
+
+    while(row < count)
+    {
+        uint64_t word = bits->words[row / 64];
+        if(!available)
+            word = ~word;
+        word &= ~0ULL << (row % 64); // Skip the rows before `row`
+        if(word != 0)
+        {
+            size_t next = (row - row % 64) + (size_t)__builtin_ctzll(word);
+            return (next < count) ? next : count;
+        }
+        row = row - row % 64 + 64;
+    }
+    return count;
+}
+
+/**
+ * Returns the number of available books in O(1).
+ */
+size_t countAvailable()
+{
+    return library.availability.available;
+}
+
+/**
+ * Rebuilds the availability bitset from the status of every book.
+ */
+void buildAvailability()
+{
+    Availability *bits = &library.availability;
+    if(bits->capacity > 0)
+        memset(bits->words, 0, bits->capacity * sizeof(uint64_t));
+    bits->available = 0;
+
+    const BookTable *books = &library.books;
+    if(books->count > 0)
+        setAvailableBit(books->count - 1, 0); // Allocate every word up front
+    for(size_t i = 0; i < books->count; i++)
+    {
+        if(books->items[i].status == 1)
+            bits->words[i / 64] |= 1ULL << (i % 64);
+    }
+    for(size_t i = 0; i < (books->count + 63) / 64; i++)
+        bits->available += (size_t)__builtin_popcountll(bits->words[i]);
+}
+
+/**
+ * Releases the memory held by the availability bitset.
+ */
+void freeAvailability()
+{
+    free(library.availability.words);
+    memset(&library.availability, 0, sizeof(library.availability));
+}
+
+/*
+    -------------------------
+    MEMBER LOANS
+    -------------------------
+*/
+
+static int memberLoansMatches(size_t pos, const void *key)
+{
+    const MemberLoans *ml = &library.memberLoans;
+    return library.borrows.items[ml->lists[pos].first].memberID == *(const uint64_t *)key;
+}
+
+/**
+ * Finds the loan list of a member. Returns NULL if the member has never
+ * borrowed a book.
+ */
+MemberLoanList *findMemberLoans(uint64_t memberID)
+{
+    const MemberLoans *ml = &library.memberLoans;
+    size_t pos = indexFind(&ml->byMember, hashMemberID(memberID), memberLoansMatches, &memberID);
+    return (pos == INDEX_NOT_FOUND) ? NULL : &ml->lists[pos];
+}
+
+/**
+ * Appends the borrow record at the given row to its member's loan list.
+ * Its open count is not changed; see insertBorrow and buildMemberLoans.
+ */
+static MemberLoanList *linkMemberLoan(size_t borrowRow)
+{
+    MemberLoans *ml = &library.memberLoans;
+    while(ml->nextCapacity <= borrowRow)
+        ml->next = growTable(ml->next, &ml->nextCapacity, sizeof(size_t));
+    ml->next[borrowRow] = INDEX_EMPTY;
+
+    uint64_t memberID = library.borrows.items[borrowRow].memberID;
+    uint64_t hash = hashMemberID(memberID);
+    size_t pos = indexFind(&ml->byMember, hash, memberLoansMatches, &memberID);
+    if(pos == INDEX_NOT_FOUND)
+    {
+        if(ml->count == ml->capacity)
+            ml->lists = growTable(ml->lists, &ml->capacity, sizeof(MemberLoanList));
+        pos = ml->count++;
+        ml->lists[pos].first = borrowRow;
+        ml->lists[pos].total = 0;
+        ml->lists[pos].open  = 0;
+        indexInsert(&ml->byMember, hash, pos);
+    }
+    else
+        ml->next[ml->lists[pos].last] = borrowRow;
+
+    MemberLoanList *list = &ml->lists[pos];
+    list->last = borrowRow;
+    list->total++;
+    return list;
+}
+
+/**
+ * Registers a new open loan at the given borrow row with its member.
+ */
+void memberLoansAdd(size_t borrowRow)
+{
+    linkMemberLoan(borrowRow)->open++;
+}
+
+/**
+ * Counts an open loan of a member as returned.
+ */
+void memberLoansClose(const Borrow *borrow)
+{
+    MemberLoanList *list = findMemberLoans(borrow->memberID);
+    if(list != NULL && list->open > 0)
+        list->open--;
+}
+
+/**
+ * Rebuilds the member loan index from the borrow table. Requires the open
+ * loan index to be built: only the loans it holds count as open.
+ */
+void buildMemberLoans()
+{
+    freeMemberLoans();
+
+    for(size_t i = 0; i < library.borrows.count; i++)
+        linkMemberLoan(i);
+
+    const OpenLoans *open = &library.openLoans;
+    for(size_t i = 0; i < open->count; i++)
+    {
+        findMemberLoans(library.borrows.items[open->rows[i]].memberID)->open++;
+    }
+}
+
+/**
+ * Releases the memory held by the member loan index.
+ */
+void freeMemberLoans()
+{
+    free(library.memberLoans.lists);
+    free(library.memberLoans.next);
+    freeIndex(&library.memberLoans.byMember);
+    memset(&library.memberLoans, 0, sizeof(library.memberLoans));
+}
+
+/*
+    -------------------------
+    TEXT INDEX
+    -------------------------
+*/
+
+/*
+    Words are split on ASCII punctuation and whitespace; every non-ASCII
+    character counts as part of a word. Case is folded with the Turkish
+    rules: I -> ı and İ -> i (not I -> i), plus Ç Ğ Ö Ş Ü and the other
+    Latin-1 capitals to their lowercase forms.
+*/
+
+/**
+ * Decodes one UTF-8 character and advances *p past it. Invalid bytes are
+ * returned as-is (interpreted as Latin-1) so no input is ever dropped.
+ */
+static uint32_t decodeUtf8(const unsigned char **p)
+{
+    const unsigned char *s = *p;
+    if(s[0] < 0x80)
+    {
+        *p += 1;
+        return s[0];
+    }
+    if((s[0] & 0xE0) == 0xC0 && (s[1] & 0xC0) == 0x80)
+    {
+        *p += 2;
+        return ((uint32_t)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+    }
+    if((s[0] & 0xF0) == 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80)
+    {
+        *p += 3;
+        return ((uint32_t)(s[0] & 0x0F) << 12) | ((uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+    }
+    if((s[0] & 0xF8) == 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80)
+    {
+        *p += 4;
+        return ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12) |
+               ((uint32_t)(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+    }
+    *p += 1;
+    return s[0];
+}
+
+/**
+ * Encodes a character as UTF-8. Returns the number of bytes written (1-4).
+ */
+static size_t encodeUtf8(uint32_t cp, char *out)
+{
+    if(cp < 0x80)
+    {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if(cp < 0x800)
+    {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if(cp < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/**
+ * Lowercases a character using Turkish case rules.
+ */
+static uint32_t foldTurkish(uint32_t cp)
+{
+    if(cp == 'I')    return 0x0131;     // I -> ı
+    if(cp == 0x0130) return 'i';        // İ -> i
+    if(cp >= 'A' && cp <= 'Z')
+        return cp + ('a' - 'A');
+    if(cp >= 0xC0 && cp <= 0xDE && cp != 0xD7)
+        return cp + 0x20;               // Ç Ö Ü and other Latin-1 capitals
+    if(cp == 0x011E || cp == 0x015E)
+        return cp + 1;                  // Ğ -> ğ, Ş -> ş
+    return cp;
+}
+
+/**
+ * Returns 1 if the character belongs to a word.
+ */
+static int isWordChar(uint32_t cp)
+{
+    if(cp >= 0x80)
+        return 1;
+    return isalnum((int)cp);
+}
+
+/**
+ * Splits text into case-folded words and stores the distinct ones.
+ * Words longer than MAX_TOKEN_BYTES are cut at a character boundary.
+ * If `prefix` is not NULL, prefix[i] is set to 1 when token i was written
+ * with a trailing '*' (used by search queries).
+ * Returns the number of tokens stored.
+ */
+int tokenizeText(const char *text, char tokens[][MAX_TOKEN_BYTES], int prefix[], int maxTokens)
+{
+    const unsigned char *p = (const unsigned char *)text;
+    int count = 0;
+
+    while(*p != '\0' && count < maxTokens)
+    {
+        // Skip separators
+        const unsigned char *next = p;
+        uint32_t cp = decodeUtf8(&next);
+        if(!isWordChar(cp))
+        {
+            p = next;
+            continue;
+        }
+
+        // Collect one word
+        char *out = tokens[count];
+        size_t len = 0;
+        while(*p != '\0')
+        {
+            next = p;
+            cp = decodeUtf8(&next);
+            if(!isWordChar(cp))
+                break;
+
+            char buf[4];
+            size_t n = encodeUtf8(foldTurkish(cp), buf);
+            if(len + n < MAX_TOKEN_BYTES)
+            {
+                memcpy(out + len, buf, n);
+                len += n;
+            }
+            p = next;
+        }
+        out[len] = '\0';
+        int isPrefix = (*p == '*');
+
+        // Keep only distinct words
+        int duplicate = -1;
+        for(int i = 0; i < count && duplicate < 0; i++)
+        {
+            if(strcmp(tokens[i], out) == 0)
+                duplicate = i;
+        }
+        if(duplicate < 0)
+        {
+            if(prefix != NULL)
+                prefix[count] = isPrefix;
+            count++;
+        }
+        else if(prefix != NULL && isPrefix)
+        {
+            prefix[duplicate] = 1;
+        }
+    }
+    return count;
+}
+
+/**
+ * Appends an ID to a list. Lists start small since most words occur in only
+ * a handful of books.
+ */
+void idListAppend(IdList *list, int id)
+{
+    if(list->count == list->capacity)
+    {
+        size_t capacity = (list->capacity == 0) ? 2 : list->capacity * 2;
+        int *ids = realloc(list->ids, capacity * sizeof(int));
+        if(ids == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        list->ids      = ids;
+        list->capacity = capacity;
+    }
+    list->ids[list->count++] = id;
+}
+
+/**
+ * Releases the memory held by an ID list.
+ */
+
+void freeIdList(IdList *list)
+{
+    free(list->ids);
+    memset(list, 0, sizeof(*list));
+}
+
+static int compareInts(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sorts a list and removes duplicate IDs.
+ */
+static void idListSortUnique(IdList *list)
+{
+    if(list->count < 2)
+        return;
+    qsort(list->ids, list->count, sizeof(int), compareInts);
+
+    size_t out = 1;
+    for(size_t i = 1; i < list->count; i++)
+    {
+        if(list->ids[i] != list->ids[out - 1])
+            list->ids[out++] = list->ids[i];
+    }
+    list->count = out;
+}
+
+/**
+ * Returns the position of the first ID >= id in a sorted list.
+ */
+static size_t idListLowerBound(const IdList *list, int id)
+{
+    size_t lo = 0, hi = list->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(list->ids[mid] < id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int termRowMatches(size_t row, const void *key)
+{
+    return strcmp(library.textIndex.terms[row].text, (const char *)key) == 0;
+}
+
+/**
+ * Returns the position of a term, or INDEX_NOT_FOUND.
+ */
+static size_t findTerm(const char *token)
+{
+    const TextIndex *ti = &library.textIndex;
+    return indexFind(&ti->lookup, hashString(token), termRowMatches, token);
+}
+
+/**
+ * Returns the position in the sorted term list of the first term >= text.
+ */
+static size_t termLowerBound(const char *text)
+{
+    const TextIndex *ti = &library.textIndex;
+    size_t lo = 0, hi = ti->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(strcmp(ti->terms[ti->sorted[mid]].text, text) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Returns the position of a term, adding it to the dictionary if needed.
+ * With keepSorted == 0 a new term is appended to the sorted list unsorted;
+ * the caller must then sort the list itself (see buildTextIndex).
+ */
+static size_t internTerm(const char *token, int keepSorted)
+{
+    TextIndex *ti = &library.textIndex;
+    size_t pos = findTerm(token);
+    if(pos != INDEX_NOT_FOUND)
+        return pos;
+
+    if(ti->count == ti->capacity)
+    {
+        size_t capacity = ti->capacity;
+        ti->terms  = growTable(ti->terms, &capacity, sizeof(Term));
+        ti->sorted = growTable(ti->sorted, &ti->capacity, sizeof(uint32_t));
+    }
+
+    pos = ti->count;
+    Term *term = &ti->terms[pos];
+    memset(term, 0, sizeof(*term));
+    term->text = malloc(strlen(token) + 1);
+    if(term->text == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(term->text, token);
+
+    // Keep the sorted term list in order for prefix searches
+    size_t at = keepSorted ? termLowerBound(token) : ti->count;
+    memmove(&ti->sorted[at + 1], &ti->sorted[at], (ti->count - at) * sizeof(uint32_t));
+    ti->sorted[at] = (uint32_t)pos;
+
+    ti->count++;
+    indexInsert(&ti->lookup, hashString(token), pos);
+    return pos;
+}
+
+/**
+ * Splits a book's title and author into its distinct index words.
+ */
+static int tokenizeBook(const Book *book, char tokens[][MAX_TOKEN_BYTES])
+{
+    char text[2 * MAX_TEXT_BYTES + 2];
+    snprintf(text, sizeof(text), "%s %s", bookTitle(book), bookAuthor(book));
+    return tokenizeText(text, tokens, NULL, MAX_BOOK_TOKENS);
+}
+
+/**
+ * Adds the words of a book's title and author to the index.
+ */
+void textIndexAddBook(const Book *book)
+{
+    static char tokens[MAX_BOOK_TOKENS][MAX_TOKEN_BYTES];
+    int n = tokenizeBook(book, tokens);
+    for(int i = 0; i < n; i++)
+    {
+        size_t pos = internTerm(tokens[i], 1);
+        IdList *postings = &library.textIndex.terms[pos].postings;
+
+        // Insert in ID order; new books usually have the highest ID
+        size_t at = idListLowerBound(postings, book->ID);
+        if(at < postings->count && postings->ids[at] == book->ID)
+            continue;
+        idListAppend(postings, book->ID);
+        memmove(&postings->ids[at + 1], &postings->ids[at], (postings->count - 1 - at) * sizeof(int));
+        postings->ids[at] = book->ID;
+    }
+}
+
+/**
+ * Removes a book's words from the index.
+ */
+void textIndexRemoveBook(const Book *book)
+{
+    static char tokens[MAX_BOOK_TOKENS][MAX_TOKEN_BYTES];
+    int n = tokenizeBook(book, tokens);
+    for(int i = 0; i < n; i++)
+    {
+        size_t pos = findTerm(tokens[i]);
+        if(pos == INDEX_NOT_FOUND)
+            continue;
+
+        IdList *postings = &library.textIndex.terms[pos].postings;
+        size_t at = idListLowerBound(postings, book->ID);
+        if(at < postings->count && postings->ids[at] == book->ID)
+        {
+            memmove(&postings->ids[at], &postings->ids[at + 1], (postings->count - at - 1) * sizeof(int));
+            postings->count--;
+        }
+    }
+}
+
+static int compareTermPositions(const void *a, const void *b)
+{
+    const Term *terms = library.textIndex.terms;
+    return strcmp(terms[*(const uint32_t *)a].text, terms[*(const uint32_t *)b].text);
+}
+
+/**
+ * Rebuilds the text index from the book table. Posting lists and the
+ * sorted term list are filled in table order and sorted once at the end.
+ */
+void buildTextIndex()
+{
+    static char tokens[MAX_BOOK_TOKENS][MAX_TOKEN_BYTES];
+    TextIndex *ti = &library.textIndex;
+    freeTextIndex();
+
+    for(size_t i = 0; i < library.books.count; i++)
+    {
+        const Book *book = &library.books.items[i];
+        int n = tokenizeBook(book, tokens);
+        for(int t = 0; t < n; t++)
+        {
+            size_t pos = internTerm(tokens[t], 0);
+            idListAppend(&ti->terms[pos].postings, book->ID);
+        }
+    }
+
+    for(size_t i = 0; i < ti->count; i++)
+        idListSortUnique(&ti->terms[i].postings);
+    qsort(ti->sorted, ti->count, sizeof(uint32_t), compareTermPositions);
+}
+
+/**
+ * Releases the memory held by the text index.
+ */
+void freeTextIndex()
+{
+    TextIndex *ti = &library.textIndex;
+    for(size_t i = 0; i < ti->count; i++)
+    {
+        free(ti->terms[i].text);
+        freeIdList(&ti->terms[i].postings);
+    }
+    free(ti->terms);
+    free(ti->sorted);
+    freeIndex(&ti->lookup);
+    memset(ti, 0, sizeof(*ti));
+}
+
+/**
+ * Keeps only the IDs of `result` that also appear in `other` (both sorted).
+ */
+static void intersectIdLists(IdList *result, const IdList *other)
+{
+    size_t i = 0, j = 0, out = 0;
+    while(i < result->count && j < other->count)
+    {
+        if(result->ids[i] < other->ids[j])
+            i++;
+        else if(result->ids[i] > other->ids[j])
+            j++;
+        else
+        {
+            result->ids[out++] = result->ids[i];
+            i++;
+            j++;
+        }
+    }
+    result->count = out;
+}
+
+/**
+ * Finds the books whose title or author contain every word of the query.
+ * A word ending in '*' matches any word starting with it.
+ * The matching book IDs are stored in ascending order in `result`.
+ */
+void searchText(const char *query, IdList *result)
+{
+    uint64_t start = STAT_START();
+    char tokens[MAX_QUERY_TOKENS][MAX_TOKEN_BYTES]; // On the stack: readers search in parallel
+    const TextIndex *ti = &library.textIndex;
+    result->count = 0;
+
+    int prefix[MAX_QUERY_TOKENS];
+    int n = tokenizeText(query, tokens, prefix, MAX_QUERY_TOKENS);
+
+    for(int t = 0; t < n; t++)
+    {
+        IdList matches = {0};
+        if(prefix[t])
+        {
+            // Union of the posting lists of every term with this prefix
+            size_t len = strlen(tokens[t]);
+            for(size_t at = termLowerBound(tokens[t]); at < ti->count; at++)
+            {
+                const Term *term = &ti->terms[ti->sorted[at]];
+                if(strncmp(term->text, tokens[t], len) != 0)
+                    break;
+                for(size_t k = 0; k < term->postings.count; k++)
+                    idListAppend(&matches, term->postings.ids[k]);
+            }
+            idListSortUnique(&matches);
+        }
+        else
+        {
+            size_t pos = findTerm(tokens[t]);
+            if(pos != INDEX_NOT_FOUND)
+            {
+                const IdList *postings = &ti->terms[pos].postings;
+                for(size_t k = 0; k < postings->count; k++)
+                    idListAppend(&matches, postings->ids[k]);
+            }
+        }
+
+        if(t == 0)
+        {
+            freeIdList(result);
+            *result = matches;
+        }
+        else
+        {
+            intersectIdLists(result, &matches);
+            freeIdList(&matches);
+        }
+        if(result->count == 0)
+            break;
+    }
+    STAT_RECORD(STAT_SEARCH, start);
+}
+
+/*
+    -------------------------
+    SORTED VIEWS
+    -------------------------
+*/
+
+/*
+    Texts are ordered by the Turkish alphabet, ignoring case:
+
+        a b c ç d e f g ğ h ı i j k l m n o ö p q r s ş t u ü v w x y z
+
+    (q, w and x where the Latin alphabet has them; accented vowels such as
+    â, î and û count as the plain vowel). Digits, spaces and most ASCII
+    punctuation sort before the letters, any other character after them.
+    A collation key spells a text with one byte per letter so that strcmp
+    on keys gives this order, and the key of a prefix is a prefix of the
+    key of every text starting with it.
+
+    New records are appended to a view unsorted and removed records are
+    only counted. The first reader after a change restores the order: it
+    drops the entries of removed records, sorts the new ones by their
+    freshly computed keys and merges them in, so a burst of inserts or a
+    log replay costs one sort of the new entries, not one O(n) insertion
+    each.
+
+    Restoring the order interns keys, which may move library.collation, so
+    it must not run while another reader walks a view. Views only change
+    under the write lock, so the first reader after a write restores all of
+    them at once, before any reader of that read section holds a view; later
+    readers find nothing left to do and never touch the arena.
+*/
+
+static pthread_mutex_t viewLock = PTHREAD_MUTEX_INITIALIZER; // Readers restoring a view's order
+
+/**
+ * Returns the collation byte of a case-folded letter, or 0 if the
+ * character is not a letter of the alphabet above.
+ */
+static unsigned char letterWeight(uint32_t cp)
+{
+    switch(cp)
+    {
+        case 0x00E7: return letterWeight('c') + 1; // ç
+        case 0x011F: return letterWeight('g') + 1; // ğ
+        case 0x0131: return letterWeight('h') + 1; // ı
+        case 0x00F6: return letterWeight('o') + 1; // ö
+        case 0x015F: return letterWeight('s') + 1; // ş
+        case 0x00FC: return letterWeight('u') + 1; // ü
+    }
+    if(cp >= 0xE0 && cp <= 0xE5)
+        cp = 'a';
+    else if(cp >= 0xE8 && cp <= 0xEB)
+        cp = 'e';
+    else if(cp >= 0xEC && cp <= 0xEF)
+        cp = 'i';
+    else if(cp >= 0xF2 && cp <= 0xF5)
+        cp = 'o';
+    else if(cp >= 0xF9 && cp <= 0xFB)
+        cp = 'u';
+    if(cp < 'a' || cp > 'z')
+        return 0;
+
+    // 'A' upwards, each Turkish letter right after its Latin base letter
+    return (unsigned char)('A' + (cp - 'a') + (cp > 'c') + (cp > 'g') + (cp > 'h') +
+                           (cp > 'o') + (cp > 's') + (cp > 'u'));
+}
+
+/**
+ * Writes the collation key of a text, cut at `size` - 1 bytes. A key is
+ * never longer than its text. Returns the key length.
+ */
+size_t collationKey(const char *text, char *out, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)text;
+    size_t len = 0;
+
+    while(*p != '\0')
+    {
+        uint32_t cp = foldTurkish(decodeUtf8(&p));
+        unsigned char weight = letterWeight(cp);
+        char buf[4];
+        size_t n = 1;
+        if(weight != 0)
+            buf[0] = (char)weight;
+        else if(cp < 'A')
+            buf[0] = (char)cp;  // Space, digits, punctuation
+        else if(cp < 0x80)
+            buf[0] = '@';       // The punctuation between the letters
+        else
+            n = encodeUtf8(cp, buf);
+
+        if(len + n >= size)
+            break;
+        memcpy(out + len, buf, n);
+        len += n;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * Adds a record's text to a view. It takes its place in the order when
+ * the view is next read.
+ */
+void viewAdd(SortedViewId id, uint32_t text, uint64_t recordID)
+{
+    SortedView *view = &library.views[id];
+    if(view->count == view->capacity)
+        view->entries = growTable(view->entries, &view->capacity, sizeof(ViewEntry));
+    view->entries[view->count].key  = 0;
+    view->entries[view->count].text = text;
+    view->entries[view->count].ID   = recordID;
+    view->count++;
+}
+
+/**
+ * Notes that a record of a view was removed. Its entry is dropped when
+ * the view is next read.
+ */
+void viewRemove(SortedViewId id)
+{
+    library.views[id].stale++;
+}
+
+/**
+ * Returns 1 if an entry still belongs to a record with that text.
+ */
+static int viewEntryCurrent(SortedViewId id, const ViewEntry *entry)
+{
+    if(id == VIEW_NAMES)
+    {
+        const Member *member = findMember(entry->ID);
+        return member != NULL && member->name == entry->text;
+    }
+    const Book *book = findBook((int)entry->ID);
+    return book != NULL && (id == VIEW_TITLES ? book->title : book->author) == entry->text;
+}
+
+/**
+ * Drops the entries of removed records, keeping both parts of the view in
+ * their order.
+ */
+static void dropStaleEntries(SortedViewId id)
+{
+    SortedView *view = &library.views[id];
+    size_t out = 0, sorted = 0;
+    for(size_t i = 0; i < view->count; i++)
+    {
+        if(viewEntryCurrent(id, &view->entries[i]))
+            view->entries[out++] = view->entries[i];
+        if(i + 1 == view->sorted)
+            sorted = out;
+    }
+    view->sorted = sorted;
+    view->count  = out;
+    view->stale  = 0;
+}
+
+static int compareViewEntries(const void *a, const void *b)
+{
+    const ViewEntry *x = a, *y = b;
+    int order = strcmp(library.collation.bytes + x->key, library.collation.bytes + y->key);
+    if(order != 0)
+        return order;
+    return (x->ID > y->ID) - (x->ID < y->ID);
+}
+
+/**
+ * Puts a view back in order: drops removed records, sorts the entries
+ * added since the last merge and merges them into the sorted part.
+ */
+static void mergeView(SortedViewId id)
+{
+    SortedView *view = &library.views[id];
+    const StringArena *texts = (id == VIEW_NAMES) ? &library.memberText : &library.bookText;
+    if(view->stale > 0)
+        dropStaleEntries(id); // One record lookup per entry: only after removals
+
+    size_t added = view->count - view->sorted;
+    ViewEntry *tail = view->entries + view->sorted;
+    for(size_t i = 0; i < added; i++)
+    {
+        char key[MAX_TEXT_BYTES + 1];
+        size_t length = collationKey(texts->bytes + tail[i].text, key, sizeof(key));
+        tail[i].key = internText(&library.collation, key, length);
+    }
+    qsort(tail, added, sizeof(ViewEntry), compareViewEntries);
+
+    // Merge from the back, so only the new entries need a copy
+    if(added > 0 && view->sorted > 0)
+    {
+        ViewEntry *copy = malloc(added * sizeof(ViewEntry));
+        if(copy == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(copy, tail, added * sizeof(ViewEntry));
+        size_t i = view->sorted, j = added, out = view->count;
+        while(j > 0)
+        {
+            if(i > 0 && compareViewEntries(&view->entries[i - 1], &copy[j - 1]) > 0)
+                view->entries[--out] = view->entries[--i];
+            else
+                view->entries[--out] = copy[--j];
+        }
+        free(copy);
+    }
+
+    // A record deleted and added again with the same text is listed once
+    size_t out = 0;
+    for(size_t i = 0; i < view->count; i++)
+    {
+        if(out == 0 || view->entries[out - 1].key != view->entries[i].key ||
+           view->entries[out - 1].ID != view->entries[i].ID)
+            view->entries[out++] = view->entries[i];
+    }
+    view->count = view->sorted = out;
+}
+
+/**
+ * Returns a view in order. Readers may call it in parallel: the first one
+ * after a change restores the order of every view (not just this one, see
+ * above), the others wait for it.
+ */
+const SortedView *sortedView(SortedViewId id)
+{
+    pthread_mutex_lock(&viewLock);
+    for(int i = 0; i < SORTED_VIEWS; i++)
+    {
+        const SortedView *view = &library.views[i];
+        if(view->sorted != view->count || view->stale > 0)
+            mergeView((SortedViewId)i);
+    }
+    pthread_mutex_unlock(&viewLock);
+    return &library.views[id];
+}
+
+/**
+ * Returns the position of the first entry of an ordered view whose key is
+ * not less than `key` (the entry count if there is none).
+ */
+size_t viewLowerBound(const SortedView *view, const char *key)
+{
+    size_t lo = 0, hi = view->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(strcmp(library.collation.bytes + view->entries[mid].key, key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * Drops the entries of removed records from every view (see packStrings).
+ */
+void pruneSortedViews()
+{
+    for(int i = 0; i < SORTED_VIEWS; i++)
+        dropStaleEntries((SortedViewId)i);
+}
+
+/**
+ * Points the entries of every view at the repacked texts of their records
+ * and repacks the collation keys. Views must be pruned beforehand.
+ */
+void repackSortedViews()
+{
+    StringArena keys = {0};
+    for(int i = 0; i < SORTED_VIEWS; i++)
+    {
+        SortedView *view = &library.views[i];
+        for(size_t k = 0; k < view->count; k++)
+        {
+            ViewEntry *entry = &view->entries[k];
+            if(i == VIEW_NAMES)
+                entry->text = findMember(entry->ID)->name;
+            else
+            {
+                const Book *book = findBook((int)entry->ID);
+                entry->text = (i == VIEW_TITLES) ? book->title : book->author;
+            }
+            if(k < view->sorted)
+                entry->key = repackText(&keys, &library.collation, entry->key);
+        }
+    }
+    freeArena(&library.collation);
+    library.collation = keys;
+}
+
+/**
+ * Rebuilds the views from the book and member tables. They are sorted when
+ * first read.
+ */
+void buildSortedViews()
+{
+    freeSortedViews();
+    for(size_t i = 0; i < library.books.count; i++)
+    {
+        const Book *book = &library.books.items[i];
+        viewAdd(VIEW_TITLES, book->title, (uint64_t)book->ID);
+        viewAdd(VIEW_AUTHORS, book->author, (uint64_t)book->ID);
+    }
+    for(size_t i = 0; i < library.members.count; i++)
+        viewAdd(VIEW_NAMES, library.members.items[i].name, library.members.items[i].ID);
+}
+
+/**
+ * Releases the memory held by the sorted views.
+ */
+void freeSortedViews()
+{
+    for(int i = 0; i < SORTED_VIEWS; i++)
+        free(library.views[i].entries);
+    memset(library.views, 0, sizeof(library.views));
+    freeArena(&library.collation);
+}
+
+/*
+    -------------------------
+    LISTINGS
+    -------------------------
+*/
+
+/*
+    A ListCursor walks one table and yields the rows that pass its
+    filters, one at a time, so a caller that stops after a page has only
+    paid for that page. The filters pick the cheapest path:
+
+        sort= or prefix=   the sorted view (see SORTED VIEWS), starting
+                           at the first text with the prefix
+        books    status=   the availability bitset, 64 rows per word
+        borrows  member=   the member's loan chain
+        borrows  status=open without member=
+                           the date-ordered open loan index, starting at
+                           from= and stopping after to=
+        otherwise          a scan of the table from the cursor position
+
+    Positions stay valid while the store only grows. A delete or a return
+    between two pages moves a row (see removeBook and openLoanRemove), and
+    an insert shifts the sorted view after it, so a later page may then
+    skip or repeat a record.
+*/
+
+/**
+ * Starts a listing of every record of a table.
+ */
+void listInit(ListCursor *cursor, ListKind kind)
+{
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->kind     = kind;
+    cursor->status   = -1;
+    cursor->memberID = MEMBER_NONE;
+    cursor->fromDay  = INT32_MIN;
+    cursor->toDay    = INT32_MAX;
+    cursor->view     = -1;
+}
+
+/**
+ * Parses "books", "members" or "borrows". Returns 0 on success.
+ */
+int parseListKind(const char *text, ListKind *kind)
+{
+    static const char *const names[] = { "books", "members", "borrows" };
+    for(int i = 0; i < 3; i++)
+    {
+        if(strcmp(text, names[i]) == 0)
+        {
+            *kind = (ListKind)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Parses a size_t argument. Returns 0 on success, -1 otherwise.
+ */
+static int parseSizeArg(const char *text, size_t *value)
+{
+    char *end;
+    if(!isdigit((unsigned char)*text))
+        return -1;
+    errno = 0;
+    unsigned long long parsed = strtoull(text, &end, 10);
+    if(errno != 0 || *end != '\0')
+        return -1;
+    *value = (size_t)parsed;
+    return 0;
+}
+
+/**
+ * Applies one "key=value" filter to a cursor:
+ *
+ *     status=available|borrowed   (books)
+ *     status=open|returned        (borrows)
+ *     author=<exact author>       (books)
+ *     sort=title|author           (books, alphabetically; see SORTED VIEWS)
+ *     sort=name                   (members, alphabetically)
+ *     prefix=<text>               (books, members: the sorted text starts
+ *                                  with it; by title or name without sort=)
+ *     member=<TC ID>              (borrows)
+ *     from=<dd/mm/yyyy>           (borrows, by borrow date)
+ *     to=<dd/mm/yyyy>             (borrows, by borrow date)
+ *     limit=<records per page>
+ *     cursor=<position returned with the previous page>
+ *
+ * Returns 0 on success, -1 for an unknown key or a bad value.
+ */
+int listFilter(ListCursor *cursor, const char *arg)
+{
+    const char *value = strchr(arg, '=');
+    if(value == NULL)
+        return -1;
+    size_t keyLength = (size_t)(value - arg);
+    value++;
+
+#define IS_KEY(name) (keyLength == strlen(name) && strncmp(arg, name, keyLength) == 0)
+    int books = (cursor->kind == LIST_BOOKS), borrows = (cursor->kind == LIST_BORROWS);
+
+    if(IS_KEY("status") && books)
+    {
+        if(strcmp(value, "available") == 0 || strcmp(value, "borrowed") == 0)
+        {
+            cursor->status = (value[0] == 'a');
+            return 0;
+        }
+    }
+    else if(IS_KEY("status") && borrows)
+    {
+        if(strcmp(value, "open") == 0 || strcmp(value, "returned") == 0)
+        {
+            cursor->status = (value[0] == 'o');
+            return 0;
+        }
+    }
+    else if(IS_KEY("author") && books && *value != '\0')
+    {
+        // An author no book has matches nothing
+        cursor->author = findText(&library.bookText, value);
+        if(cursor->author == 0)
+            cursor->done = 1;
+        return 0;
+    }
+    else if(IS_KEY("sort") && books)
+    {
+        if(strcmp(value, "title") == 0 || strcmp(value, "author") == 0)
+        {
+            cursor->view = (value[0] == 't') ? VIEW_TITLES : VIEW_AUTHORS;
+            return 0;
+        }
+    }
+    else if(IS_KEY("sort") && !borrows)
+    {
+        if(strcmp(value, "name") == 0)
+        {
+            cursor->view = VIEW_NAMES;
+            return 0;
+        }
+    }
+    else if(IS_KEY("prefix") && !borrows)
+    {
+        // The key must fit whole, or it would match more than the prefix
+        return (strlen(value) < sizeof(cursor->prefix) &&
+                collationKey(value, cursor->prefix, sizeof(cursor->prefix)) > 0) ? 0 : -1;
+    }
+    else if(IS_KEY("member") && borrows)
+    {
+        cursor->memberID = memberKey(value);
+        return (cursor->memberID == MEMBER_NONE) ? -1 : 0;
+    }
+    else if(IS_KEY("from") && borrows)
+        return parseDate(value, &cursor->fromDay);
+    else if(IS_KEY("to") && borrows)
+        return parseDate(value, &cursor->toDay);
+    else if(IS_KEY("limit"))
+        return (parseSizeArg(value, &cursor->limit) == 0 && cursor->limit > 0) ? 0 : -1;
+    else if(IS_KEY("cursor"))
+        return parseSizeArg(value, &cursor->position);
+#undef IS_KEY
+    return -1;
+}
+
+/**
+ * Returns 1 if a borrow record passes the status and date filters.
+ */
+static int borrowListed(const ListCursor *cursor, const Borrow *borrow)
+{
+    if(cursor->status >= 0 && (borrow->returnDay == DATE_OPEN) != cursor->status)
+        return 0;
+    return borrow->borrowDay >= cursor->fromDay && borrow->borrowDay <= cursor->toDay;
+}
+
+/**
+ * Returns the sorted view a listing walks, or -1 if it walks its table.
+ */
+static int listView(const ListCursor *cursor)
+{
+    if(cursor->kind == LIST_BORROWS)
+        return -1;
+    if(cursor->view >= 0 || cursor->prefix[0] == '\0')
+        return cursor->view;
+    return (cursor->kind == LIST_MEMBERS) ? VIEW_NAMES : VIEW_TITLES;
+}
+
+static size_t nextListedBook(ListCursor *cursor)
+{
+    const BookTable *books = &library.books;
+    size_t row = cursor->position;
+    while(row < books->count)
+    {
+        if(cursor->status >= 0)
+        {
+            row = nextBookRow(row, cursor->status);
+            if(row >= books->count)
+                break;
+        }
+        if(cursor->author == 0 || books->items[row].author == cursor->author)
+            return row;
+        row++;
+    }
+    return INDEX_NOT_FOUND;
+}
+
+static size_t nextInView(ListCursor *cursor, SortedViewId id)
+{
+    const SortedView *view = sortedView(id);
+    size_t prefixLength = strlen(cursor->prefix);
+    size_t pos = cursor->position;
+    if(prefixLength > 0)
+    {
+        size_t first = viewLowerBound(view, cursor->prefix);
+        if(pos < first)
+            pos = first;
+    }
+
+    for(; pos < view->count; pos++)
+    {
+        const ViewEntry *entry = &view->entries[pos];
+        if(strncmp(library.collation.bytes + entry->key, cursor->prefix, prefixLength) != 0)
+            break; // Past the last text with the prefix
+
+        cursor->position = pos; // listNext moves it past this entry
+        if(id == VIEW_NAMES)
+            return (size_t)(findMember(entry->ID) - library.members.items);
+        const Book *book = findBook((int)entry->ID);
+        if((cursor->status < 0 || book->status == cursor->status) &&
+           (cursor->author == 0 || book->author == cursor->author))
+            return (size_t)(book - library.books.items);
+    }
+    return INDEX_NOT_FOUND;
+}
+
+static size_t nextMemberLoan(ListCursor *cursor)
+{
+    const BorrowTable *borrows = &library.borrows;
+    const size_t *next = library.memberLoans.next;
+    size_t row;
+
+    // The chain is in row order: continue from the previous record of
+    // the member if the position still follows one, else walk up to it
+    if(cursor->position > 0 && cursor->position <= borrows->count &&
+       borrows->items[cursor->position - 1].memberID == cursor->memberID)
+        row = next[cursor->position - 1];
+    else
+    {
+        const MemberLoanList *loans = findMemberLoans(cursor->memberID);
+        row = (loans != NULL) ? loans->first : INDEX_EMPTY;
+        while(row != INDEX_EMPTY && row < cursor->position)
+            row = next[row];
+    }
+
+    for(; row != INDEX_EMPTY; row = next[row])
+    {
+        if(borrowListed(cursor, &borrows->items[row]))
+            return row;
+    }
+    return INDEX_NOT_FOUND;
+}
+
+static size_t nextOpenLoan(ListCursor *cursor)
+{
+    const OpenLoans *open = &library.openLoans;
+    size_t pos = openLoanDateBound(cursor->fromDay);
+    if(pos < cursor->position)
+        pos = cursor->position;
+    if(pos >= open->count || open->byDate[pos].borrowDay > cursor->toDay)
+        return INDEX_NOT_FOUND;
+
+    cursor->position = pos; // listNext moves it past this entry
+    return (size_t)(findOpenBorrow(open->byDate[pos].bookID) - library.borrows.items);
+}
+
+/**
+ * Returns the row of the next record that passes the cursor's filters and
+ * moves the cursor past it, or INDEX_NOT_FOUND at the end of the listing.
+ * The caller holds a read section.
+ */
+size_t listNext(ListCursor *cursor)
+{
+    if(cursor->done)
+        return INDEX_NOT_FOUND;
+
+    size_t row = INDEX_NOT_FOUND;
+    int view = listView(cursor);
+    if(view >= 0)
+        row = nextInView(cursor, (SortedViewId)view);
+    else if(cursor->kind == LIST_BOOKS)
+        row = nextListedBook(cursor);
+    else if(cursor->kind == LIST_MEMBERS)
+        row = (cursor->position < library.members.count) ? cursor->position : INDEX_NOT_FOUND;
+    else if(cursor->memberID != MEMBER_NONE)
+        row = nextMemberLoan(cursor);
+    else if(cursor->status == 1)
+        row = nextOpenLoan(cursor);
+    else
+    {
+        const BorrowTable *borrows = &library.borrows;
+        for(size_t i = cursor->position; i < borrows->count; i++)
+        {
+            if(borrowListed(cursor, &borrows->items[i]))
+            {
+                row = i;
+                break;
+            }
+        }
+    }
+
+    if(row == INDEX_NOT_FOUND)
+    {
+        cursor->done = 1;
+        return INDEX_NOT_FOUND;
+    }
+    // Sorted listings and open loans are positioned in their index,
+    // everything else by row
+    if(view >= 0 || (cursor->kind == LIST_BORROWS && cursor->memberID == MEMBER_NONE && cursor->status == 1))
+        cursor->position++;
+    else
+        cursor->position = row + 1;
+    return row;
+}
+
+/**
+ * Writes a listed record as a line of its data file, without the newline.
+ */
+void writeListed(FILE *out, const ListCursor *cursor, size_t row)
+{
+    if(cursor->kind == LIST_BOOKS)
+        writeBook(out, &library.books.items[row]);
+    else if(cursor->kind == LIST_MEMBERS)
+        writeMember(out, &library.members.items[row]);
+    else
+        writeBorrow(out, &library.borrows.items[row]);
+}
+
+/**
+ * Starts paging an interactive listing. Output that does not go to a
+ * terminal, or input that does not come from one, is never paused.
+ */
+void pagerInit(Pager *pager)
+{
+    pager->shown      = 0;
+    pager->screenRows = (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) ? LIST_SCREEN_ROWS : 0;
+    pager->stopped    = 0;
+}
+
+/**
+ * Called before printing each line of a listing. After every screenful it
+ * waits for Enter. Returns 0 to print the line, -1 if the user stopped.
+ */
+int pagerLine(Pager *pager)
+{
+    if(pager->stopped)
+        return -1;
+    if(pager->screenRows > 0 && pager->shown > 0 && pager->shown % pager->screenRows == 0)
+    {
+        char answer[8];
+        printf("-- %zu shown; Enter for more, q to stop: ", pager->shown);
+        fflush(stdout);
+        readLine(answer, sizeof(answer));
+        if(answer[0] == 'q' || answer[0] == 'Q' || feof(stdin))
+        {
+            pager->stopped = 1;
+            return -1;
+        }
+    }
+    pager->shown++;
+    return 0;
+}
+
+/**
+ * Writes the records of one table that pass the given filters to a file
+ * (or stdout for "-"), in the format of its data file. Archived loans are
+ * not included; they are listed by the "loans" and "history" queries.
+ *
+ *     --export <books|members|borrows> [file] [key=value...]
+ *
+ * Returns the process exit code.
+ */
+int exportRecords(int argc, char *argv[])
+{
+    ListKind kind;
+    if(argc < 1 || parseListKind(argv[0], &kind) != 0)
+    {
+        fprintf(stderr, "Export books, members or borrows!\n");
+        return 1;
+    }
+
+    const char *path = "-";
+    int first = 1;
+    if(argc > 1 && strchr(argv[1], '=') == NULL)
+    {
+        path = argv[1];
+        first = 2;
+    }
+
+    FILE *out = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+    if(out == NULL)
+    {
+        fprintf(stderr, "Cannot open %s!\n", path);
+        return 1;
+    }
+    static char outBuffer[BATCH_OUTPUT_BUFFER];
+    setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+
+    loadLibrary();
+
+    ListCursor cursor;
+    listInit(&cursor, kind);
+    for(int i = first; i < argc; i++)
+    {
+        if(listFilter(&cursor, argv[i]) != 0)
+        {
+            fprintf(stderr, "Invalid filter: %s\n", argv[i]);
+            if(out != stdout)
+                fclose(out);
+            freeLibrary();
+            return 1;
+        }
+    }
+
+    // limit= caps the export, cursor= resumes it
+    double start = nowSeconds();
+    size_t count = 0;
+    beginRead();
+    for(size_t row = listNext(&cursor); row != INDEX_NOT_FOUND; row = listNext(&cursor))
+    {
+        writeListed(out, &cursor, row);
+        fputc('\n', out);
+        if(++count == cursor.limit)
+            break;
+    }
+    endRead();
+
+    int failed = (fflush(out) != 0 || ferror(out));
+    if(out != stdout)
+        failed |= (fclose(out) != 0);
+    double elapsed = nowSeconds() - start;
+    if(failed)
+        fprintf(stderr, "Error writing %s!\n", path);
+    else
+        fprintf(stderr, "%zu records exported in %.3f s, %.0f records/sec\n",
+                count, elapsed, count / (elapsed > 0 ? elapsed : 1e-9));
+
+    freeLibrary();
+    return failed ? 1 : 0;
+}
+
+/*
+    -------------------------
+    BOOK OPERATIONS
+    -------------------------
+*/
+
+/**
+ * Builds a book from the fields of one books.txt line.
+ */
+static const char *parseBookFields(const TextField f[], void *table)
+{
+    Book book;
+    if(parseIntField(&f[0], &book.ID) != 0)
+        return "invalid book ID";
+    if(internField(&library.bookText, &f[1], &book.title) != 0)
+        return "title is empty or too long";
+    if(internField(&library.bookText, &f[2], &book.author) != 0)
+        return "author is empty or too long";
+    if(parseIntField(&f[3], &book.status) != 0 || (book.status != 0 && book.status != 1))
+        return "status must be 0 or 1";
+
+    *appendBook(table) = book;
+    return NULL;
+}
+
+/**
+ * Reads books from the file into the book table.
+ * Returns the number of books read.
+ */
+size_t loadBooks(BookTable *table)
+{
+    /*
+        File line format:
+        ID|title|author|status
+    */
+    return parseDataFile(BOOKS_FILE, 4, parseBookFields, table);
+}
+
+/**
+ * Writes the book data from the table to the temporary books file, to be
+ * moved into place by saveLibraryFiles. Returns 0 on success.
+ */
+int saveBooks(const BookTable *table)
+{
+    uint64_t start = STAT_START();
+    FILE *fp = fopen(BOOKS_FILE TEMP_SUFFIX, "w");
+    if (fp == NULL)
+    {
+        printf("Failed to open file for saving books!\n");
+        return -1;
+    }
+
+    for(size_t i = 0; i < table->count; i++)
+    {
+        writeBook(fp, &table->items[i]);
+        fputc('\n', fp);
+    }
+
+    STAT_RECORD(STAT_WRITE, start);
+    return closeDurable(fp, BOOKS_FILE TEMP_SUFFIX);
+}
+
+/**
+ * Writes a book as a books.txt line, without the newline.
+ */
+void writeBook(FILE *out, const Book *book)
+{
+    fprintf(out, "%d|%s|%s|%d", book->ID, bookTitle(book), bookAuthor(book), book->status);
+}
+
+/**
+ * Adds a new book to the system.
+ */
+void addBook()
+{
+    int id;
+    char title[MAX_TEXT_BYTES + 2], author[MAX_TEXT_BYTES + 2];
+    printf("New Book ID: ");
+    scanf("%d", &id);
+    clearInputBuffer();
+
+    // Check for duplicate ID
+    if(findBook(id) != NULL)
+    {
+        printf("A book with this ID already exists!\n");
+        return;
     }
 
     printf("Book Title: ");
-    fgets(newBook.title, sizeof(newBook.title), stdin);
-    // Remove the trailing \n character
-    newBook.title[strcspn(newBook.title, "\n")] = '\0';
+    readLine(title, sizeof(title));
+
+    printf("Author Name: ");
+    readLine(author, sizeof(author));
+
+    LibStatus status = libAddBook(id, title, author);
+    if(status != LIB_OK)
+    {
+        printf("%s\n", statusMessage(status));
+        return;
+    }
+
+    printf("Book added successfully!\n");
+}
+
+/**
+ * Deletes a book from the system based on its ID.
+ */
+void deleteBook()
+{
+    int id;
+    printf("Enter the ID of the book to delete: ");
+    scanf("%d", &id);
+
+    LibStatus status = libDeleteBook(id);
+    if(status == LIB_OK)
+    {
+        printf("Book deleted.\n");
+    }
+    else if(status == LIB_ERR_BORROWED)
+    {
+        printf("This book is on loan; it can be deleted once it is returned!\n");
+    }
+    else
+    {
+        printf("No book found with this ID!\n");
+    }
+}
+
+/**
+ * Searches for a book by its ID and prints the details if found.
+ */
+void searchBook()
+{
+    int id;
+    printf("Enter the ID of the book to search: ");
+    scanf("%d", &id);
+
+    const Book *book = findBook(id);
+    if(book == NULL)
+    {
+        printf("No book found with this ID!\n");
+        return;
+    }
+
+    printf("\nBook Found:\n");
+    printf("ID     : %d\n", book->ID);
+    printf("Title  : %s\n", bookTitle(book));
+    printf("Author : %s\n", bookAuthor(book));
+    printf("Status : %s\n", (book->status == 1) ? "Available" : "Borrowed");
+}
+
+/**
+ * Searches books by words of their title or author and prints the matches.
+ */
+void searchBookByText()
+{
+    char query[256];
+    printf("Enter words from the title or author (end a word with * for prefix search): ");
+    readLine(query, sizeof(query));
+
+    IdList ids = {0};
+    searchText(query, &ids);
+
+    if(ids.count == 0)
+    {
+        printf("No matching books found!\n");
+        freeIdList(&ids);
+        return;
+    }
+
+    printf("\n--- Matching Books (%zu) ---\n", ids.count);
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t i = 0; i < ids.count; i++)
+    {
+        const Book *book = findBook(ids.ids[i]);
+        if(book == NULL)
+            continue;
+        if(pagerLine(&pager) != 0)
+            break;
+        printf("[%d] %s - %s (%s)\n",
+               book->ID,
+               bookTitle(book),
+               bookAuthor(book),
+               book->status == 1 ? "Mevcut" : "Ödünçte");
+    }
+    freeIdList(&ids);
+}
+
+/**
+ * Prints the books of a listing a screenful at a time. The status is only
+ * shown when the listing does not filter by it.
+ */
+static void printBookList(ListCursor *cursor)
+{
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t row = listNext(cursor); row != INDEX_NOT_FOUND; row = listNext(cursor))
+    {
+        if(pagerLine(&pager) != 0)
+            break;
+        const Book *book = &library.books.items[row];
+        if(cursor->status >= 0)
+            printf("[%d] %s - %s\n", book->ID, bookTitle(book), bookAuthor(book));
+        else
+            printf("[%d] %s - %s (%s)\n",
+                   book->ID,
+                   bookTitle(book),
+                   bookAuthor(book),
+                   book->status == 1 ? "Mevcut" : "Ödünçte");
+    }
+}
+
+/**
+ * Lists all books, whether available or borrowed, or only the books of
+ * one author.
+ */
+void listBooks()
+{
+    if(library.books.count == 0)
+    {
+        printf("No books registered.\n");
+        return;
+    }
+
+    char author[256];
+    printf("Author (leave empty for all books): ");
+    readLine(author, sizeof(author));
+
+    ListCursor cursor;
+    listInit(&cursor, LIST_BOOKS);
+    if(author[0] != '\0')
+    {
+        cursor.author = findText(&library.bookText, author);
+        if(cursor.author == 0)
+        {
+            printf("No books by this author!\n");
+            return;
+        }
+        printf("\n--- Books by %s ---\n", author);
+    }
+    else
+        printf("\n--- All Books ---\n");
+    printBookList(&cursor);
+}
+
+/**
+ * Lists the books in alphabetical order of their title or author, all of
+ * them or those starting with the given letters.
+ */
+void listSortedBooks()
+{
+    char choice[8], prefix[MAX_TOKEN_BYTES];
+    printf("Sort by (1: title, 2: author): ");
+    readLine(choice, sizeof(choice));
+    if(strcmp(choice, "1") != 0 && strcmp(choice, "2") != 0)
+    {
+        printf("Invalid choice!\n");
+        return;
+    }
+    printf("Starting with (leave empty for all): ");
+    readLine(prefix, sizeof(prefix));
+
+    ListCursor cursor;
+    listInit(&cursor, LIST_BOOKS);
+    cursor.view = (choice[0] == '1') ? VIEW_TITLES : VIEW_AUTHORS;
+    collationKey(prefix, cursor.prefix, sizeof(cursor.prefix));
+
+    ListCursor first = cursor;
+    if(listNext(&first) == INDEX_NOT_FOUND)
+    {
+        printf("No matching books found!\n");
+        return;
+    }
+    printf("\n--- Books by %s%s%s ---\n", cursor.view == VIEW_TITLES ? "Title" : "Author",
+           prefix[0] != '\0' ? ", starting with " : "", prefix);
+    printBookList(&cursor);
+}
+
+/**
+ * Lists only the books that are currently available (status == 1).
+ * The availability bitset gives the count and the rows to print.
+ */
+void listAvailableBooks()
+{
+    const BookTable *books = &library.books;
+    size_t count = countAvailable();
+
+    if(count == 0)
+    {
+        printf("No books are currently available.\n");
+        return;
+    }
+
+    printf("\n--- Mevcut Kitaplar (%zu / %zu) ---\n", count, books->count);
+    ListCursor cursor;
+    listInit(&cursor, LIST_BOOKS);
+    cursor.status = 1;
+    printBookList(&cursor);
+}
+
+/**
+ * Lists only the books that are currently borrowed (status == 0).
+ */
+void listBorrowedBooks()
+{
+    const BookTable *books = &library.books;
+    size_t count = books->count - countAvailable();
+
+    if(count == 0)
+    {
+        printf("No books are currently borrowed.\n");
+        return;
+    }
+
+    printf("\n--- Ödünçteki Kitaplar (%zu / %zu) ---\n", count, books->count);
+    ListCursor cursor;
+    listInit(&cursor, LIST_BOOKS);
+    cursor.status = 0;
+    printBookList(&cursor);
+}
+
+/*
+    -------------------------
+    MEMBER OPERATIONS
+    -------------------------
+*/
+
+/**
+ * Builds a member from the fields of one members.txt line.
+ */
+static const char *parseMemberFields(const TextField f[], void *table)
+{
+    Member member;
+    if(parseMemberField(&f[0], &member.ID) != 0)
+        return "member ID must be 11 digits";
+    if(internField(&library.memberText, &f[1], &member.name) != 0)
+        return "name is empty or too long";
+    if(internField(&library.memberText, &f[2], &member.phone) != 0)
+        return "phone is empty or too long";
+
+    *appendMember(table) = member;
+    return NULL;
+}
+
+/**
+ * Reads members from the file into the member table.
+ * Returns the number of members read.
+ */
+size_t loadMembers(MemberTable *table)
+{
+    /*
+        File line format:
+        ID|name|phone
+    */
+    return parseDataFile(MEMBERS_FILE, 3, parseMemberFields, table);
+}
+
+/**
+ * Writes the member data from the table to the temporary members file.
+ * Returns 0 on success.
+ */
+int saveMembers(const MemberTable *table)
+{
+    uint64_t start = STAT_START();
+    FILE *fp = fopen(MEMBERS_FILE TEMP_SUFFIX, "w");
+    if (fp == NULL)
+    {
+        printf("Failed to open file for saving members!\n");
+        return -1;
+    }
+
+    for(size_t i = 0; i < table->count; i++)
+    {
+        writeMember(fp, &table->items[i]);
+        fputc('\n', fp);
+    }
+
+    STAT_RECORD(STAT_WRITE, start);
+    return closeDurable(fp, MEMBERS_FILE TEMP_SUFFIX);
+}
+
+/**
+ * Writes a member as a members.txt line, without the newline.
+ */
+void writeMember(FILE *out, const Member *member)
+{
+    fprintf(out, "%011llu|%s|%s", (unsigned long long)member->ID, memberName(member), memberPhone(member));
+}
+
+/**
+ * Adds a new member to the system.
+ */
+void addMember()
+{
+    char id[12], name[MAX_TEXT_BYTES + 2], phone[MAX_TEXT_BYTES + 2];
+    printf("Enter Member TC ID Number (11 digits): ");
+    readLine(id, sizeof(id));
+
+    // Validate ID
+    if(!isValidMemberID(id))
+    {
+        printf("Invalid ID number!\n");
+        return;
+    }
+
+    // Check for duplicate ID
+    if(findMember(memberKey(id)) != NULL)
+    {
+        printf("A member with this ID already exists!\n");
+        return;
+    }
+
+    printf("Member Name: ");
+    readLine(name, sizeof(name));
+
+    printf("Member Phone Number: ");
+    readLine(phone, sizeof(phone));
+
+    LibStatus status = libAddMember(id, name, phone);
+    if(status != LIB_OK)
+    {
+        printf("%s\n", statusMessage(status));
+        return;
+    }
+
+    printf("Member added successfully!\n");
+}
+
+/**
+ * Searches for a member by their 11-digit ID and prints the details if found.
+ */
+void searchMember()
+{
+    char id[12];
+    printf("Enter the TC ID Number (11 digits) of the member to search: ");
+    readLine(id, sizeof(id));
+
+    const Member *member = findMember(memberKey(id));
+    if(member == NULL)
+    {
+        printf("No member found with this ID!\n");
+        return;
+    }
+
+    printf("\nMember Found:\n");
+    printf("TC ID No : %011llu\n", (unsigned long long)member->ID);
+    printf("Name     : %s\n", memberName(member));
+    printf("Phone    : %s\n", memberPhone(member));
+}
+
+/**
+ * Lists all registered members.
+ */
+void listMembers()
+{
+    const MemberTable *members = &library.members;
+
+    if(members->count == 0)
+    {
+        printf("No members registered.\n");
+        return;
+    }
+
+    printf("\n--- All Members ---\n");
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t i = 0; i < members->count && pagerLine(&pager) == 0; i++)
+    {
+        const Member *member = &members->items[i];
+        printf("[%011llu] %s - %s\n",
+               (unsigned long long)member->ID,
+               memberName(member),
+               memberPhone(member));
+    }
+}
+
+/**
+ * Lists the members in alphabetical order of their names, all of them or
+ * those starting with the given letters.
+ */
+void listSortedMembers()
+{
+    char prefix[MAX_TOKEN_BYTES];
+    printf("Starting with (leave empty for all): ");
+    readLine(prefix, sizeof(prefix));
+
+    ListCursor cursor;
+    listInit(&cursor, LIST_MEMBERS);
+    cursor.view = VIEW_NAMES;
+    collationKey(prefix, cursor.prefix, sizeof(cursor.prefix));
+
+    Pager pager;
+    pagerInit(&pager);
+    size_t shown = 0;
+    for(size_t row = listNext(&cursor); row != INDEX_NOT_FOUND && pagerLine(&pager) == 0; row = listNext(&cursor))
+    {
+        const Member *member = &library.members.items[row];
+        if(shown++ == 0)
+            printf("\n--- Members by Name%s%s ---\n", prefix[0] != '\0' ? ", starting with " : "", prefix);
+        printf("[%011llu] %s - %s\n", (unsigned long long)member->ID, memberName(member), memberPhone(member));
+    }
+    if(shown == 0)
+        printf("No matching members found!\n");
+}
+
+/**
+ * Lists the current and past loans of one member.
+ */
+void listMemberLoans()
+{
+    char id[12];
+    printf("Enter the TC ID Number (11 digits) of the member: ");
+    readLine(id, sizeof(id));
+
+    const Member *member = findMember(memberKey(id));
+    if(member == NULL)
+    {
+        printf("No member found with this ID!\n");
+        return;
+    }
+
+    // Archived history first, then the loans still in the borrow table
+    BorrowTable history = {0};
+    visitArchive(member->ID, INT32_MIN, INT32_MAX, collectBorrow, &history);
+    const MemberLoanList *loans = findMemberLoans(member->ID);
+    for(size_t row = (loans != NULL) ? loans->first : INDEX_EMPTY; row != INDEX_EMPTY;
+        row = library.memberLoans.next[row])
+        *appendBorrow(&history) = library.borrows.items[row];
+
+    if(history.count == 0)
+    {
+        printf("%s has not borrowed any books.\n", memberName(member));
+        return;
+    }
+
+    printf("\n--- Loans of %s (%u open, %zu total",
+           memberName(member), loans != NULL ? loans->open : 0, history.count);
+    if(loanLimit > 0)
+        printf(", limit %d", loanLimit);
+    printf(") ---\n");
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t i = 0; i < history.count && pagerLine(&pager) == 0; i++)
+    {
+        const Borrow *borrow = &history.items[i];
+        const Book *book = findBook(borrow->bookID);
+        char borrowDate[11], returnDate[11];
+        formatDate(borrow->borrowDay, borrowDate);
+        formatDate(borrow->returnDay, returnDate);
+        printf("%s BookID: %d | %s | Borrowed: %s | Returned: %s\n",
+               borrow->returnDay == DATE_OPEN ? "*" : " ",
+               borrow->bookID,
+               book != NULL ? bookTitle(book) : "(deleted)",
+               borrowDate,
+               returnDate);
+    }
+    free(history.items);
+}
+
+/*
+    -------------------------
+    BORROW OPERATIONS
+    -------------------------
+*/
+
+/**
+ * Builds a borrow record from the fields of one borrows.txt line.
+ */
+static const char *parseBorrowFields(const TextField f[], void *table)
+{
+    Borrow borrow;
+    if(parseIntField(&f[0], &borrow.bookID) != 0)
+        return "invalid book ID";
+    if(parseMemberField(&f[1], &borrow.memberID) != 0)
+        return "member ID must be 11 digits";
+    if(parseDateField(&f[2], &borrow.borrowDay) != 0)
+        return "invalid borrow date";
+    if(f[3].length == 1 && f[3].start[0] == '-')
+        borrow.returnDay = DATE_OPEN;
+    else if(parseDateField(&f[3], &borrow.returnDay) != 0)
+        return "invalid return date";
+
+    *appendBorrow(table) = borrow;
+    return NULL;
+}
+
+/**
+ * Reads borrow data from the file into the borrow table.
+ * Returns the number of borrow records read.
+ */
+size_t loadBorrows(BorrowTable *table)
+{
+    /*
+        File line format:
+        bookID|memberID|borrowDate|returnDate
+    */
+    return parseDataFile(BORROWS_FILE, 4, parseBorrowFields, table);
+}
+
+/**
+ * Writes the borrow data from the table to the temporary borrows file.
+ * Returns 0 on success.
+ */
+int saveBorrows(const BorrowTable *table)
+{
+    uint64_t start = STAT_START();
+    FILE *fp = fopen(BORROWS_FILE TEMP_SUFFIX, "w");
+    if (fp == NULL)
+    {
+        printf("Failed to write borrow records to file!\n");
+        return -1;
+    }
+
+    for(size_t i = 0; i < table->count; i++)
+    {
+        writeBorrow(fp, &table->items[i]);
+        fputc('\n', fp);
+    }
+
+    STAT_RECORD(STAT_WRITE, start);
+    return closeDurable(fp, BORROWS_FILE TEMP_SUFFIX);
+}
+
+/**
+ * Writes a borrow record as a borrows.txt line, without the newline.
+ */
+void writeBorrow(FILE *out, const Borrow *borrow)
+{
+    char borrowDate[11], returnDate[11];
+    formatDate(borrow->borrowDay, borrowDate);
+    formatDate(borrow->returnDay, returnDate);
+    fprintf(out, "%d|%011llu|%s|%s", borrow->bookID, (unsigned long long)borrow->memberID,
+            borrowDate, returnDate);
+}
+
+/**
+ * Borrows a book for a member, provided the book is available.
+ */
+void borrowBook()
+{
+    int bookID;
+    char memberID[12];
+    printf("Enter the ID of the book to borrow: ");
+    scanf("%d", &bookID);
+    clearInputBuffer();
+
+    // Check if the book exists
+    Book *book = findBook(bookID);
+    if(book == NULL)
+    {
+        printf("No book found with this ID!\n");
+        return;
+    }
+    // Check if the book is already borrowed
+    if(book->status == 0)
+    {
+        printf("This book is already borrowed!\n");
+        return;
+    }
+
+    printf("Enter the TC ID Number (11 digits) of the member borrowing the book: ");
+    readLine(memberID, sizeof(memberID));
+
+    // Check if the member exists
+    uint64_t key = memberKey(memberID);
+    if(findMember(key) == NULL)
+    {
+        printf("No member found with this ID!\n");
+        return;
+    }
+
+    char borrowDate[11];
+    printf("Enter borrow date (dd/mm/yyyy): ");
+    readLine(borrowDate, sizeof(borrowDate));
+
+    // Record the loan (this also marks the book as borrowed)
+    LibStatus status = libBorrowBook(bookID, memberID, borrowDate);
+    if(status != LIB_OK)
+    {
+        printf("%s\n", statusMessage(status));
+        return;
+    }
+
+    printf("Book borrowing operation successful!\n");
+}
+
+/**
+ * Returns a borrowed book and updates the records.
+ */
+void returnBook()
+{
+    int bookID;
+    printf("Enter the ID of the book to return: ");
+    scanf("%d", &bookID);
+    clearInputBuffer();
+
+    // Check for an active borrow record
+    if(findOpenBorrow(bookID) == NULL)
+    {
+        printf("No active borrow record found for this book!\n");
+        return;
+    }
+
+    // Ask for return date
+    char returnDate[11];
+    printf("Enter return date (dd/mm/yyyy): ");
+    readLine(returnDate, sizeof(returnDate));
+
+    // Close the record (this also marks the book as available)
+    LibStatus status = libReturnBook(bookID, returnDate);
+    if(status != LIB_OK)
+    {
+        printf("%s\n", statusMessage(status));
+        return;
+    }
+
+    printf("Book return operation successful!\n");
+}
+
+/**
+ * Prints one borrow record (also used as an ArchiveVisitor). `ctx` is the
+ * Pager of the listing.
+ */
+static void printBorrow(const Borrow *borrow, void *ctx)
+{
+    if(pagerLine(ctx) != 0)
+        return;
+    char borrowDate[11], returnDate[11];
+    formatDate(borrow->borrowDay, borrowDate);
+    formatDate(borrow->returnDay, returnDate);
+    printf("BookID: %d | MemberID: %011llu | Borrowed: %s | Returned: %s\n",
+           borrow->bookID,
+           (unsigned long long)borrow->memberID,
+           borrowDate,
+           returnDate);
+}
+
+/**
+ * Prints the borrow records borrowed in [fromDay, toDay]: the archived
+ * history first, then the records in the borrow table.
+ * Returns the number of matching records.
+ */
+static size_t printBorrowHistory(int32_t fromDay, int32_t toDay)
+{
+    Pager pager;
+    pagerInit(&pager);
+    size_t found = visitArchive(MEMBER_NONE, fromDay, toDay, printBorrow, &pager);
+
+    ListCursor cursor;
+    listInit(&cursor, LIST_BORROWS);
+    cursor.fromDay = fromDay;
+    cursor.toDay   = toDay;
+    for(size_t row = listNext(&cursor); row != INDEX_NOT_FOUND && !pager.stopped; row = listNext(&cursor))
+    {
+        printBorrow(&library.borrows.items[row], &pager);
+        found++;
+    }
+    return found;
+}
+
+/**
+ * Lists the borrow records, all of them or those borrowed in a date range.
+ */
+void listBorrows()
+{
+    char from[11], to[11];
+    int32_t fromDay = INT32_MIN, toDay = INT32_MAX;
+    printf("Borrowed from (dd/mm/yyyy, leave empty for all): ");
+    readLine(from, sizeof(from));
+    printf("Borrowed until (dd/mm/yyyy, leave empty for all): ");
+    readLine(to, sizeof(to));
+    if((from[0] != '\0' && parseDate(from, &fromDay) != 0) ||
+       (to[0] != '\0' && parseDate(to, &toDay) != 0))
+    {
+        printf("Invalid date!\n");
+        return;
+    }
+
+    printf("\n--- Borrow Records ---\n");
+    if(printBorrowHistory(fromDay, toDay) == 0)
+        printf("No borrow records found.\n");
+}
+
+/**
+ * Lists the loans that have not been returned yet.
+ */
+void listOpenLoans()
+{
+    const OpenLoans *open = &library.openLoans;
+
+    if(open->count == 0)
+    {
+        printf("No books are currently on loan.\n");
+        return;
+    }
+
+    printf("\n--- Open Loans (%zu) ---\n", open->count);
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t i = 0; i < open->count && pagerLine(&pager) == 0; i++)
+    {
+        const Borrow *borrow = &library.borrows.items[open->rows[i]];
+        char borrowDate[11];
+        formatDate(borrow->borrowDay, borrowDate);
+        printf("BookID: %d | MemberID: %011llu | Borrowed: %s\n",
+               borrow->bookID,
+               (unsigned long long)borrow->memberID,
+               borrowDate);
+    }
+}
+
+/**
+ * Prints the open loans at positions [from, to) of the date-ordered open
+ * loan index with their due date relative to `today`.
+ */
+static void printLoansByDate(size_t from, size_t to, int32_t today, int period)
+{
+    const OpenLoans *open = &library.openLoans;
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t i = from; i < to && pagerLine(&pager) == 0; i++)
+    {
+        const Borrow *borrow = findOpenBorrow(open->byDate[i].bookID);
+        int32_t due = borrow->borrowDay + period;
+        char borrowDate[11], dueDate[11];
+        formatDate(borrow->borrowDay, borrowDate);
+        formatDate(due, dueDate);
+        printf("BookID: %d | MemberID: %011llu | Borrowed: %s | Due: %s (%+d days)\n",
+               borrow->bookID,
+               (unsigned long long)borrow->memberID,
+               borrowDate,
+               dueDate,
+               (int)(due - today));
+    }
+}
+
+/**
+ * Asks for today's date and a number of days (an empty answer keeps
+ * `defaultDays`). Returns 0 on success.
+ */
+static int readReportArgs(const char *daysPrompt, int defaultDays, int32_t *today, int *days)
+{
+    char date[11], text[12];
+    printf("Enter today's date (dd/mm/yyyy): ");
+    readLine(date, sizeof(date));
+    if(parseDate(date, today) != 0)
+    {
+        printf("Invalid date!\n");
+        return -1;
+    }
+
+    printf("%s [%d]: ", daysPrompt, defaultDays);
+    readLine(text, sizeof(text));
+    TextField field = { text, strlen(text) };
+    *days = defaultDays;
+    if((field.length > 0 && parseIntField(&field, days) != 0) || *days < 0)
+    {
+        printf("Invalid number of days!\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Lists the open loans that were borrowed more than N days ago (by default
+ * the loan period, i.e. the overdue loans), oldest first.
+ */
+void listOverdueLoans()
+{
+    int32_t today;
+    int days;
+    if(readReportArgs("Show loans older than how many days", LOAN_PERIOD_DAYS, &today, &days) != 0)
+        return;
+
+    // Borrowed before today - days: a prefix of the date-ordered index
+    size_t end = openLoanDateBound(today - days);
+    if(end == 0)
+    {
+        printf("No loans are older than %d days.\n", days);
+        return;
+    }
+
+    printf("\n--- Loans Older Than %d Days (%zu) ---\n", days, end);
+    printLoansByDate(0, end, today, LOAN_PERIOD_DAYS); // `days` only picks the loans
+}
+
+/**
+ * Lists the open loans that fall due within the next N days, soonest first.
+ */
+void listDueSoonLoans()
+{
+    int32_t today;
+    int days;
+    if(readReportArgs("Due within how many days", 3, &today, &days) != 0)
+        return;
+
+    // Due in [today, today + days] means borrowed in that range minus the loan period
+    int32_t first = today - LOAN_PERIOD_DAYS;
+    size_t from = openLoanDateBound(first);
+    size_t to   = openLoanDateBound(first + days + 1);
+    if(from == to)
+    {
+        printf("No loans are due within %d days.\n", days);
+        return;
+    }
+
+    printf("\n--- Loans Due Within %d Days (%zu) ---\n", days, to - from);
+    printLoansByDate(from, to, today, LOAN_PERIOD_DAYS);
+}
+
+/*
+    -------------------------
+    ANALYTICS
+    -------------------------
+*/
+
+/*
+    Circulation analytics over the whole borrow history, the borrow table
+    and the archive segments: the most borrowed books, the members with the
+    most loans, the loans per month and the average loan length, for all
+    loans or those borrowed in a date range.
+
+    A run takes three parallel passes of `threads` workers:
+
+    1. Copy: each worker copies its slice of the borrow table into
+       LoanColumns while the caller holds the read lock. The lock is
+       released after this pass, so the desks can keep working while the
+       rest runs on the copy.
+    2. Scan: each worker counts the loans of its slice by book, member and
+       month, then takes archive segments one at a time from a shared
+       counter, decodes each into its own LoanColumns and counts those.
+       Every count goes to one of `threads` partitions chosen by key hash.
+    3. Merge: worker p adds up partition p of every worker and picks the
+       `top` books and members of its partition.
+
+    The caller finally merges the per-partition top lists (the best of all
+    partitions is among them) and the month counts, and joins the books and
+    members for their titles and names only when printing.
+*/
+
+#define ANALYTICS_MAX_THREADS  64
+#define ANALYTICS_MIN_LOANS    65536 // Fewer borrow table loans per thread do not pay for the thread
+#define ANALYTICS_TOP          10    // Books and members in a report by default
+#define ANALYTICS_MAX_TOP      1000
+
+/**
+ * Returns the month number (year * 12 + month - 1) of a day number.
+ */
+static int32_t loanMonth(int32_t day)
+{
+    // Civil date from day number, as in formatDate
+    int z   = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp  = (5 * doy + 2) / 153;
+    int m   = (mp < 10) ? mp + 3 : mp - 9;
+    int y   = yoe + era * 400 + (m <= 2);
+    return y * 12 + m - 1;
+}
+
+/**
+ * Appends one loan to the columns (also used as an ArchiveVisitor).
+ */
+static void appendLoanColumns(const Borrow *borrow, void *ctx)
+{
+    LoanColumns *columns = ctx;
+    if(columns->count == columns->capacity)
+    {
+        size_t capacity = columns->capacity;
+        columns->bookID    = growTable(columns->bookID, &capacity, sizeof(int));
+        capacity = columns->capacity;
+        columns->memberID  = growTable(columns->memberID, &capacity, sizeof(uint64_t));
+        capacity = columns->capacity;
+        columns->borrowDay = growTable(columns->borrowDay, &capacity, sizeof(int32_t));
+        capacity = columns->capacity;
+        columns->returnDay = growTable(columns->returnDay, &capacity, sizeof(int32_t));
+        columns->capacity = capacity;
+    }
+    size_t i = columns->count++;
+    columns->bookID[i]    = borrow->bookID;
+    columns->memberID[i]  = borrow->memberID;
+    columns->borrowDay[i] = borrow->borrowDay;
+    columns->returnDay[i] = borrow->returnDay;
+}
+
+static void freeLoanColumns(LoanColumns *columns)
+{
+    free(columns->bookID);
+    free(columns->memberID);
+    free(columns->borrowDay);
+    free(columns->returnDay);
+    memset(columns, 0, sizeof(*columns));
+}
+
+/**
+ * Adds `count` loans to `key` in a count table.
+ */
+static void countAdd(CountTable *table, uint64_t key, uint64_t hash, uint64_t count)
+{
+    if(2 * (table->used + 1) > table->capacity)
+    {
+        // Keep the table at most half full: reinsert into twice the slots
+        size_t capacity = table->capacity ? 2 * table->capacity : INDEX_INITIAL_CAPACITY;
+        KeyCount *slots = calloc(capacity, sizeof(KeyCount));
+        if(slots == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(1);
+        }
+        for(size_t i = 0; i < table->capacity; i++)
+        {
+            if(table->slots[i].count == 0)
+                continue;
+            size_t j = table->slots[i].hash & (capacity - 1);
+            while(slots[j].count != 0)
+                j = (j + 1) & (capacity - 1);
+            slots[j] = table->slots[i];
+        }
+        free(table->slots);
+        table->slots    = slots;
+        table->capacity = capacity;
+    }
+
+    size_t mask = table->capacity - 1;
+    size_t i = hash & mask;
+    while(table->slots[i].count != 0 && table->slots[i].key != key)
+        i = (i + 1) & mask;
+    if(table->slots[i].count == 0)
+    {
+        table->slots[i].key  = key;
+        table->slots[i].hash = hash;
+        table->used++;
+    }
+    table->slots[i].count += count;
+}
+
+static void freeCountTable(CountTable *table)
+{
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+// Partition of a key: the high hash bits, the slots use the low ones
+#define KEY_PARTITION(hash, parts) ((size_t)(((hash) >> 40) % (uint64_t)(parts)))
+
+/**
+ * Orders loan counts by count, highest first, then by key.
+ */
+static int compareKeyCounts(const void *a, const void *b)
+{
+    const KeyCount *x = a, *y = b;
+    if(x->count != y->count)
+        return (x->count > y->count) ? -1 : 1;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+static int compareCountKeys(const void *a, const void *b)
+{
+    const KeyCount *x = a, *y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/**
+ * Returns the (at most) `top` highest counts of a table, highest first, in
+ * a new array, and stores their number in *count.
+ */
+static KeyCount *topCounts(const CountTable *table, size_t top, size_t *count)
+{
+    KeyCount *best = malloc((top + 1) * sizeof(KeyCount));
+    if(best == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    size_t n = 0;
+    for(size_t i = 0; i < table->capacity; i++)
+    {
+        const KeyCount *entry = &table->slots[i];
+        if(entry->count == 0 || (n == top && compareKeyCounts(entry, &best[n - 1]) >= 0))
+            continue;
+        // Insertion into the sorted list, the last one drops out when full
+        size_t j = (n < top) ? n++ : n - 1;
+        while(j > 0 && compareKeyCounts(entry, &best[j - 1]) < 0)
+        {
+            best[j] = best[j - 1];
+            j--;
+        }
+        best[j] = *entry;
+    }
+    *count = n;
+    return best;
+}
+
+/**
+ * Counts the loans at [from, to) of `columns` borrowed in the run's day
+ * range into the worker's partial aggregate.
+ */
+static void countLoans(AnalyticsWorker *w, const LoanColumns *columns, size_t from, size_t to)
+{
+    const AnalyticsRun *run = w->run;
+    LoanAggregate *a = &w->partial;
+    int parts = run->threads;
+    int32_t lastDay = DATE_OPEN, month = 0;
+
+    for(size_t i = from; i < to; i++)
+    {
+        int32_t day = columns->borrowDay[i];
+        if(day < run->fromDay || day > run->toDay)
+            continue;
+
+        uint64_t book = (uint64_t)(uint32_t)columns->bookID[i];
+        uint64_t hash = hashBookID(columns->bookID[i]);
+        countAdd(&a->books[KEY_PARTITION(hash, parts)], book, hash, 1);
+
+        hash = hashMemberID(columns->memberID[i]);
+        countAdd(&a->members[KEY_PARTITION(hash, parts)], columns->memberID[i], hash, 1);
+
+        // Loans come roughly in date order, so the month rarely changes
+        if(day != lastDay)
+        {
+            lastDay = day;
+            month = loanMonth(day);
+        }
+        hash = mixHash((uint64_t)(uint32_t)month);
+        countAdd(&a->months[KEY_PARTITION(hash, parts)], (uint64_t)(uint32_t)month, hash, 1);
+
+        a->loans++;
+        if(columns->returnDay[i] != DATE_OPEN)
+        {
+            a->returned++;
+            a->loanDays += columns->returnDay[i] - day;
+        }
+    }
+}
+
+// Pass 1: copy the worker's slice of the borrow table into the columns
+static void *copyLoansThread(void *arg)
+{
+    AnalyticsWorker *w = arg;
+    LoanColumns *columns = &w->run->table;
+    for(size_t i = w->from; i < w->to; i++)
+    {
+        const Borrow *borrow = &library.borrows.items[i];
+        columns->bookID[i]    = borrow->bookID;
+        columns->memberID[i]  = borrow->memberID;
+        columns->borrowDay[i] = borrow->borrowDay;
+        columns->returnDay[i] = borrow->returnDay;
+    }
+    return NULL;
+}
+
+// Pass 2: count the worker's slice of the table, then archive segments
+static void *scanLoansThread(void *arg)
+{
+    AnalyticsWorker *w = arg;
+    AnalyticsRun *run = w->run;
+    countLoans(w, &run->table, w->from, w->to);
+
+    LoanColumns segment = {0};
+    while(1)
+    {
+        pthread_mutex_lock(&run->segmentLock);
+        size_t next = run->nextSegment++;
+        pthread_mutex_unlock(&run->segmentLock);
+        if(next >= run->segmentCount)
+            break;
+
+        char path[300];
+        snprintf(path, sizeof(path), "%s/%s", ARCHIVE_DIR, run->segments[next]);
+        segment.count = 0;
+        if(visitSegment(path, MEMBER_NONE, run->fromDay, run->toDay, appendLoanColumns, &segment) < 0)
+        {
+            printf("%s: damaged archive segment skipped!\n", path);
+            continue;
+        }
+        countLoans(w, &segment, 0, segment.count);
+    }
+    freeLoanColumns(&segment);
+    return NULL;
+}
+
+// Pass 3: merge partition `index` of every worker and pick its best
+static void *mergeLoansThread(void *arg)
+{
+    AnalyticsWorker *w = arg;
+    AnalyticsRun *run = w->run;
+    int p = w->index;
+
+    for(int t = 0; t < run->threads; t++)
+    {
+        LoanAggregate *partial = &run->workers[t].partial;
+        CountTable *from[3] = { &partial->books[p], &partial->members[p], &partial->months[p] };
+        CountTable *to[3]   = { &w->books, &w->members, &w->months };
+        for(int k = 0; k < 3; k++)
+        {
+            for(size_t i = 0; i < from[k]->capacity; i++)
+            {
+                const KeyCount *entry = &from[k]->slots[i];
+                if(entry->count != 0)
+                    countAdd(to[k], entry->key, entry->hash, entry->count);
+            }
+            freeCountTable(from[k]);
+        }
+    }
+
+    w->topBooks   = topCounts(&w->books, run->top, &w->topBookCount);
+    w->topMembers = topCounts(&w->members, run->top, &w->topMemberCount);
+    return NULL;
+}
+
+/**
+ * Runs one pass on every worker thread and waits for them to finish.
+ */
+static void runAnalyticsPass(AnalyticsRun *run, void *(*pass)(void *))
+{
+    pthread_t threads[ANALYTICS_MAX_THREADS];
+    for(int t = 1; t < run->threads; t++)
+    {
+        if(pthread_create(&threads[t], NULL, pass, &run->workers[t]) != 0)
+        {
+            printf("Cannot start an analytics thread!\n");
+            exit(1);
+        }
+    }
+    pass(&run->workers[0]); // The calling thread is worker 0
+    for(int t = 1; t < run->threads; t++)
+        pthread_join(threads[t], NULL);
+}
+
+/**
+ * Returns the number of processors online, the default number of threads.
+ */
+int analyticsThreads()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if(n < 1)
+        return 1;
+    return (n > ANALYTICS_MAX_THREADS) ? ANALYTICS_MAX_THREADS : (int)n;
+}
+
+/**
+ * Computes the circulation analytics of the loans borrowed in
+ * [fromDay, toDay] on up to `threads` threads (0: one per processor).
+ * `top` is the length of the most borrowed books and busiest members lists.
+ * Returns 0 on success; the report is freed with freeLoanReport.
+ */
+int runAnalytics(int32_t fromDay, int32_t toDay, int threads, size_t top, LoanReport *report)
+{
+    double start = nowSeconds();
+    memset(report, 0, sizeof(*report));
+    report->fromDay = fromDay;
+    report->toDay   = toDay;
+    if(top < 1 || top > ANALYTICS_MAX_TOP || fromDay > toDay)
+        return -1;
+
+    AnalyticsRun run;
+    memset(&run, 0, sizeof(run));
+    pthread_mutex_init(&run.segmentLock, NULL);
+    run.fromDay  = fromDay;
+    run.toDay    = toDay;
+    run.top      = top;
+
+    // The segments and the table at the same point (see archiveLibrary)
+    beginRead();
+    run.segments = listSegments(&run.segmentCount);
+    size_t loans = library.borrows.count;
+
+    // Small inputs do not need every processor
+    if(threads <= 0)
+        threads = analyticsThreads();
+    if(threads > ANALYTICS_MAX_THREADS)
+        threads = ANALYTICS_MAX_THREADS;
+    size_t useful = loans / ANALYTICS_MIN_LOANS + run.segmentCount;
+    if(useful < (size_t)threads)
+        threads = (useful > 0) ? (int)useful : 1;
+    run.threads = threads;
+
+    run.workers = calloc((size_t)threads, sizeof(AnalyticsWorker));
+    LoanColumns *table = &run.table;
+    table->bookID    = malloc((loans + 1) * sizeof(int));
+    table->memberID  = malloc((loans + 1) * sizeof(uint64_t));
+    table->borrowDay = malloc((loans + 1) * sizeof(int32_t));
+    table->returnDay = malloc((loans + 1) * sizeof(int32_t));
+    if(run.workers == NULL || table->bookID == NULL || table->memberID == NULL ||
+       table->borrowDay == NULL || table->returnDay == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    table->count = table->capacity = loans;
+
+    for(int t = 0; t < threads; t++)
+    {
+        AnalyticsWorker *w = &run.workers[t];
+        w->run   = &run;
+        w->index = t;
+        w->from  = loans * (size_t)t / (size_t)threads;
+        w->to    = loans * (size_t)(t + 1) / (size_t)threads;
+        w->partial.books   = calloc((size_t)threads, sizeof(CountTable));
+        w->partial.members = calloc((size_t)threads, sizeof(CountTable));
+        w->partial.months  = calloc((size_t)threads, sizeof(CountTable));
+        if(w->partial.books == NULL || w->partial.members == NULL || w->partial.months == NULL)
+        {
+            printf("Out of memory!\n");
+            exit(1);
+        }
+    }
+
+    runAnalyticsPass(&run, copyLoansThread);
+    endRead();
+    runAnalyticsPass(&run, scanLoansThread);
+    runAnalyticsPass(&run, mergeLoansThread);
+
+    // The overall best are among the best of each partition
+    report->topBooks   = malloc((size_t)threads * top * sizeof(KeyCount));
+    report->topMembers = malloc((size_t)threads * top * sizeof(KeyCount));
+    size_t months = 0;
+    for(int t = 0; t < threads; t++)
+        months += run.workers[t].months.used;
+    report->months = malloc((months + 1) * sizeof(KeyCount));
+    if(report->topBooks == NULL || report->topMembers == NULL || report->months == NULL)
+    {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+
+    for(int t = 0; t < threads; t++)
+    {
+        AnalyticsWorker *w = &run.workers[t];
+        report->loans    += w->partial.loans;
+        report->returned += w->partial.returned;
+        report->loanDays += w->partial.loanDays;
+        report->books    += w->books.used;
+        report->members  += w->members.used;
+        memcpy(report->topBooks + report->topBookCount, w->topBooks, w->topBookCount * sizeof(KeyCount));
+        report->topBookCount += w->topBookCount;
+        memcpy(report->topMembers + report->topMemberCount, w->topMembers, w->topMemberCount * sizeof(KeyCount));
+        report->topMemberCount += w->topMemberCount;
+        for(size_t i = 0; i < w->months.capacity; i++)
+        {
+            if(w->months.slots[i].count != 0)
+                report->months[report->monthCount++] = w->months.slots[i];
+        }
+
+        free(w->topBooks);
+        free(w->topMembers);
+        freeCountTable(&w->books);
+        freeCountTable(&w->members);
+        freeCountTable(&w->months);
+        free(w->partial.books);
+        free(w->partial.members);
+        free(w->partial.months);
+    }
+    qsort(report->topBooks, report->topBookCount, sizeof(KeyCount), compareKeyCounts);
+    qsort(report->topMembers, report->topMemberCount, sizeof(KeyCount), compareKeyCounts);
+    qsort(report->months, report->monthCount, sizeof(KeyCount), compareCountKeys);
+    if(report->topBookCount > top)
+        report->topBookCount = top;
+    if(report->topMemberCount > top)
+        report->topMemberCount = top;
+
+    for(size_t i = 0; i < run.segmentCount; i++)
+        free(run.segments[i]);
+    free(run.segments);
+    free(run.workers);
+    freeLoanColumns(&run.table);
+    pthread_mutex_destroy(&run.segmentLock);
+
+    report->threads = threads;
+    report->seconds = nowSeconds() - start;
+    return 0;
+}
+
+void freeLoanReport(LoanReport *report)
+{
+    free(report->topBooks);
+    free(report->topMembers);
+    free(report->months);
+    memset(report, 0, sizeof(*report));
+}
+
+/**
+ * Prints an analytics report with the titles and names of the books and
+ * members in it (those deleted since are shown without).
+ */
+void printLoanReport(const LoanReport *report)
+{
+    char from[11], to[11];
+    formatDate(report->fromDay, from);
+    formatDate(report->toDay, to);
+    if(report->fromDay == INT32_MIN && report->toDay == INT32_MAX)
+        printf("\n--- Circulation Analytics: All Loans ---\n");
+    else
+        printf("\n--- Circulation Analytics: %s - %s ---\n",
+               report->fromDay == INT32_MIN ? "..." : from, report->toDay == INT32_MAX ? "..." : to);
+
+    printf("Loans: %llu (%llu returned, %llu open) of %zu books by %zu members\n",
+           (unsigned long long)report->loans, (unsigned long long)report->returned,
+           (unsigned long long)(report->loans - report->returned), report->books, report->members);
+    if(report->returned > 0)
+        printf("Average loan duration: %.1f days\n", (double)report->loanDays / (double)report->returned);
+    else
+        printf("Average loan duration: -\n");
+    printf("(%d thread%s, %.3f s)\n", report->threads, report->threads == 1 ? "" : "s", report->seconds);
+    if(report->loans == 0)
+        return;
+
+    beginRead();
+    printf("\nMost borrowed books:\n");
+    for(size_t i = 0; i < report->topBookCount; i++)
+    {
+        int id = (int)(uint32_t)report->topBooks[i].key;
+        const Book *book = findBook(id);
+        if(book != NULL)
+            printf("%3zu. [%d] %s - %s: %llu loans\n", i + 1, id, bookTitle(book), bookAuthor(book),
+                   (unsigned long long)report->topBooks[i].count);
+        else
+            printf("%3zu. [%d] (deleted): %llu loans\n", i + 1, id, (unsigned long long)report->topBooks[i].count);
+    }
+
+    printf("\nBusiest members:\n");
+    for(size_t i = 0; i < report->topMemberCount; i++)
+    {
+        uint64_t key = report->topMembers[i].key;
+        const Member *member = findMember(key);
+        printf("%3zu. [%011llu] %s: %llu loans\n", i + 1, (unsigned long long)key,
+               member != NULL ? memberName(member) : "(unknown member)",
+               (unsigned long long)report->topMembers[i].count);
+    }
+    endRead();
+
+    printf("\nLoans per month:\n");
+    Pager pager;
+    pagerInit(&pager);
+    for(size_t i = 0; i < report->monthCount && pagerLine(&pager) == 0; i++)
+    {
+        int32_t month = (int32_t)(uint32_t)report->months[i].key;
+        printf("%02d/%04d: %llu\n", month % 12 + 1, month / 12, (unsigned long long)report->months[i].count);
+    }
+}
+
+/**
+ * Asks for a date range and list length and prints the circulation
+ * analytics (Raporlama menu).
+ */
+void loanAnalytics()
+{
+    char from[11], to[11], text[12];
+    int32_t fromDay = INT32_MIN, toDay = INT32_MAX;
+    printf("Borrowed from (dd/mm/yyyy, leave empty for all): ");
+    readLine(from, sizeof(from));
+    printf("Borrowed until (dd/mm/yyyy, leave empty for all): ");
+    readLine(to, sizeof(to));
+    if((from[0] != '\0' && parseDate(from, &fromDay) != 0) ||
+       (to[0] != '\0' && parseDate(to, &toDay) != 0) || fromDay > toDay)
+    {
+        printf("Invalid date!\n");
+        return;
+    }
+
+    int top = ANALYTICS_TOP;
+    printf("Books and members to show [%d]: ", ANALYTICS_TOP);
+    readLine(text, sizeof(text));
+    TextField field = { text, strlen(text) };
+    if((field.length > 0 && parseIntField(&field, &top) != 0) || top < 1 || top > ANALYTICS_MAX_TOP)
+    {
+        printf("Invalid number!\n");
+        return;
+    }
+
+    LoanReport report;
+    runAnalytics(fromDay, toDay, 0, (size_t)top, &report);
+    printLoanReport(&report);
+    freeLoanReport(&report);
+}
+
+/**
+ * --analytics [--threads N] [--top N] [from] [to]: prints the analytics of
+ * the loans borrowed from..to (dd/mm/yyyy, both optional).
+ * Returns the process exit code.
+ */
+int runAnalyticsCommand(int argc, char *argv[])
+{
+    int threads = 0;
+    long top = ANALYTICS_TOP;
+    int32_t days[2] = { INT32_MIN, INT32_MAX };
+    int dates = 0;
+    for(int i = 0; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            top = strtol(argv[++i], NULL, 10);
+        else if(dates < 2 && parseDate(argv[i], &days[dates]) == 0)
+            dates++;
+        else
+        {
+            fprintf(stderr, "Invalid argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(top < 1 || top > ANALYTICS_MAX_TOP || threads < 0 || days[0] > days[1])
+    {
+        fprintf(stderr, "Invalid analytics arguments!\n");
+        return 1;
+    }
+
+    loadLibrary();
+    LoanReport report;
+    runAnalytics(days[0], days[1], threads, (size_t)top, &report);
+    printLoanReport(&report);
+    freeLoanReport(&report);
+    freeLibrary();
+    return 0;
+}
+
+/*
+    -------------------------
+    BATCH MODE
+    -------------------------
+*/
+
+/*
+    Batch mode (--batch [file] [--commit-every N]) reads one command per
+    line from a file or stdin and runs it against the loaded store:
+
+        addbook <ID>|<title>|<author>
+        deletebook <ID>                (fails with "borrowed" while the book is on loan)
+        addmember <TC ID>|<name>|<phone>
+        borrow <bookID> <memberID> <dd/mm/yyyy>
+        return <bookID> <dd/mm/yyyy>
+        findbook <ID>
+        findmember <TC ID>
+        search <words>
+        loans <TC ID>                  (all loans of a member, oldest first)
+        history <dd/mm/yyyy> <dd/mm/yyyy>  (loans borrowed in the date range)
+        overdue <dd/mm/yyyy> [days]    (open loans older than days, default 15)
+        list <books|members|borrows> [key=value...]
+                                       (one page of records; see listFilter)
+        stats                          (operation,count,avg,p50,p99,max in us; see STATISTICS)
+        commit
+
+    Arguments are separated by '|' when the line contains one, otherwise by
+    whitespace. Empty lines and lines starting with '#' are ignored.
+
+    Every command produces one tab-separated result line:
+
+        <line>  OK   <command> [fields...]
+        <line>  ERR  <command> <status name>
+
+    "list" returns at most limit= records (LIST_PAGE_LIMIT by default) as
+    data file lines, after the record count and the cursor= value of the
+    next page ("-" on the last page):
+
+        list books status=available limit=2
+        3  OK  list  2  17  1|Kürk Mantolu Madonna|Sabahattin Ali|1  4|...
+        list books status=available limit=2 cursor=17
+        list borrows|member=12345678901|from=01/01/2024|limit=50
+        list books sort=author prefix=Ş
+
+    With sort= or prefix= the records come in Turkish alphabetical order
+    and the cursor is a position in the sorted view.
+
+    Log writes are committed once at the end, after every N logged
+    operations when --commit-every is given, and whenever a "commit"
+    command is read. Queries and failed commands log nothing and so never
+    cause a commit. If a commit fails, "commit" answers "ERR commit io",
+    and a failed automatic commit is reported on stderr and makes the exit
+    code 2.
+*/
+
+#define MAX_BATCH_ARGS 8
+
+/**
+ * Splits the arguments of a batch command in place.
+ * Returns the number of arguments.
+ */
+static int splitBatchArgs(char *args, char *argv[], int maxArgs)
+{
+    if(*args == '\0')
+        return 0;
+    if(strchr(args, '|') != NULL)
+        return splitFields(args, argv, maxArgs);
+
+    int n = 0;
+    for(char *tok = strtok(args, " \t"); tok != NULL && n < maxArgs; tok = strtok(NULL, " \t"))
+        argv[n++] = tok;
+    return n;
+}
+
+/**
+ * Parses a whole string as an int. Returns 0 on success, -1 otherwise.
+ */
+static int parseIntArg(const char *text, int *value)
+{
+    TextField field = { text, strlen(text) };
+    return parseIntField(&field, value);
+}
+
+/**
+ * Returns 1 for the batch commands that only read the store.
+ */
+static int isBatchQuery(const char *cmd)
+{
+    static const char *const queries[] = { "search", "findbook", "findmember", "loans", "history", "overdue", "counts", "stats", "list" };
+    for(size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+    {
+        if(strcmp(cmd, queries[i]) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Runs one read-only batch command and prints its result line on success.
+ * The caller holds a read section. Returns the status of the command.
+ */
+static LibStatus runBatchQuery(size_t lineNo, const char *cmd, char *args, FILE *out)
+{
+    char *argv[MAX_BATCH_ARGS];
+    LibStatus status = LIB_ERR_INVALID;
+    int id;
+
+    if(strcmp(cmd, "search") == 0)
+    {
+        IdList ids = {0};
+        searchText(args, &ids);
+        fprintf(out, "%zu\tOK\tsearch\t%zu", lineNo, ids.count);
+        for(size_t i = 0; i < ids.count; i++)
+            fprintf(out, "%c%d", i == 0 ? '\t' : ',', ids.ids[i]);
+        fputc('\n', out);
+        freeIdList(&ids);
+        return LIB_OK;
+    }
+
+    int argc = splitBatchArgs(args, argv, MAX_BATCH_ARGS);
+
+    if(strcmp(cmd, "findbook") == 0)
+    {
+        if(argc == 1 && parseIntArg(argv[0], &id) == 0)
+        {
+            const Book *book = findBook(id);
+            if(book != NULL)
+            {
+                fprintf(out, "%zu\tOK\tfindbook\t%d\t%s\t%s\t%d\n",
+                        lineNo, book->ID, bookTitle(book), bookAuthor(book), book->status);
+                return LIB_OK;
+            }
+            status = LIB_ERR_NO_BOOK;
+        }
+    }
+    else if(strcmp(cmd, "findmember") == 0)
+    {
+        if(argc == 1)
+        {
+            const Member *member = findMember(memberKey(argv[0]));
+            if(member != NULL)
+            {
+                fprintf(out, "%zu\tOK\tfindmember\t%011llu\t%s\t%s\n",
+                        lineNo, (unsigned long long)member->ID, memberName(member), memberPhone(member));
+                return LIB_OK;
+            }
+            status = LIB_ERR_NO_MEMBER;
+        }
+    }
+    else if(strcmp(cmd, "loans") == 0)
+    {
+        if(argc == 1)
+        {
+            uint64_t key = memberKey(argv[0]);
+            if(findMember(key) != NULL)
+            {
+                BorrowTable history = {0};
+                visitArchive(key, INT32_MIN, INT32_MAX, collectBorrow, &history);
+                const MemberLoanList *loans = findMemberLoans(key);
+                for(size_t row = (loans != NULL) ? loans->first : INDEX_EMPTY;
+                    row != INDEX_EMPTY; row = library.memberLoans.next[row])
+                    *appendBorrow(&history) = library.borrows.items[row];
+
+                fprintf(out, "%zu\tOK\tloans\t%u\t%zu", lineNo,
+                        loans != NULL ? loans->open : 0, history.count);
+                for(size_t i = 0; i < history.count; i++)
+                {
+                    const Borrow *borrow = &history.items[i];
+                    char borrowDate[11], returnDate[11];
+                    formatDate(borrow->borrowDay, borrowDate);
+                    formatDate(borrow->returnDay, returnDate);
+                    fprintf(out, "\t%d,%s,%s", borrow->bookID, borrowDate, returnDate);
+                }
+                fputc('\n', out);
+                free(history.items);
+                return LIB_OK;
+            }
+            status = LIB_ERR_NO_MEMBER;
+        }
+    }
+    else if(strcmp(cmd, "history") == 0)
+    {
+        int32_t from, to;
+        if(argc == 2 && parseDate(argv[0], &from) == 0 && parseDate(argv[1], &to) == 0)
+        {
+            BorrowTable history = {0};
+            visitArchive(MEMBER_NONE, from, to, collectBorrow, &history);
+            for(size_t i = 0; i < library.borrows.count; i++)
+            {
+                const Borrow *borrow = &library.borrows.items[i];
+                if(borrow->borrowDay >= from && borrow->borrowDay <= to)
+                    *appendBorrow(&history) = *borrow;
+            }
+
+            fprintf(out, "%zu\tOK\thistory\t%zu", lineNo, history.count);
+            for(size_t i = 0; i < history.count; i++)
+            {
+                const Borrow *borrow = &history.items[i];
+                char borrowDate[11], returnDate[11];
+                formatDate(borrow->borrowDay, borrowDate);
+                formatDate(borrow->returnDay, returnDate);
+                fprintf(out, "\t%d,%011llu,%s,%s", borrow->bookID, (unsigned long long)borrow->memberID,
+                        borrowDate, returnDate);
+            }
+            fputc('\n', out);
+            free(history.items);
+            return LIB_OK;
+        }
+    }
+    else if(strcmp(cmd, "counts") == 0)
+    {
+        if(argc == 0)
+        {
+            size_t available = countAvailable();
+            fprintf(out, "%zu\tOK\tcounts\t%zu\t%zu\t%zu\t%zu\t%zu\n", lineNo, library.books.count,
+                    available, library.books.count - available, library.members.count, library.openLoans.count);
+            return LIB_OK;
+        }
+    }
+    else if(strcmp(cmd, "stats") == 0)
+    {
+        if(argc == 0)
+        {
+            size_t used = 0;
+            for(int i = 0; i < STAT_COUNT; i++)
+                used += (stats[i].count > 0);
+            fprintf(out, "%zu\tOK\tstats\t%zu", lineNo, used);
+            for(int i = 0; i < STAT_COUNT; i++)
+            {
+                const StatHistogram *h = &stats[i];
+                if(h->count > 0)
+                    fprintf(out, "\t%s,%llu,%.1f,%.1f,%.1f,%.1f", statNames[i], (unsigned long long)h->count,
+                            h->totalNs / 1e3 / h->count, statPercentile(h, 0.50), statPercentile(h, 0.99),
+                            h->maxNs / 1e3);
+            }
+            fputc('\n', out);
+            return LIB_OK;
+        }
+    }
+    else if(strcmp(cmd, "overdue") == 0)
+    {
+        int32_t today;
+        int days = LOAN_PERIOD_DAYS;
+        if((argc == 1 || argc == 2) && parseDate(argv[0], &today) == 0 &&
+           (argc == 1 || (parseIntArg(argv[1], &days) == 0 && days >= 0)))
+        {
+            const OpenLoans *open = &library.openLoans;
+            size_t end = openLoanDateBound(today - days);
+            fprintf(out, "%zu\tOK\toverdue\t%zu", lineNo, end);
+            for(size_t i = 0; i < end; i++)
+                fprintf(out, "%c%d", i == 0 ? '\t' : ',', open->byDate[i].bookID);
+            fputc('\n', out);
+            return LIB_OK;
+        }
+    }
+    else if(strcmp(cmd, "list") == 0)
+    {
+        ListKind kind;
+        ListCursor cursor;
+        int valid = (argc >= 1 && parseListKind(argv[0], &kind) == 0);
+        if(valid)
+        {
+            listInit(&cursor, kind);
+            cursor.limit = LIST_PAGE_LIMIT;
+        }
+        for(int i = 1; i < argc && valid; i++)
+            valid = (listFilter(&cursor, argv[i]) == 0);
+
+        if(valid)
+        {
+            // Walk the page once to count it and to see whether another follows
+            ListCursor page = cursor;
+            size_t count = 0;
+            while(count < cursor.limit && listNext(&page) != INDEX_NOT_FOUND)
+                count++;
+            size_t next = page.position;
+            int more = (count == cursor.limit && listNext(&page) != INDEX_NOT_FOUND);
+
+            fprintf(out, "%zu\tOK\tlist\t%zu\t", lineNo, count);
+            if(more)
+                fprintf(out, "%zu", next);
+            else
+                fputc('-', out);
+            for(size_t i = 0; i < count; i++)
+            {
+                size_t row = listNext(&cursor);
+                fputc('\t', out);
+                writeListed(out, &cursor, row);
+            }
+            fputc('\n', out);
+            return LIB_OK;
+        }
+    }
+    return status;
+}
+
+/**
+ * Runs one batch command and prints its result line.
+ * Returns the status of the command.
+ */
+static LibStatus runBatchCommand(size_t lineNo, char *line, FILE *out)
+{
+    char *cmd = line + strspn(line, " \t");
+    char *args = cmd + strcspn(cmd, " \t");
+    if(*args != '\0')
+        *args++ = '\0';
+    args += strspn(args, " \t");
+
+    char *argv[MAX_BATCH_ARGS];
+    LibStatus status = LIB_ERR_INVALID;
+    int id;
+
+    if(isBatchQuery(cmd))
+    {
+        // Queries run in parallel with other readers, on one consistent state
+        beginRead();
+        status = runBatchQuery(lineNo, cmd, args, out);
+        endRead();
+        if(status != LIB_OK)
+            fprintf(out, "%zu\tERR\t%s\t%s\n", lineNo, cmd, statusName(status));
+        return status;
+    }
+
+    int argc = splitBatchArgs(args, argv, MAX_BATCH_ARGS);
+
+    if(strcmp(cmd, "addbook") == 0)
+    {
+        if(argc == 3 && parseIntArg(argv[0], &id) == 0)
+            status = libAddBook(id, argv[1], argv[2]);
+    }
+    else if(strcmp(cmd, "deletebook") == 0)
+    {
+        if(argc == 1 && parseIntArg(argv[0], &id) == 0)
+            status = libDeleteBook(id);
+    }
+    else if(strcmp(cmd, "addmember") == 0)
+    {
+        if(argc == 3)
+            status = libAddMember(argv[0], argv[1], argv[2]);
+    }
+    else if(strcmp(cmd, "borrow") == 0)
+    {
+        if(argc == 3 && parseIntArg(argv[0], &id) == 0)
+            status = libBorrowBook(id, argv[1], argv[2]);
+    }
+    else if(strcmp(cmd, "return") == 0)
+    {
+        if(argc == 2 && parseIntArg(argv[0], &id) == 0)
+            status = libReturnBook(id, argv[1]);
+    }
+    else if(strcmp(cmd, "commit") == 0)
+    {
+        status = (commitLog() == 0) ? LIB_OK : LIB_ERR_IO;
+    }
+
+    if(status == LIB_OK)
+        fprintf(out, "%zu\tOK\t%s\n", lineNo, cmd);
+    else
+        fprintf(out, "%zu\tERR\t%s\t%s\n", lineNo, cmd, statusName(status));
+    return status;
+}
+
+/**
+ * Commits the deferred log writes of a batch. Returns the number of logged
+ * operations that could not be made durable (0 on success).
+ */
+static size_t commitBatch()
+{
+    size_t pending = library.uncommitted;
+    return (commitLog() == 0) ? 0 : pending;
+}
+
+/**
+ * Runs a stream of batch commands against the store.
+ * Returns the process exit code (0 if every command succeeded).
+ */
+int runBatch(const char *path, size_t commitEvery)
+{
+    FILE *in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if(in == NULL)
+    {
+        fprintf(stderr, "Cannot open %s!\n", path);
+        return 1;
+    }
+
+    static char outBuffer[BATCH_OUTPUT_BUFFER];
+    setvbuf(stdout, outBuffer, _IOFBF, sizeof(outBuffer));
+
+    loadLibrary();
+    library.deferCommit = 1;
+
+    char *line = NULL;
+    size_t lineSize = 0, lineNo = 0, ok = 0, failed = 0, lost = 0;
+    double start = nowSeconds();
+
+    while(getline(&line, &lineSize, in) != -1)
+    {
+        lineNo++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        const char *first = line + strspn(line, " \t");
+        if(*first == '\0' || *first == '#')
+            continue;
+
+        if(runBatchCommand(lineNo, line, stdout) == LIB_OK)
+            ok++;
+        else
+            failed++;
+
+        if(commitEvery > 0 && library.uncommitted >= commitEvery)
+            lost += commitBatch();
+    }
+
+    if(library.uncommitted > 0 || library.fileLocked)
+        lost += commitBatch(); // Also releases the file lock taken by a failed write
+    fflush(stdout);
+
+    double elapsed = nowSeconds() - start;
+    fprintf(stderr, "%zu commands (%zu ok, %zu failed) in %.3f s, %.0f ops/sec\n",
+            ok + failed, ok, failed, elapsed, (ok + failed) / (elapsed > 0 ? elapsed : 1e-9));
+    if(lost > 0)
+        fprintf(stderr, "%zu operations reported OK could not be written to disk!\n", lost);
+
+    free(line);
+    if(in != stdin)
+        fclose(in);
+    checkpointIfStale();
+    freeLibrary();
+    return (failed == 0 && lost == 0) ? 0 : 2;
+}
+
+/*
+    -------------------------
+    SERVER MODE
+    -------------------------
+*/
+
+/*
+    --serve [socket] keeps the store resident and answers the batch
+    commands (see BATCH MODE) over a Unix domain stream socket, one command
+    per line and one response line per command:
+
+        request:   borrow 12 12345678901 01/02/2024\n
+        response:  <n>\tOK\tborrow\n
+
+    where <n> numbers the requests of the connection. Clients may pipeline:
+    they can send any number of requests without waiting, and responses
+    come back in order. The server is a single poll() loop; in each round
+    it runs every complete request that has arrived on any connection, then
+    commits the log once for all of them (group commit), and only then
+    sends the responses, so an OK always means the change is on disk. If
+    the commit fails, the writes of the round are answered "ERR <command>
+    io" instead (failPendingWrites).
+    A round that only read sends its responses at once, without a commit.
+    With --commit-window <us>, the commit waits up to that long after the
+    first uncommitted request for more requests to share its fsync (poll()
+    counts in milliseconds, so shorter windows round up to 1 ms).
+    SIGINT/SIGTERM stop the server after the current round.
+
+    --loadgen opens several connections, keeps --depth requests in flight
+    on each and reports requests/sec and latency percentiles, separately
+    for searches and for borrow/return requests.
+*/
+
+#define SERVER_MAX_CLIENTS 256
+#define SERVER_MAX_LINE    4096  // Longest accepted request line
+#define SERVER_READ_SIZE   65536
+
+static volatile sig_atomic_t serverStopping;
+
+static void stopServer(int signo)
+{
+    (void)signo;
+    serverStopping = 1;
+}
+
+/**
+ * Writes as much of a client's committed responses as the socket takes.
+ * Returns -1 if the connection is broken.
+ */
+static int flushClient(ServerClient *client)
+{
+    while(client->outSent < client->outReady)
+    {
+        ssize_t n = write(client->fd, client->out + client->outSent, client->outReady - client->outSent);
+        if(n < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        client->outSent += (size_t)n;
+    }
+
+    // Keep only the responses still waiting for their commit
+    memmove(client->out, client->out + client->outSent, client->outLength - client->outSent);
+    client->outLength -= client->outSent;
+    client->outReady = client->outSent = 0;
+    return 0;
+}
+
+/**
+ * Reads what a client has sent and runs every complete request line,
+ * writing the responses to `out`. Returns the number of requests run, or
+ * -1 if the connection has to be dropped.
+ */
+static long serveClient(ServerClient *client, FILE *out)
+{
+    for(;;)
+    {
+        while(client->inCapacity - client->inLength < SERVER_READ_SIZE)
+            client->in = growTable(client->in, &client->inCapacity, 1);
+        ssize_t n = read(client->fd, client->in + client->inLength, SERVER_READ_SIZE);
+        if(n > 0)
+        {
+            client->inLength += (size_t)n;
+            continue;
+        }
+        if(n == 0)
+            client->closing = 1;
+        else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return -1;
+        break;
+    }
+
+    long served = 0;
+    char *start = client->in, *end = client->in + client->inLength;
+    char *newline;
+    while((newline = memchr(start, '\n', (size_t)(end - start))) != NULL)
+    {
+        *newline = '\0';
+        if(newline > start && newline[-1] == '\r')
+            newline[-1] = '\0';
+        const char *first = start + strspn(start, " \t");
+        if(*first != '\0' && *first != '#')
+        {
+            runBatchCommand(++client->requests, start, out);
+            served++;
+        }
+        start = newline + 1;
+    }
+
+    // Keep the incomplete last line for the next read
+    client->inLength = (size_t)(end - start);
+    memmove(client->in, start, client->inLength);
+    if(client->inLength > SERVER_MAX_LINE)
+        return -1;
+    return served;
+}
+
+/**
+ * Appends bytes to a client's response buffer.
+ */
+static void appendClient(ServerClient *client, const char *text, size_t length)
+{
+    while(client->outLength + length > client->outCapacity)
+        client->out = growTable(client->out, &client->outCapacity, 1);
+    memcpy(client->out + client->outLength, text, length);
+    client->outLength += length;
+}
+
+/**
+ * After a failed commit, turns the "<n> OK <command>" responses to the
+ * writes it held back into "<n> ERR <command> io". Query responses stay.
+ */
+static void failPendingWrites(ServerClient *client)
+{
+    size_t length = client->outLength - client->outReady;
+    char *pending = malloc(length);
+    memcpy(pending, client->out + client->outReady, length);
+    client->outLength = client->outReady;
+
+    for(char *line = pending, *end = pending + length; line < end; )
+    {
+        char *newline = memchr(line, '\n', (size_t)(end - line));
+        char *next = (newline != NULL) ? newline + 1 : end;
+        char *status = memchr(line, '\t', (size_t)(next - line));
+        char *cmd = (status != NULL && next - status > 4 && memcmp(status, "\tOK\t", 4) == 0) ? status + 4 : NULL;
+
+        char response[64];
+        int n = -1;
+        if(cmd != NULL && newline != NULL && memchr(cmd, '\t', (size_t)(newline - cmd)) == NULL)
+        {
+            *newline = '\0';
+            if(!isBatchQuery(cmd))
+                n = snprintf(response, sizeof(response), "%.*s\tERR\t%s\t%s\n",
+                             (int)(status - line), line, cmd, statusName(LIB_ERR_IO));
+            *newline = '\n';
+        }
+        if(n > 0 && n < (int)sizeof(response))
+            appendClient(client, response, (size_t)n);
+        else
+            appendClient(client, line, (size_t)(next - line));
+        line = next;
+    }
+    free(pending);
+}
+
+static void dropClient(ServerClient *client)
+{
+    close(client->fd);
+    free(client->in);
+    free(client->out);
+}
+
+/**
+ * Runs the server until it is stopped by a signal.
+ * Returns the process exit code.
+ */
+int runServer(const char *socketPath, double commitWindow)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path is too long!\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, socketPath);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath); // A stale socket from an earlier run
+    if(listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+       listen(listener, 64) != 0)
+    {
+        fprintf(stderr, "Cannot listen on %s!\n", socketPath);
+        return 1;
+    }
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stopServer; // No SA_RESTART: poll() returns on a signal
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    loadLibrary();
+    library.deferCommit  = 1;
+    library.commitWindow = commitWindow;
+    fprintf(stderr, "Serving %zu books, %zu members on %s\n",
+            library.books.count, library.members.count, socketPath);
+
+    static ServerClient clients[SERVER_MAX_CLIENTS];
+    static struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+    size_t clientCount = 0, connections = 0, served = 0, rounds = 0;
+    double start = nowSeconds();
+    double pendingSince = -1; // When the oldest uncommitted request was run, -1: none
+
+    while(!serverStopping)
+    {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for(size_t i = 0; i < clientCount; i++)
+        {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN | (clients[i].outReady > clients[i].outSent ? POLLOUT : 0);
+            fds[i + 1].revents = 0;
+        }
+        int timeout = -1;
+        if(pendingSince >= 0)
+        {
+            double left = pendingSince + commitWindow - nowSeconds();
+            timeout = (left > 0) ? (int)(left * 1000) + 1 : 0;
+        }
+        if(poll(fds, clientCount + 1, timeout) < 0)
+            continue; // Interrupted; check serverStopping
+
+        // Run the requests of every readable client
+        for(size_t i = 0; i < clientCount; i++)
+        {
+            ServerClient *client = &clients[i];
+            if((fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+                continue;
+
+            char *responses = NULL;
+            size_t length = 0;
+            FILE *out = open_memstream(&responses, &length);
+            long n = (out != NULL) ? serveClient(client, out) : -1;
+            if(out != NULL)
+                fclose(out);
+            if(n < 0)
+                client->closing = 1;
+            else if(n > 0)
+            {
+                served += (size_t)n;
+                // A failed write logs nothing but still holds the file lock until commitLog
+                if(pendingSince < 0 && (library.uncommitted > 0 || library.fileLocked))
+                    pendingSince = nowSeconds();
+            }
+
+            appendClient(client, responses, length);
+            free(responses);
+
+            // Nothing uncommitted was seen: read-only answers go out right away
+            if(pendingSince < 0)
+                client->outReady = client->outLength;
+        }
+
+        // Commit them together once the window is over; then they may be answered
+        if(pendingSince >= 0 && nowSeconds() - pendingSince >= commitWindow)
+        {
+            int failed = commitLog() != 0;
+            rounds++;
+            pendingSince = -1;
+            for(size_t i = 0; i < clientCount; i++)
+            {
+                if(failed)
+                    failPendingWrites(&clients[i]);
+                clients[i].outReady = clients[i].outLength;
+            }
+        }
+
+        // Send the answers and drop the clients that are done
+        for(size_t i = 0; i < clientCount; )
+        {
+            ServerClient *client = &clients[i];
+            if(flushClient(client) != 0 || (client->closing && client->outLength == 0))
+            {
+                dropClient(client);
+                clients[i] = clients[--clientCount];
+                continue;
+            }
+            i++;
+        }
+
+        // Accept new connections
+        if(fds[0].revents & POLLIN)
+        {
+            int fd;
+            while((fd = accept(listener, NULL, NULL)) >= 0)
+            {
+                if(clientCount == SERVER_MAX_CLIENTS)
+                {
+                    close(fd);
+                    continue;
+                }
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                memset(&clients[clientCount], 0, sizeof(ServerClient));
+                clients[clientCount++].fd = fd;
+                connections++;
+            }
+        }
+    }
+
+    int failed = (pendingSince >= 0) ? commitLog() != 0 : 0;
+    for(size_t i = 0; i < clientCount; i++)
+    {
+        if(failed)
+            failPendingWrites(&clients[i]);
+        clients[i].outReady = clients[i].outLength;
+        flushClient(&clients[i]);
+        dropClient(&clients[i]);
+    }
+    close(listener);
+    unlink(socketPath);
 
-    printf("Author Name: ");
-    fgets(newBook.author, sizeof(newBook.author), stdin);
-    newBook.author[strcspn(newBook.author, "\n")] = '\0';
+    double elapsed = nowSeconds() - start;
+    fprintf(stderr, "Served %zu requests on %zu connection(s) in %zu commit(s), %.0f requests/sec\n",
+            served, connections, rounds, served / (elapsed > 0 ? elapsed : 1e-9));
+
+    library.deferCommit = 0;
+    if(library.logEntries > 0)
+        compactLibrary();
+    checkpointIfStale();
+    freeLibrary();
+    return 0;
+}
 
-    newBook.status = 1; // By default, a newly added book is available
+/**
+ * Connects to the server socket. Returns the socket, or -1.
+ */
+static int connectServer(const char *socketPath)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(socketPath) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, socketPath);
 
-    // Add to the end of the array
-    books[count++] = newBook;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
 
-    // Write to file
-    saveBooks(books, count);
-    printf("Book added successfully!\n");
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
 /**
- * Deletes a book from the system based on its ID.
+ * Runs one load generator connection: keeps up to `depth` requests in
+ * flight and records the latency of each response.
  */
-void deleteBook()
+static void *loadThread(void *arg)
 {
-    Book books[MAX_BOOKS];
-    int count = loadBooks(books);
+    LoadWorker *w = arg;
+    int fd = connectServer(w->socketPath);
+    if(fd < 0)
+    {
+        w->failed = 1;
+        return NULL;
+    }
 
-    int id;
-    printf("Enter the ID of the book to delete: ");
-    scanf("%d", &id);
+    double *sentAt = malloc(w->depth * sizeof(double));
+    char   *isWrite = malloc(w->depth);
+    char   *borrowed = calloc((size_t)w->books + 1, 1); // Books this connection holds
+    char    request[128], buf[SERVER_READ_SIZE];
+    size_t  sent = 0, received = 0, buffered = 0;
 
-    int found = 0;
-    for(int i = 0; i < count; i++)
+    while(received < w->requests && !w->failed)
     {
-        if(books[i].ID == id)
+        // Fill the pipeline
+        while(sent < w->requests && sent - received < w->depth)
+        {
+            int length;
+            int writing = (int)(rand_r(&w->seed) % 100) < w->writePercent;
+            if(writing)
+            {
+                int id = 1 + (int)(rand_r(&w->seed) % (unsigned)w->books);
+                char member[12];
+                generateMemberID(rand_r(&w->seed) % (unsigned)w->members, member);
+                if(borrowed[id])
+                    length = snprintf(request, sizeof(request), "return %d 02/02/2024\n", id);
+                else
+                    length = snprintf(request, sizeof(request), "borrow %d %s 01/02/2024\n", id, member);
+                borrowed[id] = !borrowed[id];
+            }
+            else
+            {
+                length = snprintf(request, sizeof(request), "search %s\n", sampleWord(rand_r(&w->seed)));
+            }
+
+            sentAt[sent % w->depth]  = nowSeconds();
+            isWrite[sent % w->depth] = (char)writing;
+            for(int done = 0; done < length; )
+            {
+                ssize_t n = send(fd, request + done, (size_t)(length - done), 0);
+                if(n <= 0)
+                {
+                    w->failed = 1;
+                    break;
+                }
+                done += (int)n;
+            }
+            sent++;
+        }
+
+        // Collect responses
+        ssize_t n = read(fd, buf + buffered, sizeof(buf) - buffered);
+        if(n <= 0)
         {
-            found = 1;
-            // To delete the i-th element, move the last element to this position
-            books[i] = books[count - 1];
-            count--;
+            w->failed = 1;
             break;
         }
+        buffered += (size_t)n;
+
+        char *start = buf, *newline;
+        while((newline = memchr(start, '\n', buffered - (size_t)(start - buf))) != NULL)
+        {
+            double latency = nowSeconds() - sentAt[received % w->depth];
+            if(isWrite[received % w->depth])
+                w->writeLatency[w->writes++] = latency;
+            else
+                w->searchLatency[w->searches++] = latency;
+
+            const char *status = memchr(start, '\t', (size_t)(newline - start));
+            if(status != NULL && strncmp(status + 1, "OK", 2) == 0)
+                w->ok++;
+            else
+                w->errors++;
+            received++;
+            start = newline + 1;
+        }
+        buffered -= (size_t)(start - buf);
+        memmove(buf, start, buffered);
+        if(buffered == sizeof(buf))
+            w->failed = 1; // A response line longer than the buffer
+    }
+
+    free(sentAt);
+    free(isWrite);
+    free(borrowed);
+    close(fd);
+    return NULL;
+}
+
+/**
+ * Prints the count and latency percentiles of one request type.
+ */
+static void printLatencies(const char *name, double *latency, size_t count)
+{
+    if(count == 0)
+        return;
+    qsort(latency, count, sizeof(double), compareDoubles);
+    printf("  %-7s %9zu requests  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+           name, count,
+           latency[count / 2] * 1e6,
+           latency[(size_t)(count * 0.99)] * 1e6,
+           latency[count - 1] * 1e6);
+}
+
+/**
+ * Runs the load generator against a server. Returns the process exit code.
+ */
+int runLoadgen(int argc, char *argv[])
+{
+    const char *socketPath = SERVER_SOCKET;
+    int connections = 4, books = 1000, members = 1000, writePercent = 10;
+    size_t requests = 100000, depth = 16;
+
+    for(int i = 0; i + 1 < argc; i += 2)
+    {
+        if(strcmp(argv[i], "--socket") == 0)           socketPath   = argv[i + 1];
+        else if(strcmp(argv[i], "--connections") == 0) connections  = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--requests") == 0)    requests     = strtoul(argv[i + 1], NULL, 10);
+        else if(strcmp(argv[i], "--depth") == 0)       depth        = strtoul(argv[i + 1], NULL, 10);
+        else if(strcmp(argv[i], "--books") == 0)       books        = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--members") == 0)     members      = atoi(argv[i + 1]);
+        else if(strcmp(argv[i], "--writes") == 0)      writePercent = atoi(argv[i + 1]);
+    }
+    if(connections < 1 || requests < 1 || depth < 1 || books < 1 || members < 1)
+    {
+        fprintf(stderr, "Invalid load generator options!\n");
+        return 1;
     }
 
-    if(found)
+    LoadWorker *workers = calloc((size_t)connections, sizeof(LoadWorker));
+    pthread_t  *threads = calloc((size_t)connections, sizeof(pthread_t));
+    size_t perConnection = (requests + (size_t)connections - 1) / (size_t)connections;
+
+    double start = nowSeconds();
+    for(int i = 0; i < connections; i++)
     {
-        saveBooks(books, count);
-        printf("Book deleted.\n");
+        LoadWorker *w = &workers[i];
+        w->socketPath    = socketPath;
+        w->requests      = perConnection;
+        w->depth         = depth;
+        w->books         = books;
+        w->members       = members;
+        w->writePercent  = writePercent;
+        w->seed          = 7u + (unsigned)i;
+        w->searchLatency = malloc(perConnection * sizeof(double));
+        w->writeLatency  = malloc(perConnection * sizeof(double));
+        pthread_create(&threads[i], NULL, loadThread, w);
     }
-    else
+
+    size_t searches = 0, writes = 0, ok = 0, errors = 0;
+    int failed = 0;
+    for(int i = 0; i < connections; i++)
     {
-        printf("No book found with this ID!\n");
+        pthread_join(threads[i], NULL);
+        searches += workers[i].searches;
+        writes   += workers[i].writes;
+        ok       += workers[i].ok;
+        errors   += workers[i].errors;
+        failed   |= workers[i].failed;
+    }
+    double elapsed = nowSeconds() - start;
+
+    // Merge the per-connection latencies
+    double *searchLatency = malloc((searches + 1) * sizeof(double));
+    double *writeLatency  = malloc((writes + 1) * sizeof(double));
+    size_t s = 0, wr = 0;
+    for(int i = 0; i < connections; i++)
+    {
+        memcpy(searchLatency + s, workers[i].searchLatency, workers[i].searches * sizeof(double));
+        memcpy(writeLatency + wr, workers[i].writeLatency, workers[i].writes * sizeof(double));
+        s  += workers[i].searches;
+        wr += workers[i].writes;
+        free(workers[i].searchLatency);
+        free(workers[i].writeLatency);
     }
+
+    printf("%zu requests (%zu ok, %zu errors) on %d connection(s), depth %zu, in %.3f s: %.0f requests/sec\n",
+           searches + writes, ok, errors, connections, depth, elapsed,
+           (searches + writes) / (elapsed > 0 ? elapsed : 1e-9));
+    printLatencies("search", searchLatency, searches);
+    printLatencies("write", writeLatency, writes);
+    if(failed)
+        printf("Some connections failed (is the server running on %s?)\n", socketPath);
+
+    free(searchLatency);
+    free(writeLatency);
+    free(workers);
+    free(threads);
+    return failed ? 1 : 0;
 }
 
+/*
+    -------------------------
+    BULK IMPORT
+    -------------------------
+*/
+
+/*
+    --import-books / --import-members ingest a CSV or TSV file in a single
+    pass over a read-only mapping:
+
+        books:   ID, title, author
+        members: TC ID, name, phone
+
+    The separator (tab, ';', ',' or '|') is detected from the first line,
+    fields may be double-quoted ("" inside quotes is a literal quote), and
+    a first line that does not start with a valid ID is taken as a header.
+    Extra columns are ignored. Each row is validated like an interactive add
+    (including duplicates against the ID index, which also catches duplicates
+    within the file); rejected rows are written to <file>.rejects with their
+    line number and reason. Accepted rows go straight into the tables and the
+    data files are written once at the end.
+*/
+
+#define IMPORT_MAX_FIELDS 8
+
 /**
- * Searches for a book by its ID and prints the details if found.
+ * Picks the field separator that occurs most often on the first line.
  */
-void searchBook()
+static char detectSeparator(const char *p, const char *end)
 {
-    Book books[MAX_BOOKS];
-    int count = loadBooks(books);
+    const char candidates[] = { '\t', ';', ',', '|' };
+    size_t counts[4] = {0};
 
-    int id;
-    printf("Enter the ID of the book to search: ");
-    scanf("%d", &id);
+    for(; p < end && *p != '\n'; p++)
+    {
+        for(int i = 0; i < 4; i++)
+        {
+            if(*p == candidates[i])
+                counts[i]++;
+        }
+    }
 
-    for(int i = 0; i < count; i++)
+    int best = 0;
+    for(int i = 1; i < 4; i++)
+    {
+        if(counts[i] > counts[best])
+            best = i;
+    }
+    return candidates[best];
+}
+
+/**
+ * Reads the next CSV/TSV record starting at *pos. Unquoted fields are
+ * copied into `buf` as NUL-terminated strings and pointed to by `fields`.
+ * Advances *pos past the record and *lineNo past the lines it spans.
+ * Returns the number of fields, or -1 if the record is longer than the
+ * buffer (the record is skipped).
+ */
+static int readDelimitedRecord(const char **pos, const char *end, char sep,
+                               char *buf, size_t bufSize, char *fields[], size_t *lineNo)
+{
+    const char *p = *pos;
+    size_t len = 0;
+    int n = 0, inQuotes = 0, overflow = 0;
+
+    fields[n++] = buf;
+    (*lineNo)++;
+
+    while(p < end)
     {
-        if(books[i].ID == id)
+        char c = *p++;
+        if(inQuotes)
         {
-            printf("\nBook Found:\n");
-            printf("ID     : %d\n", books[i].ID);
-            printf("Title  : %s\n", books[i].title);
-            printf("Author : %s\n", books[i].author);
-            printf("Status : %s\n", (books[i].status == 1) ? "Available" : "Borrowed");
-            return;
+            if(c == '"')
+            {
+                if(p < end && *p == '"')
+                    p++;          // Escaped quote
+                else
+                {
+                    inQuotes = 0;
+                    continue;
+                }
+            }
+            else if(c == '\n')
+            {
+                (*lineNo)++;
+            }
+        }
+        else if(c == '"')
+        {
+            inQuotes = 1;
+            continue;
+        }
+        else if(c == '\n')
+        {
+            break;
+        }
+        else if(c == '\r' && (p == end || *p == '\n'))
+        {
+            continue;
+        }
+        else if(c == sep)
+        {
+            c = '\0';
         }
+
+        if(len + 1 >= bufSize)
+        {
+            overflow = 1;
+            continue;
+        }
+        buf[len++] = c;
+        if(c == '\0' && n < IMPORT_MAX_FIELDS)
+            fields[n++] = &buf[len];
     }
 
-    printf("No book found with this ID!\n");
+    buf[len] = '\0';
+    *pos = p;
+    return overflow ? -1 : n;
 }
 
 /**
- * Lists all books, whether available or borrowed.
+ * Validates one imported book row and adds it to the store.
+ * Returns NULL on success or the reason for rejecting the row.
  */
-void listBooks()
+static const char *importBookRow(char *fields[], int n)
 {
-    Book books[MAX_BOOKS];
-    int count = loadBooks(books);
+    int id;
+    if(n < 3)
+        return "expected ID, title, author";
+    if(parseIntArg(fields[0], &id) != 0)
+        return "invalid book ID";
+    if(!isValidText(fields[1]))
+        return "title is empty, too long or contains '|'";
+    if(!isValidText(fields[2]))
+        return "author is empty, too long or contains '|'";
+    if(findBook(id) != NULL)
+        return "duplicate book ID";
 
-    if(count == 0)
+    // Appended without touching the text index; it is rebuilt once at the end
+    Book *book = appendBook(&library.books);
+    book->ID     = id;
+    book->title  = internText(&library.bookText, fields[1], strlen(fields[1]));
+    book->author = internText(&library.bookText, fields[2], strlen(fields[2]));
+    setBookStatus(book, 1);
+    indexInsert(&library.bookIndex, hashBookID(id), library.books.count - 1);
+    return NULL;
+}
+
+/**
+ * Validates one imported member row and adds it to the store.
+ * Returns NULL on success or the reason for rejecting the row.
+ */
+static const char *importMemberRow(char *fields[], int n)
+{
+    if(n < 3)
+        return "expected TC ID, name, phone";
+    uint64_t key = memberKey(fields[0]);
+    if(key == MEMBER_NONE)
+        return "invalid TC ID number";
+    if(!isValidText(fields[1]))
+        return "name is empty, too long or contains '|'";
+    if(!isValidText(fields[2]))
+        return "phone is empty, too long or contains '|'";
+    if(findMember(key) != NULL)
+        return "duplicate member ID";
+
+    Member member;
+    member.ID = key;
+    member.name  = internText(&library.memberText, fields[1], strlen(fields[1]));
+    member.phone = internText(&library.memberText, fields[2], strlen(fields[2]));
+    insertMember(&member);
+    return NULL;
+}
+
+/**
+ * Imports books (members == 0) or members (members == 1) from a CSV/TSV
+ * file and writes the data files once.
+ * Returns the process exit code.
+ */
+int importFile(const char *path, int members)
+{
+    size_t size = 0;
+    const char *data = mapFile(path, &size);
+    if(data == NULL)
     {
-        printf("No books registered.\n");
-        return;
+        printf("Cannot read %s!\n", path);
+        return 1;
     }
 
-    printf("\n--- All Books ---\n");
-    for(int i = 0; i < count; i++)
+    char rejectsPath[1024];
+    snprintf(rejectsPath, sizeof(rejectsPath), "%s.rejects", path);
+    FILE *rejects = NULL;
+
+    loadLibrary();
+    beginWrite(); // Other desks wait until the import is written
+    double start = nowSeconds();
+
+    const char *p   = data;
+    const char *end = data + size;
+    char sep = detectSeparator(p, end);
+    static char buf[IMPORT_RECORD_SIZE];
+    char *fields[IMPORT_MAX_FIELDS];
+    size_t lineNo = 0, imported = 0, rejected = 0;
+
+    while(p < end)
     {
-        printf("[%d] %s - %s (%s)\n",
-               books[i].ID,
-               books[i].title,
-               books[i].author,
-               books[i].status == 1 ? "Mevcut" : "Ödünçte");
+        const char *recordStart = p;
+        size_t recordLine = lineNo + 1;
+        int n = readDelimitedRecord(&p, end, sep, buf, sizeof(buf), fields, &lineNo);
+
+        if(n == 1 && fields[0][0] == '\0')
+            continue; // Blank line
+
+        // Skip a header line
+        if(recordLine == 1 && n > 0)
+        {
+            int id;
+            if(members ? !isValidMemberID(fields[0]) : parseIntArg(fields[0], &id) != 0)
+                continue;
+        }
+
+        const char *error = (n < 0) ? "record is too long"
+                          : members ? importMemberRow(fields, n)
+                                    : importBookRow(fields, n);
+        if(error == NULL)
+        {
+            imported++;
+            continue;
+        }
+
+        rejected++;
+        if(rejects == NULL && (rejects = fopen(rejectsPath, "w")) == NULL)
+        {
+            printf("Cannot write %s!\n", rejectsPath);
+            continue;
+        }
+        int recordLength = (int)(p - recordStart);
+        while(recordLength > 0 && (recordStart[recordLength - 1] == '\n' || recordStart[recordLength - 1] == '\r'))
+            recordLength--;
+        fprintf(rejects, "%zu\t%s\t%.*s\n", recordLine, error, recordLength, recordStart);
+    }
+    unmapFile((void *)data, size);
+
+    if(!members && imported > 0)
+    {
+        buildTextIndex();
+        buildSortedViews();
+    }
+
+    // Write the result once
+    if(imported > 0)
+        compactLocked();
+    endWrite();
+
+    printf("Imported %zu %s, rejected %zu in %.3f s.\n",
+           imported, members ? "members" : "books", rejected, nowSeconds() - start);
+    if(rejects != NULL)
+    {
+        fclose(rejects);
+        printf("Rejected rows were written to %s\n", rejectsPath);
     }
+
+    freeLibrary();
+    return 0;
 }
 
+/*
+    -------------------------
+    BENCHMARKS
+    -------------------------
+*/
+
 /**
- * Lists only the books that are currently available (status == 1).
+ * The original fscanf-based books.txt loader, kept as the baseline for
+ * benchParse.
  */
-void listAvailableBooks()
+static size_t loadBooksScanf(const char *path, BookTable *table)
 {
-    Book books[MAX_BOOKS];
-    int count = loadBooks(books);
-    int found = 0;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+        return 0;
 
-    printf("\n--- Mevcut Kitaplar ---\n");
-    for(int i = 0; i < count; i++)
+    size_t count = 0;
+    while(!feof(fp))
     {
-        if(books[i].status == 1)
+        Book temp;
+        char title[100], author[100];
+        if(fscanf(fp, "%d|%99[^|]|%99[^|]|%d\n", &temp.ID, title, author, &temp.status) == 4)
+        {
+            temp.title  = internText(&library.bookText, title, strlen(title));
+            temp.author = internText(&library.bookText, author, strlen(author));
+            *appendBook(table) = temp;
+            count++;
+        }
+        else
         {
-            printf("[%d] %s - %s\n", books[i].ID, books[i].title, books[i].author);
-            found = 1;
+            int c;
+            while((c = fgetc(fp)) != '\n' && c != EOF) { }
         }
     }
 
-    if(!found)
+    fclose(fp);
+    return count;
+}
+
+/**
+ * Times the fscanf loader against the streaming parser on a books file and
+ * prints the throughput of each in lines per second.
+ * Returns the process exit code.
+ */
+int benchParse(const char *path)
+{
+    BookTable table = {0};
+
+    double start = nowSeconds();
+    size_t scanfCount = loadBooksScanf(path, &table);
+    double scanfTime = nowSeconds() - start;
+
+    table.count = 0;
+    freeArena(&library.bookText);
+    start = nowSeconds();
+    size_t streamCount = parseDataFile(path, 4, parseBookFields, &table);
+    double streamTime = nowSeconds() - start;
+
+    free(table.items);
+    freeArena(&library.bookText);
+
+    if(scanfCount == 0 && streamCount == 0)
     {
-        printf("No books are currently available.\n");
+        printf("No books could be read from %s!\n", path);
+        return 1;
     }
+
+    printf("fscanf parser : %zu lines in %.3f s (%.0f lines/sec)\n",
+           scanfCount, scanfTime, scanfCount / (scanfTime > 0 ? scanfTime : 1e-9));
+    printf("stream parser : %zu lines in %.3f s (%.0f lines/sec)\n",
+           streamCount, streamTime, streamCount / (streamTime > 0 ? streamTime : 1e-9));
+    if(streamTime > 0)
+        printf("speedup       : %.1fx\n", scanfTime / streamTime);
+    return 0;
 }
 
+/*
+    Generated data sets: members get valid TC ID numbers (generateMemberID),
+    books get titles and authors made of Turkish words (UTF-8), and the
+    borrow history is a consistent mix of returned loans spread over the
+    years and open loans around GENERATE_TODAY, about half of them overdue.
+    The same seed always gives the same files.
+*/
+
+#define GENERATE_TODAY   "01/06/2024"
+#define GENERATE_FROM    "01/01/2015" // First day of the generated borrow history
+#define BENCH_DIR        "bench.tmp"
+#define BENCH_MAX_OPS    10000        // Operations timed per single-record operation
+#define BENCH_DURABLE_OPS 500         // Borrow/return pairs timed with an fsync each
+
+static const char *const titleWords[] = {
+    "Aşk", "Savaş", "Barış", "Deniz", "Gece", "Gündüz", "Yol", "Işık",
+    "Hayat", "Zaman", "Ev", "Kış", "Yaz", "Bahar", "Güz", "Çocuk",
+    "Şiir", "Roman", "Tarih", "Dünya", "İstanbul", "Anadolu", "Kuyu", "Dağ",
+    "Öykü", "Sessiz", "Kırmızı", "Beyaz", "Kara", "Yeşil", "Gök", "Yıldız",
+    "Ay", "Güneş", "Rüzgâr", "Ağaç", "Çiçek", "Bülbül", "Şehir", "Köy",
+    "Kadın", "Adam", "Kalp", "Sır", "Düş", "Umut", "Yalnızlık", "Özgürlük",
+    "Sevda", "Hüzün", "Kitap", "Mektup", "Saat", "Ayna", "Kapı", "Pencere",
+    "Sokak", "Çarşı", "Değirmen", "Göç", "İnce", "Uzun", "Şafak", "Ölüm"
+};
+
+static const char *const firstNames[] = {
+    "Ahmet", "Ayşe", "Mehmet", "Fatma", "Mustafa", "Emine", "Ali", "Hatice",
+    "Hüseyin", "Zeynep", "İbrahim", "Elif", "Ömer", "Şule", "Gökhan", "Çiğdem"
+};
+
+static const char *const lastNames[] = {
+    "Yılmaz", "Kaya", "Demir", "Şahin", "Çelik", "Yıldız", "Yıldırım", "Öztürk",
+    "Aydın", "Özdemir", "Arslan", "Doğan", "Kılıç", "Aslan", "Çetin", "Koç"
+};
+
+#define COUNT_OF(array) (sizeof(array) / sizeof((array)[0]))
+
 /**
- * Lists only the books that are currently borrowed (status == 0).
+ * Returns word n (mod the vocabulary size) of the generated titles.
  */
-void listBorrowedBooks()
+const char *sampleWord(unsigned n)
+{
+    return titleWords[n % COUNT_OF(titleWords)];
+}
+
+/**
+ * Writes the TC ID number of generated member n: nine digits from n and
+ * the two check digits, so the number passes the official checksum.
+ */
+void generateMemberID(unsigned n, char id[12])
 {
-    Book books[MAX_BOOKS];
-    int count = loadBooks(books);
-    int found = 0;
+    int d[11], odd = 0, even = 0, sum = 0;
+    snprintf(id, 12, "%09u", 100000000u + n % 900000000u);
+    for(int i = 0; i < 9; i++)
+    {
+        d[i] = id[i] - '0';
+        if(i % 2 == 0)
+            odd += d[i];
+        else
+            even += d[i];
+    }
+    d[9] = ((odd * 7 - even) % 10 + 10) % 10;
+    for(int i = 0; i < 10; i++)
+        sum += d[i];
+    d[10] = sum % 10;
 
-    printf("\n--- Ödünçteki Kitaplar ---\n");
-    for(int i = 0; i < count; i++)
+    id[9]  = (char)('0' + d[9]);
+    id[10] = (char)('0' + d[10]);
+    id[11] = '\0';
+}
+
+/**
+ * Writes a generated library to the text data files of the current
+ * directory: `books` books, `members` members and `borrows` borrow records,
+ * of which up to a tenth are open loans. Existing data files are never
+ * overwritten. Returns 0 on success.
+ */
+int generateLibrary(size_t books, size_t members, size_t borrows, unsigned seed)
+{
+    if(books < 1 || members < 1 || books > INT32_MAX || members > 900000000)
+    {
+        printf("Invalid generator sizes!\n");
+        return -1;
+    }
+    if(fileExists(BOOKS_FILE) || fileExists(MEMBERS_FILE) || fileExists(BORROWS_FILE))
+    {
+        printf("Data files already exist here; generate into an empty directory!\n");
+        return -1;
+    }
+
+    // Open loans go to every tenth book, at most two per member
+    size_t open = borrows / 10;
+    if(open > books / 10)
+        open = books / 10;
+    if(open > members * 2)
+        open = members * 2;
+    size_t history = borrows - open;
+
+    FILE *fp[3] = { fopen(BOOKS_FILE, "w"), fopen(MEMBERS_FILE, "w"), fopen(BORROWS_FILE, "w") };
+    for(int i = 0; i < 3; i++)
     {
-        if(books[i].status == 0)
+        if(fp[i] == NULL)
         {
-            printf("[%d] %s - %s\n", books[i].ID, books[i].title, books[i].author);
-            found = 1;
+            printf("Failed to create the data files!\n");
+            for(int j = 0; j < 3; j++)
+                if(fp[j] != NULL)
+                    fclose(fp[j]);
+            return -1;
         }
+        setvbuf(fp[i], NULL, _IOFBF, BATCH_OUTPUT_BUFFER);
     }
 
-    if(!found)
+    for(size_t id = 1; id <= books; id++)
     {
-        printf("No books are currently borrowed.\n");
+        char title[100];
+        int length = snprintf(title, sizeof(title), "%s", sampleWord(rand_r(&seed)));
+        for(int words = 1 + (int)(rand_r(&seed) % 4); words > 0; words--)
+            length += snprintf(title + length, sizeof(title) - (size_t)length, " %s", sampleWord(rand_r(&seed)));
+        fprintf(fp[0], "%zu|%s|%s %s|%d\n", id, title,
+                firstNames[rand_r(&seed) % COUNT_OF(firstNames)],
+                lastNames[rand_r(&seed) % COUNT_OF(lastNames)],
+                (id % 10 == 0 && id / 10 <= open) ? 0 : 1);
+    }
+
+    for(size_t n = 0; n < members; n++)
+    {
+        char id[12];
+        generateMemberID((unsigned)n, id);
+        fprintf(fp[1], "%s|%s %s|05%09u\n", id,
+                firstNames[rand_r(&seed) % COUNT_OF(firstNames)],
+                lastNames[rand_r(&seed) % COUNT_OF(lastNames)],
+                rand_r(&seed) % 1000000000u);
+    }
+
+    int32_t today, from;
+    parseDate(GENERATE_TODAY, &today);
+    parseDate(GENERATE_FROM, &from);
+    int32_t span = today - 60 - from;
+    for(size_t i = 0; i < history + open; i++)
+    {
+        char id[12], borrowDate[11], returnDate[11];
+        int bookID;
+        int32_t borrowDay, returnDay;
+        if(i < history)
+        {
+            // Returned loans in date order, as the desks would have recorded them
+            bookID    = 1 + (int)(rand_r(&seed) % books);
+            borrowDay = from + (int32_t)((double)i * span / (history ? history : 1));
+            returnDay = borrowDay + 1 + (int32_t)(rand_r(&seed) % 30);
+            generateMemberID(rand_r(&seed) % (unsigned)members, id);
+        }
+        else
+        {
+            size_t k  = i - history;
+            bookID    = (int)((k + 1) * 10);
+            borrowDay = today - (int32_t)(rand_r(&seed) % (2 * LOAN_PERIOD_DAYS));
+            returnDay = DATE_OPEN;
+            generateMemberID((unsigned)(k % members), id);
+        }
+        formatDate(borrowDay, borrowDate);
+        formatDate(returnDay, returnDate);
+        fprintf(fp[2], "%d|%s|%s|%s\n", bookID, id, borrowDate, returnDate);
+    }
+
+    int failed = 0;
+    for(int i = 0; i < 3; i++)
+        failed |= (fclose(fp[i]) != 0);
+    if(failed)
+    {
+        printf("Failed to write the data files!\n");
+        return -1;
     }
+    return 0;
+}
+
+/**
+ * Deletes the data files of the current directory (a scratch directory).
+ */
+static void removeDataFiles()
+{
+    const char *files[] = { BOOKS_FILE, MEMBERS_FILE, BORROWS_FILE, LOG_FILE, LOCK_FILE, STATS_FILE,
+                            BOOKS_BIN_FILE, MEMBERS_BIN_FILE, BORROWS_BIN_FILE, SNAPSHOT_FILE };
+    for(size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+        remove(files[i]);
+    removeTempFiles();
+}
+
+/**
+ * Sends stdout to /dev/null while a listing is timed.
+ * Returns the saved stdout descriptor for unmuteStdout.
+ */
+static int muteStdout()
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if(null >= 0)
+    {
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    return saved;
+}
+
+static void unmuteStdout(int saved)
+{
+    fflush(stdout);
+    if(saved >= 0)
+    {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+/**
+ * Prints one benchmark result as a JSON object.
+ */
+static void benchResult(FILE *json, int *first, const char *op, size_t count, double seconds)
+{
+    fprintf(json, "%s\n        {\"op\": \"%s\", \"count\": %zu, \"seconds\": %.6f, \"opsPerSec\": %.0f}",
+            *first ? "" : ",", op, count, seconds, count / (seconds > 0 ? seconds : 1e-9));
+    *first = 0;
+    fprintf(stderr, "  %-18s %10zu in %9.6f s\n", op, count, seconds);
 }
 
 /*
-    -------------------------
-    MEMBER OPERATIONS
-    -------------------------
+    The book and member layouts before the string arena, with the text in
+    fixed-size arrays; the memory benchmark compares against them.
 */
 
+typedef struct {
+    int  ID;
+    char title[100];
+    char author[100];
+    int  status;
+} FixedBook;
+
+typedef struct {
+    char ID[12];
+    char name[50];
+    char phone[20];
+} FixedMember;
+
+typedef struct {
+    size_t books, bookTable, bookText, bookIndex, fixedBooks;
+    size_t members, memberTable, memberText, memberIndex, fixedMembers;
+} BenchMemory;
+
 /**
- * Reads members from the file into the members array.
- * Returns the number of members read.
+ * Measures the bytes the loaded book and member records take: the record
+ * tables, the string arenas and their intern indexes, next to what the
+ * same records took in the fixed-size layout. Also printed to stderr.
  */
-int loadMembers(Member members[])
+static void measureMemory(BenchMemory *m)
 {
-    FILE *fp = fopen(MEMBERS_FILE, "r");
-    if (fp == NULL)
-        return 0; // If file doesn't exist, return 0
+    m->books       = library.books.count;
+    m->bookTable   = library.books.count * sizeof(Book);
+    m->bookText    = library.bookText.length;
+    m->bookIndex   = library.bookText.lookup.capacity * sizeof(IndexSlot);
+    m->fixedBooks  = library.books.count * sizeof(FixedBook);
+    m->members     = library.members.count;
+    m->memberTable = library.members.count * sizeof(Member);
+    m->memberText  = library.memberText.length;
+    m->memberIndex = library.memberText.lookup.capacity * sizeof(IndexSlot);
+    m->fixedMembers = library.members.count * sizeof(FixedMember);
 
-    int count = 0;
-    while(!feof(fp) && count < MAX_MEMBERS)
-    {
-        /*
-            File line format:
-            ID|name|phone
-        */
-        Member temp;
-        if(fscanf(fp, "%[^|]|%[^|]|%[^\n]\n", temp.ID, temp.name, temp.phone) == 3)
-        {
-            members[count++] = temp;
-        }
-    }
-    fclose(fp);
-    return count;
+    size_t books   = m->bookTable + m->bookText + m->bookIndex;
+    size_t members = m->memberTable + m->memberText + m->memberIndex;
+    fprintf(stderr, "  %-18s %10zu bytes (%.1f per book, fixed layout %zu)\n", "bookMemory",
+            books, m->books ? (double)books / m->books : 0.0, sizeof(FixedBook));
+    fprintf(stderr, "  %-18s %10zu bytes (%.1f per member, fixed layout %zu)\n", "memberMemory",
+            members, m->members ? (double)members / m->members : 0.0, sizeof(FixedMember));
 }
 
 /**
- * Writes the member data from the array to the file.
+ * Times every operation on a generated library of `records` books and
+ * prints the results to `json`. Runs in the scratch directory.
  */
-void saveMembers(const Member members[], int count)
+static void benchScale(FILE *json, size_t records)
 {
-    FILE *fp = fopen(MEMBERS_FILE, "w");
-    if (fp == NULL)
+    size_t members = records / 10 + 1, borrows = records;
+    size_t ops = records < BENCH_MAX_OPS ? records : BENCH_MAX_OPS;
+    int first = 1;
+    double start;
+
+    fprintf(stderr, "%zu books, %zu members, %zu borrow records\n", records, members, borrows);
+    fprintf(json, "    {\"books\": %zu, \"members\": %zu, \"borrows\": %zu, \"results\": [",
+            records, members, borrows);
+
+    removeDataFiles();
+    start = nowSeconds();
+    generateLibrary(records, members, borrows, 1);
+    benchResult(json, &first, "generate", records + members + borrows, nowSeconds() - start);
+
+    // Parsing alone, then the whole load with the indexes
+    BookTable bookTable = {0};
+    MemberTable memberTable = {0};
+    BorrowTable borrowTable = {0};
+    start = nowSeconds();
+    size_t n = loadBooks(&bookTable);
+    benchResult(json, &first, "loadBooks", n, nowSeconds() - start);
+    start = nowSeconds();
+    n = loadMembers(&memberTable);
+    benchResult(json, &first, "loadMembers", n, nowSeconds() - start);
+    start = nowSeconds();
+    n = loadBorrows(&borrowTable);
+    benchResult(json, &first, "loadBorrows", n, nowSeconds() - start);
+    free(bookTable.items);
+    free(memberTable.items);
+    free(borrowTable.items);
+    freeArena(&library.bookText);
+    freeArena(&library.memberText);
+
+    start = nowSeconds();
+    loadLibrary();
+    benchResult(json, &first, "loadLibrary", library.books.count + library.members.count + library.borrows.count,
+                nowSeconds() - start);
+    BenchMemory memory;
+    measureMemory(&memory);
+
+    start = nowSeconds();
+    saveBooks(&library.books);
+    benchResult(json, &first, "saveBooks", library.books.count, nowSeconds() - start);
+    start = nowSeconds();
+    saveMembers(&library.members);
+    benchResult(json, &first, "saveMembers", library.members.count, nowSeconds() - start);
+    start = nowSeconds();
+    saveBorrows(&library.borrows);
+    benchResult(json, &first, "saveBorrows", library.borrows.count, nowSeconds() - start);
+
+    // Collation keys for every title, author and name, sorted into the views
+    start = nowSeconds();
+    buildSortedViews();
+    for(int i = 0; i < SORTED_VIEWS; i++)
+        sortedView(i);
+    benchResult(json, &first, "sortViews", 2 * library.books.count + library.members.count, nowSeconds() - start);
+
+    // Single-record operations on books and members the generator did not use,
+    // committed together afterwards as a batch would
+    library.deferCommit = 1;
+    unsigned seed = 2;
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
     {
-        printf("Failed to open file for saving members!\n");
-        return;
+        char title[100];
+        snprintf(title, sizeof(title), "%s %s", sampleWord(rand_r(&seed)), sampleWord(rand_r(&seed)));
+        libAddBook((int)(records + 1 + i), title, "Yazar");
     }
+    benchResult(json, &first, "addBook", ops, nowSeconds() - start);
 
-    for(int i = 0; i < count; i++)
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
     {
-        fprintf(fp, "%s|%s|%s\n",
-                members[i].ID,
-                members[i].name,
-                members[i].phone);
+        char id[12];
+        generateMemberID((unsigned)(members + i), id);
+        libAddMember(id, "Üye", "05000000000");
     }
+    benchResult(json, &first, "addMember", ops, nowSeconds() - start);
 
-    fclose(fp);
-}
+    start = nowSeconds();
+    size_t hits = 0;
+    for(size_t i = 0; i < ops; i++)
+    {
+        IdList ids = {0};
+        searchText(sampleWord(rand_r(&seed)), &ids);
+        hits += ids.count;
+        freeIdList(&ids);
+    }
+    benchResult(json, &first, "searchText", ops, nowSeconds() - start);
 
-/**
- * Adds a new member to the system.
- */
-void addMember()
-{
-    Member members[MAX_MEMBERS];
-    int count = loadMembers(members);
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
+        hits += (findBook(1 + (int)(rand_r(&seed) % records)) != NULL);
+    benchResult(json, &first, "findBook", ops, nowSeconds() - start);
 
-    if(count >= MAX_MEMBERS)
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
     {
-        printf("Maximum number of members reached!\n");
-        return;
+        char id[12];
+        generateMemberID(rand_r(&seed) % (unsigned)members, id);
+        hits += (findMember(memberKey(id)) != NULL);
     }
+    benchResult(json, &first, "findMember", ops, nowSeconds() - start);
 
-    Member newMember;
-    printf("Enter Member TC ID Number (11 digits): ");
-    fgets(newMember.ID, sizeof(newMember.ID), stdin);
-    newMember.ID[strcspn(newMember.ID, "\n")] = '\0';
+    // Borrow-to-member join: the member of every borrow record
+    start = nowSeconds();
+    for(size_t i = 0; i < library.borrows.count; i++)
+        hits += (findMember(library.borrows.items[i].memberID) != NULL);
+    benchResult(json, &first, "joinBorrowMembers", library.borrows.count, nowSeconds() - start);
 
-    // Validate ID
-    if(!isValidMemberID(newMember.ID))
+    // Member-to-loans join: the loan list of every member
+    start = nowSeconds();
+    for(size_t i = 0; i < library.members.count; i++)
+        hits += (findMemberLoans(library.members.items[i].ID) != NULL);
+    benchResult(json, &first, "joinMemberLoans", library.members.count, nowSeconds() - start);
+
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
     {
-        printf("Invalid ID number!\n");
-        return;
+        char id[12];
+        generateMemberID((unsigned)(members + i), id);
+        libBorrowBook((int)(records + 1 + i), id, GENERATE_TODAY);
     }
+    benchResult(json, &first, "borrowBook", ops, nowSeconds() - start);
 
-    // Check for duplicate ID
-    for(int i = 0; i < count; i++)
+    // Listings and reports, with their output discarded
+    int32_t today;
+    parseDate(GENERATE_TODAY, &today);
+    int saved = muteStdout();
+    double times[12];
+    ListCursor cursor;
+    listInit(&cursor, LIST_BOOKS);
+    start = nowSeconds();
+    printBookList(&cursor);
+    times[0] = nowSeconds() - start;
+    start = nowSeconds();
+    listAvailableBooks();
+    times[1] = nowSeconds() - start;
+    start = nowSeconds();
+    listBorrowedBooks();
+    times[2] = nowSeconds() - start;
+    start = nowSeconds();
+    listMembers();
+    times[3] = nowSeconds() - start;
+    start = nowSeconds();
+    printBorrowHistory(INT32_MIN, INT32_MAX);
+    times[4] = nowSeconds() - start;
+    start = nowSeconds();
+    listOpenLoans();
+    times[5] = nowSeconds() - start;
+    start = nowSeconds();
+    size_t overdue = openLoanDateBound(today - LOAN_PERIOD_DAYS);
+    printLoansByDate(0, overdue, today, LOAN_PERIOD_DAYS);
+    times[6] = nowSeconds() - start;
+    start = nowSeconds();
+    size_t dueFrom = openLoanDateBound(today - LOAN_PERIOD_DAYS);
+    size_t dueTo   = openLoanDateBound(today - LOAN_PERIOD_DAYS + 4);
+    printLoansByDate(dueFrom, dueTo, today, LOAN_PERIOD_DAYS);
+    times[7] = nowSeconds() - start;
+
+    // One page of available books from 100 places in the catalog, then
+    // every book streamed out as books.txt lines
+    size_t pages = 100, paged = 0;
+    start = nowSeconds();
+    for(size_t i = 0; i < pages; i++)
     {
-        if(strcmp(members[i].ID, newMember.ID) == 0)
+        listInit(&cursor, LIST_BOOKS);
+        cursor.status   = 1;
+        cursor.position = library.books.count * i / pages;
+        for(size_t n = 0; n < LIST_PAGE_LIMIT; n++)
         {
-            printf("A member with this ID already exists!\n");
-            return;
+            size_t row = listNext(&cursor);
+            if(row == INDEX_NOT_FOUND)
+                break;
+            writeListed(stdout, &cursor, row);
+            putchar('\n');
+            paged++;
         }
     }
+    times[8] = nowSeconds() - start;
+    listInit(&cursor, LIST_BOOKS);
+    start = nowSeconds();
+    for(size_t row = listNext(&cursor); row != INDEX_NOT_FOUND; row = listNext(&cursor))
+    {
+        writeListed(stdout, &cursor, row);
+        putchar('\n');
+    }
+    fflush(stdout);
+    times[9] = nowSeconds() - start;
 
-    printf("Member Name: ");
-    fgets(newMember.name, sizeof(newMember.name), stdin);
-    newMember.name[strcspn(newMember.name, "\n")] = '\0';
+    // One page by title from 100 places in the view, then the authors
+    // starting with "ş" (the view is merged before timing)
+    sortedView(VIEW_TITLES);
+    sortedView(VIEW_AUTHORS);
+    size_t sortedPaged = 0, inRange = 0;
+    start = nowSeconds();
+    for(size_t i = 0; i < pages; i++)
+    {
+        listInit(&cursor, LIST_BOOKS);
+        cursor.view     = VIEW_TITLES;
+        cursor.position = library.books.count * i / pages;
+        for(size_t n = 0; n < LIST_PAGE_LIMIT; n++)
+        {
+            size_t row = listNext(&cursor);
+            if(row == INDEX_NOT_FOUND)
+                break;
+            writeListed(stdout, &cursor, row);
+            putchar('\n');
+            sortedPaged++;
+        }
+    }
+    times[10] = nowSeconds() - start;
+    listInit(&cursor, LIST_BOOKS);
+    cursor.view = VIEW_AUTHORS;
+    collationKey("ş", cursor.prefix, sizeof(cursor.prefix));
+    start = nowSeconds();
+    for(size_t row = listNext(&cursor); row != INDEX_NOT_FOUND; row = listNext(&cursor))
+        inRange++;
+    times[11] = nowSeconds() - start;
+    fflush(stdout);
+    unmuteStdout(saved);
 
-    printf("Member Phone Number: ");
-    fgets(newMember.phone, sizeof(newMember.phone), stdin);
-    newMember.phone[strcspn(newMember.phone, "\n")] = '\0';
+    benchResult(json, &first, "listBooks", library.books.count, times[0]);
+    benchResult(json, &first, "listAvailableBooks", library.books.count, times[1]);
+    benchResult(json, &first, "listBorrowedBooks", library.books.count, times[2]);
+    benchResult(json, &first, "listMembers", library.members.count, times[3]);
+    benchResult(json, &first, "listBorrows", library.borrows.count, times[4]);
+    benchResult(json, &first, "listOpenLoans", library.openLoans.count, times[5]);
+    benchResult(json, &first, "listOverdueLoans", overdue, times[6]);
+    benchResult(json, &first, "listDueSoonLoans", dueTo - dueFrom, times[7]);
+    benchResult(json, &first, "listPage", paged, times[8]);
+    benchResult(json, &first, "exportBooks", library.books.count, times[9]);
+    benchResult(json, &first, "listSortedPage", sortedPaged, times[10]);
+    benchResult(json, &first, "authorPrefixRange", inRange, times[11]);
 
-    // Add to the end of the array
-    members[count++] = newMember;
+    // Analytics over the whole history on one thread, then on the default count
+    LoanReport report;
+    start = nowSeconds();
+    runAnalytics(INT32_MIN, INT32_MAX, 1, ANALYTICS_TOP, &report);
+    benchResult(json, &first, "analyticsSerial", (size_t)report.loans, nowSeconds() - start);
+    freeLoanReport(&report);
+    start = nowSeconds();
+    runAnalytics(INT32_MIN, INT32_MAX, 0, ANALYTICS_TOP, &report);
+    benchResult(json, &first, "analyticsParallel", (size_t)report.loans, nowSeconds() - start);
+    freeLoanReport(&report);
 
-    saveMembers(members, count);
-    printf("Member added successfully!\n");
-}
+    // The borrowed rows alone, without printing: one bitset word per 64 books
+    start = nowSeconds();
+    size_t borrowed = 0;
+    for(size_t i = nextBookRow(0, 0); i < library.books.count; i = nextBookRow(i + 1, 0))
+        borrowed++;
+    benchResult(json, &first, "scanBorrowedRows", library.books.count, nowSeconds() - start);
+    if(borrowed != library.books.count - countAvailable())
+        printf("Availability bitset disagrees with its count!\n");
 
-/**
- * Searches for a member by their 11-digit ID and prints the details if found.
- */
-void searchMember()
-{
-    Member members[MAX_MEMBERS];
-    int count = loadMembers(members);
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
+        libReturnBook((int)(records + 1 + i), GENERATE_TODAY);
+    benchResult(json, &first, "returnBook", ops, nowSeconds() - start);
 
-    char id[12];
-    printf("Enter the TC ID Number (11 digits) of the member to search: ");
-    fgets(id, sizeof(id), stdin);
-    id[strcspn(id, "\n")] = '\0';
+    start = nowSeconds();
+    for(size_t i = 0; i < ops; i++)
+        libDeleteBook((int)(records + 1 + i));
+    benchResult(json, &first, "deleteBook", ops, nowSeconds() - start);
 
-    for(int i = 0; i < count; i++)
+    start = nowSeconds();
+    commitLog();
+    benchResult(json, &first, "commitLog", 1, nowSeconds() - start);
+    library.deferCommit = 0;
+
+    // Borrow and return one at a time, each waiting for its fsync
+    size_t durable = ops < BENCH_DURABLE_OPS ? ops : BENCH_DURABLE_OPS;
+    start = nowSeconds();
+    for(size_t i = 0; i < durable; i++)
     {
-        if(strcmp(members[i].ID, id) == 0)
-        {
-            printf("\nMember Found:\n");
-            printf("TC ID No : %s\n", members[i].ID);
-            printf("Name     : %s\n", members[i].name);
-            printf("Phone    : %s\n", members[i].phone);
-            return;
-        }
+        char id[12];
+        generateMemberID((unsigned)(members + i), id);
+        int bookID = (int)(i * 10 + 2); // Never on loan in generated data
+        libBorrowBook(bookID, id, GENERATE_TODAY);
+        libReturnBook(bookID, GENERATE_TODAY);
     }
-    printf("No member found with this ID!\n");
+    benchResult(json, &first, "durableBorrowReturn", 2 * durable, nowSeconds() - start);
+
+    size_t logged = library.logEntries;
+    start = nowSeconds();
+    compactLibrary();
+    benchResult(json, &first, "compact", logged, nowSeconds() - start);
+
+    size_t stored = library.books.count + library.members.count + library.borrows.count;
+    start = nowSeconds();
+    checkpointLibrary();
+    benchResult(json, &first, "checkpoint", stored, nowSeconds() - start);
+
+    start = nowSeconds();
+    freeLibrary();
+    benchResult(json, &first, "freeLibrary", records, nowSeconds() - start);
+
+    // A restart: the snapshot instead of parsing and indexing the data files
+    start = nowSeconds();
+    loadLibrary();
+    benchResult(json, &first, "loadSnapshot", stored, nowSeconds() - start);
+    freeLibrary();
+
+    fprintf(json, "\n    ], \"memory\": {\"bookRecords\": %zu, \"bookTable\": %zu, \"bookText\": %zu, "
+                  "\"bookTextIndex\": %zu, \"fixedBookTable\": %zu, \"memberRecords\": %zu, "
+                  "\"memberTable\": %zu, \"memberText\": %zu, \"memberTextIndex\": %zu, "
+                  "\"fixedMemberTable\": %zu}}",
+            memory.books, memory.bookTable, memory.bookText, memory.bookIndex, memory.fixedBooks,
+            memory.members, memory.memberTable, memory.memberText, memory.memberIndex, memory.fixedMembers);
+    if(hits == 0)
+        fprintf(stderr, "  (no lookups matched)\n");
 }
 
 /**
- * Lists all registered members.
+ * Runs the benchmark suite: for each record count given (by default 1000,
+ * 10000 and 100000 books) it generates a library in BENCH_DIR and times
+ * loading, saving, every operation and every listing. The results go to
+ * stdout as JSON, progress to stderr. Returns the process exit code.
  */
-void listMembers()
+int runBenchmarks(int argc, char *argv[])
 {
-    Member members[MAX_MEMBERS];
-    int count = loadMembers(members);
+    size_t defaults[] = { 1000, 10000, 100000 };
+    size_t scales[16], scaleCount = 0;
+    for(int i = 0; i < argc && scaleCount < 16; i++)
+    {
+        char *end;
+        unsigned long long n = strtoull(argv[i], &end, 10);
+        if(*end != '\0' || n < 10 || n > 10000000)
+        {
+            fprintf(stderr, "Record counts must be between 10 and 10000000!\n");
+            return 1;
+        }
+        scales[scaleCount++] = (size_t)n;
+    }
+    if(scaleCount == 0)
+    {
+        memcpy(scales, defaults, sizeof(defaults));
+        scaleCount = COUNT_OF(defaults);
+    }
 
-    if(count == 0)
+    mkdir(BENCH_DIR, 0755);
+    if(chdir(BENCH_DIR) != 0)
     {
-        printf("No members registered.\n");
-        return;
+        fprintf(stderr, "Cannot enter %s!\n", BENCH_DIR);
+        return 1;
     }
 
-    printf("\n--- All Members ---\n");
-    for(int i = 0; i < count; i++)
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    printf("{\n  \"benchmark\": \"library\",\n  \"time\": \"%s\",\n  \"binaryFormatVersion\": %d,\n  \"runs\": [\n",
+           stamp, BINARY_FORMAT_VERSION);
+    for(size_t i = 0; i < scaleCount; i++)
     {
-        printf("[%s] %s - %s\n",
-               members[i].ID,
-               members[i].name,
-               members[i].phone);
+        benchScale(stdout, scales[i]);
+        printf("%s\n", i + 1 < scaleCount ? "," : "");
     }
+    printf("  ]\n}\n");
+
+    removeDataFiles();
+    if(chdir("..") == 0)
+        rmdir(BENCH_DIR);
+    return 0;
 }
 
 /*
     -------------------------
-    BORROW OPERATIONS
+    STRESS TEST
     -------------------------
 */
 
+/*
+    --stress [threads] checks the locking described in CONCURRENCY on a
+    generated library in a scratch directory (STRESS_DIR), so the real data
+    files are never touched:
+
+    1. Read scaling: 1, 2, 4, ... up to `threads` reader threads search and
+       look up books for STRESS_SECONDS each; throughput and speedup over
+       one thread are printed.
+    2. Threads: half of the threads borrow and return random books while
+       the rest keep reading. Every successful operation must be accounted
+       for in the store, no reader may see a book whose status disagrees
+       with its open loan, and reloading from disk must give the same state.
+    3. Desks: STRESS_DESKS processes borrow and return books on the same
+       files at once, compacting the log meanwhile. Afterwards the files
+       must hold every operation the processes reported as successful.
+*/
+
+#define STRESS_DIR      "stress.tmp"
+#define STRESS_BOOKS    20000
+#define STRESS_MEMBERS  2000
+#define STRESS_WORDS    1000
+#define STRESS_SECONDS  1.0
+#define STRESS_WRITES   20000 // Borrow/return attempts per writer thread
+#define STRESS_DESKS    4
+#define STRESS_DESK_OPS 3000  // Borrow/return attempts per desk process
+
 /**
- * Reads borrow data from the file into the borrows array.
- * Returns the number of borrow records read.
+ * One reader step: a word search plus a lookup whose parts must agree,
+ * and a few books in title order and open loans in date order that must
+ * be in order.
  */
-int loadBorrows(Borrow borrows[])
+static void stressRead(StressWorker *w)
 {
-    FILE *fp = fopen(BORROWS_FILE, "r");
-    if (fp == NULL)
-        return 0; // If file doesn't exist, return 0
+    char query[16], title[32];
+    snprintf(query, sizeof(query), "söz%u", rand_r(&w->seed) % STRESS_WORDS);
+    snprintf(title, sizeof(title), "kitap söz%u", rand_r(&w->seed) % 10);
+    int id = 1 + (int)(rand_r(&w->seed) % STRESS_BOOKS);
 
-    int count = 0;
-    while(!feof(fp) && count < MAX_BORROWS)
+    beginRead();
+    IdList ids = {0};
+    searchText(query, &ids);
+    const Book *book = findBook(id);
+    if(book != NULL)
     {
-        /*
-            File line format:
-            bookID|memberID|borrowDate|returnDate
-        */
-        Borrow temp;
-        if(fscanf(fp, "%d|%[^|]|%[^|]|%[^\n]\n",
-                  &temp.bookID,
-                  temp.memberID,
-                  temp.borrowDate,
-                  temp.returnDate) == 4)
-        {
-            borrows[count++] = temp;
-        }
+        size_t row = (size_t)(book - library.books.items);
+        int bit = (library.availability.words[row / 64] >> (row % 64)) & 1;
+        if((book->status == 0) != (findOpenBorrow(id) != NULL) || bit != (book->status == 1))
+            w->inconsistent++;
     }
 
-    fclose(fp);
-    return count;
+    ListCursor cursor;
+    listInit(&cursor, LIST_BOOKS);
+    cursor.view = VIEW_TITLES;
+    collationKey(title, cursor.prefix, sizeof(cursor.prefix));
+    char last[MAX_TOKEN_BYTES] = "", key[MAX_TOKEN_BYTES];
+    for(int n = 0; n < 10; n++)
+    {
+        size_t row = listNext(&cursor);
+        if(row == INDEX_NOT_FOUND)
+            break;
+        collationKey(bookTitle(&library.books.items[row]), key, sizeof(key));
+        if(strcmp(key, last) < 0 || strncmp(key, cursor.prefix, strlen(cursor.prefix)) != 0)
+            w->inconsistent++;
+        strcpy(last, key);
+    }
+
+    // The open loan date index, in order and one entry per open loan
+    const OpenLoans *open = &library.openLoans;
+    if(openLoanDateBound(INT32_MAX) != open->count)
+        w->inconsistent++;
+    for(size_t i = 1; i < open->count && i < 10; i++)
+    {
+        if(open->byDate[i - 1].borrowDay > open->byDate[i].borrowDay)
+            w->inconsistent++;
+    }
+    endRead();
+
+    freeIdList(&ids);
+    w->reads++;
 }
 
 /**
- * Writes the borrow data from the array to the file.
+ * One writer step: borrow a random book, or return it if it is on loan.
+ * Every eighth step instead adds or deletes a book past STRESS_BOOKS, so
+ * the sorted views change under the readers.
  */
-void saveBorrows(const Borrow borrows[], int count)
+static void stressWrite(StressWorker *w)
 {
-    FILE *fp = fopen(BORROWS_FILE, "w");
-    if (fp == NULL)
+    char member[12];
+    if(rand_r(&w->seed) % 8 == 0)
     {
-        printf("Failed to write borrow records to file!\n");
+        char title[64];
+        int extra = STRESS_BOOKS + 1 + (int)(rand_r(&w->seed) % STRESS_BOOKS);
+        snprintf(title, sizeof(title), "Kitap söz%u", rand_r(&w->seed) % STRESS_WORDS);
+        if(libAddBook(extra, title, "Yazar") == LIB_ERR_EXISTS)
+            libDeleteBook(extra);
         return;
     }
 
-    for(int i = 0; i < count; i++)
+    int id = 1 + (int)(rand_r(&w->seed) % STRESS_BOOKS);
+    generateMemberID(rand_r(&w->seed) % STRESS_MEMBERS, member);
+
+    LibStatus status = libBorrowBook(id, member, "01/02/2024");
+    if(status == LIB_OK)
+        w->borrowed++;
+    else if(status == LIB_ERR_BORROWED && libReturnBook(id, "02/02/2024") == LIB_OK)
+        w->returned++;
+}
+
+static void *stressThread(void *arg)
+{
+    StressWorker *w = arg;
+    if(w->writer)
+    {
+        for(int i = 0; i < STRESS_WRITES; i++)
+            stressWrite(w);
+    }
+    else
     {
-        fprintf(fp, "%d|%s|%s|%s\n",
-                borrows[i].bookID,
-                borrows[i].memberID,
-                borrows[i].borrowDate,
-                borrows[i].returnDate);
+        while(!*w->stop && nowSeconds() < w->until)
+            stressRead(w);
     }
+    return NULL;
+}
 
-    fclose(fp);
+/**
+ * Checks that the store agrees with itself after concurrent writes: the
+ * borrow table, open loan index, member loan counts and book statuses.
+ * Returns the number of open loans, or -1 if something disagrees.
+ */
+static long stressCheckStore(size_t expectBorrows, size_t expectOpen)
+{
+    size_t borrowedBooks = 0, memberOpen = 0;
+    for(size_t i = 0; i < library.books.count; i++)
+        borrowedBooks += (library.books.items[i].status == 0);
+    for(size_t i = 0; i < library.memberLoans.count; i++)
+        memberOpen += library.memberLoans.lists[i].open;
+
+    printf("  borrow records %zu (expected %zu), open loans %zu (expected %zu), "
+           "borrowed books %zu, member open loans %zu\n",
+           library.borrows.count, expectBorrows, library.openLoans.count, expectOpen,
+           borrowedBooks, memberOpen);
+
+    if(library.borrows.count != expectBorrows || library.openLoans.count != expectOpen ||
+       borrowedBooks != expectOpen || memberOpen != expectOpen)
+        return -1;
+    return (long)expectOpen;
 }
 
 /**
- * Borrows a book for a member, provided the book is available.
+ * Runs the concurrency stress test. Returns the process exit code.
  */
-void borrowBook()
+int runStressTest(int threads)
 {
-    Book   books[MAX_BOOKS];
-    Member members[MAX_MEMBERS];
-    Borrow borrows[MAX_BORROWS];
+    if(threads < 2)
+        threads = 2;
 
-    int bookCount   = loadBooks(books);
-    int memberCount = loadMembers(members);
-    int borrowCount = loadBorrows(borrows);
+    mkdir(STRESS_DIR, 0755);
+    if(chdir(STRESS_DIR) != 0)
+    {
+        printf("Cannot enter %s!\n", STRESS_DIR);
+        return 1;
+    }
+    removeDataFiles();
 
-    int bookID;
-    char memberID[12];
-    printf("Enter the ID of the book to borrow: ");
-    scanf("%d", &bookID);
-    clearInputBuffer();
+    // A library whose titles share a small vocabulary, so searches find books
+    loadLibrary();
+    library.deferCommit = 1;
+    unsigned seed = 1;
+    for(int id = 1; id <= STRESS_BOOKS; id++)
+    {
+        char title[64], author[32];
+        snprintf(title, sizeof(title), "Kitap söz%u söz%u", rand_r(&seed) % STRESS_WORDS, rand_r(&seed) % STRESS_WORDS);
+        snprintf(author, sizeof(author), "Yazar söz%u", rand_r(&seed) % STRESS_WORDS);
+        libAddBook(id, title, author);
+    }
+    for(unsigned i = 0; i < STRESS_MEMBERS; i++)
+    {
+        char id[12];
+        generateMemberID(i, id);
+        libAddMember(id, "Üye", "555");
+    }
+    commitLog();
+    library.deferCommit = 0;
+    compactLibrary();
+    printf("Stress library: %d books, %d members in %s/\n", STRESS_BOOKS, STRESS_MEMBERS, STRESS_DIR);
 
-    // Check if the book exists
-    int bookIndex = -1;
-    for(int i = 0; i < bookCount; i++)
+    StressWorker *workers = calloc((size_t)threads, sizeof(StressWorker));
+    pthread_t *ids = calloc((size_t)threads, sizeof(pthread_t));
+    volatile int stop = 0;
+    int failed = 0;
+
+    // 1. Read scaling
+    printf("\n1. Read scaling\n");
+    double single = 0;
+    for(int n = 1; n <= threads; n = (n * 2 > threads && n < threads) ? threads : n * 2)
     {
-        if(books[i].ID == bookID)
+        double until = nowSeconds() + STRESS_SECONDS;
+        for(int i = 0; i < n; i++)
         {
-            bookIndex = i;
-            break;
+            workers[i] = (StressWorker){ .seed = (unsigned)i + 1, .until = until, .stop = &stop };
+            pthread_create(&ids[i], NULL, stressThread, &workers[i]);
         }
+        size_t reads = 0;
+        for(int i = 0; i < n; i++)
+        {
+            pthread_join(ids[i], NULL);
+            reads += workers[i].reads;
+        }
+        double rate = reads / STRESS_SECONDS;
+        if(n == 1)
+            single = rate;
+        printf("  %2d reader(s): %10.0f reads/sec  (%.2fx)\n", n, rate, rate / single);
     }
-    if(bookIndex == -1)
+
+    // 2. Concurrent writers and readers in one process
+    int writers = threads / 2;
+    printf("\n2. %d writer and %d reader thread(s)\n", writers, threads - writers);
+    double start = nowSeconds();
+    for(int i = 0; i < threads; i++)
     {
-        printf("No book found with this ID!\n");
-        return;
+        workers[i] = (StressWorker){ .seed = 100u + (unsigned)i, .writer = i < writers,
+                                     .until = start + 3600, .stop = &stop };
+        pthread_create(&ids[i], NULL, stressThread, &workers[i]);
     }
-    // Check if the book is already borrowed
-    if(books[bookIndex].status == 0)
+    size_t borrowed = 0, returned = 0, reads = 0, inconsistent = 0;
+    for(int i = 0; i < writers; i++)
+        pthread_join(ids[i], NULL);
+    stop = 1;
+    for(int i = 0; i < threads; i++)
     {
-        printf("This book is already borrowed!\n");
-        return;
+        if(i >= writers)
+            pthread_join(ids[i], NULL);
+        borrowed     += workers[i].borrowed;
+        returned     += workers[i].returned;
+        reads        += workers[i].reads;
+        inconsistent += workers[i].inconsistent;
     }
+    double elapsed = nowSeconds() - start;
+    printf("  %zu borrows, %zu returns, %zu reads in %.2f s (%.0f writes/sec); %zu inconsistent reads\n",
+           borrowed, returned, reads, elapsed, (borrowed + returned) / elapsed, inconsistent);
 
-    printf("Enter the TC ID Number (11 digits) of the member borrowing the book: ");
-    fgets(memberID, sizeof(memberID), stdin);
-    memberID[strcspn(memberID, "\n")] = '\0';
+    long open = stressCheckStore(borrowed, borrowed - returned);
+    if(open < 0 || inconsistent > 0)
+        failed = 1;
 
-    // Check if the member exists
-    int memberIndex = -1;
-    for(int i = 0; i < memberCount; i++)
+    // The same state must come back from the data files and the log
+    freeLibrary();
+    loadLibrary();
+    printf("  after reload:\n");
+    if(stressCheckStore(borrowed, borrowed - returned) < 0)
+        failed = 1;
+    size_t baseBorrows = library.borrows.count, baseOpen = library.openLoans.count;
+    freeLibrary();
+
+    // 3. Several desk processes on the same files
+    printf("\n3. %d desk processes\n", STRESS_DESKS);
+    fflush(stdout);
+    int pipes[STRESS_DESKS][2];
+    pid_t pids[STRESS_DESKS];
+    start = nowSeconds();
+    for(int d = 0; d < STRESS_DESKS; d++)
     {
-        if(strcmp(members[i].ID, memberID) == 0)
+        if(pipe(pipes[d]) != 0 || (pids[d] = fork()) < 0)
         {
-            memberIndex = i;
-            break;
+            printf("Cannot start desk process!\n");
+            return 1;
         }
+        if(pids[d] == 0)
+        {
+            StressWorker w = { .seed = 1000u + (unsigned)d, .writer = 1 };
+            loadLibrary();
+            for(int i = 0; i < STRESS_DESK_OPS; i++)
+                stressWrite(&w);
+            freeLibrary();
+            size_t counts[2] = { w.borrowed, w.returned };
+            ssize_t written = write(pipes[d][1], counts, sizeof(counts));
+            _exit(written == (ssize_t)sizeof(counts) ? 0 : 1);
+        }
+        close(pipes[d][1]);
     }
-    if(memberIndex == -1)
+    borrowed = returned = 0;
+    for(int d = 0; d < STRESS_DESKS; d++)
     {
-        printf("No member found with this ID!\n");
-        return;
+        size_t counts[2] = {0, 0};
+        int status = 0;
+        if(read(pipes[d][0], counts, sizeof(counts)) != (ssize_t)sizeof(counts))
+            failed = 1;
+        close(pipes[d][0]);
+        waitpid(pids[d], &status, 0);
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+        borrowed += counts[0];
+        returned += counts[1];
     }
+    elapsed = nowSeconds() - start;
+    printf("  %zu borrows, %zu returns in %.2f s\n", borrowed, returned, elapsed);
 
-    // Prepare a new borrow record
-    Borrow newBorrow;
-    newBorrow.bookID = bookID;
-    strcpy(newBorrow.memberID, memberID);
+    loadLibrary();
+    if(stressCheckStore(baseBorrows + borrowed, baseOpen + borrowed - returned) < 0)
+        failed = 1;
+    freeLibrary();
 
-    printf("Enter borrow date (dd/mm/yyyy): ");
-    fgets(newBorrow.borrowDate, sizeof(newBorrow.borrowDate), stdin);
-    newBorrow.borrowDate[strcspn(newBorrow.borrowDate, "\n")] = '\0';
-
-    // Return date can initially be blank or set to "-" as a placeholder
-    strcpy(newBorrow.returnDate, "-");
+    free(workers);
+    free(ids);
+    removeDataFiles();
+    if(chdir("..") == 0)
+        rmdir(STRESS_DIR);
 
-    // Add to the borrows array
-    borrows[borrowCount++] = newBorrow;
-
-    // Update the book status
-    books[bookIndex].status = 0;
+    printf("\n%s\n", failed ? "Stress test FAILED: updates were lost or seen half-done!" : "Stress test passed.");
+    return failed ? 1 : 0;
+}
 
-    // Save to files
-    saveBorrows(borrows, borrowCount);
-    saveBooks(books, bookCount);
+/*
+    -------------------------
+    HELPER FUNCTIONS
+    -------------------------
+*/
 
-    printf("Book borrowing operation successful!\n");
+/**
+ * Validates the member's ID number (should be 11 digits long).
+ */
+int isValidMemberID(const char *id)
+{
+    if(strlen(id) != 11) return 0;
+    for(int i = 0; i < 11; i++)
+    {
+        if(!isdigit((unsigned char)id[i]))
+            return 0;
+    }
+    return 1;
 }
 
 /**
- * Returns a borrowed book and updates the records.
+ * Converts a member ID to the number it spells, the key members and
+ * borrow records are stored and compared by. Every valid ID has exactly
+ * 11 digits, so the conversion is exact both ways.
+ * Returns MEMBER_NONE if the ID is not valid.
  */
-void returnBook()
+uint64_t memberKey(const char *id)
 {
-    Book   books[MAX_BOOKS];
-    Borrow borrows[MAX_BORROWS];
-
-    int bookCount   = loadBooks(books);
-    int borrowCount = loadBorrows(borrows);
-
-    int bookID;
-    printf("Enter the ID of the book to return: ");
-    scanf("%d", &bookID);
-    clearInputBuffer();
+    if(!isValidMemberID(id))
+        return MEMBER_NONE;
+    uint64_t key = 0;
+    for(int i = 0; i < 11; i++)
+        key = key * 10 + (uint64_t)(id[i] - '0');
+    return key;
+}
 
-    // Find the active borrow record
-    int borrowIndex = -1;
-    for(int i = 0; i < borrowCount; i++)
+/**
+ * Writes a member key back as its 11-digit ID.
+ */
+void formatMemberKey(uint64_t key, char id[12])
+{
+    for(int i = 10; i >= 0; i--)
     {
-        if(borrows[i].bookID == bookID && strcmp(borrows[i].returnDate, "-") == 0)
-        {
-            borrowIndex = i;
-            break;
-        }
+        id[i] = (char)('0' + key % 10);
+        key /= 10;
     }
-    if(borrowIndex == -1)
+    id[11] = '\0';
+}
+
+/**
+ * Clears the input buffer after using scanf, etc.
+ */
+void clearInputBuffer()
+{
+    int c;
+    while((c = getchar()) != '\n' && c != EOF) { }
+}
+
+/**
+ * Reads one line of user input without the trailing \n. If the line does
+ * not fit, the rest of it is discarded so it does not leak into the next
+ * prompt.
+ */
+void readLine(char *buf, size_t size)
+{
+    if(fgets(buf, (int)size, stdin) == NULL)
     {
-        printf("No active borrow record found for this book!\n");
+        buf[0] = '\0';
         return;
     }
 
-    // Ask for return date
-    printf("Enter return date (dd/mm/yyyy): ");
-    fgets(borrows[borrowIndex].returnDate, sizeof(borrows[borrowIndex].returnDate), stdin);
-    borrows[borrowIndex].returnDate[strcspn(borrows[borrowIndex].returnDate, "\n")] = '\0';
+    size_t len = strcspn(buf, "\n");
+    if(buf[len] == '\n')
+        buf[len] = '\0';
+    else
+        clearInputBuffer();
+}
 
-    // Update book status
-    for(int i = 0; i < bookCount; i++)
+/**
+ * Splits a '|'-delimited line in place.
+ * Stores up to maxFields field pointers and returns the number of fields.
+ */
+int splitFields(char *line, char *fields[], int maxFields)
+{
+    int n = 0;
+    while(n < maxFields)
     {
-        if(books[i].ID == bookID)
-        {
-            books[i].status = 1;
+        fields[n++] = line;
+        char *sep = strchr(line, '|');
+        if(sep == NULL)
             break;
-        }
+        *sep = '\0';
+        line = sep + 1;
     }
+    return n;
+}
 
-    // Save changes
-    saveBorrows(borrows, borrowCount);
-    saveBooks(books, bookCount);
+/**
+ * Copies a string into a fixed-size buffer, truncating if necessary.
+ */
+void copyString(char *dst, size_t size, const char *src)
+{
+    size_t len = strlen(src);
+    if(len >= size)
+        len = size - 1;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
 
-    printf("Book return operation successful!\n");
+/**
+ * Returns 1 if the given path exists.
+ */
+int fileExists(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0;
 }
 
 /**
- * Lists all borrow records.
+ * Parses a dd/mm/yyyy date into a day number (days since 01/01/1970).
+ * Returns 0 on success, -1 if the text is not a real calendar date.
  */
-void listBorrows()
+int parseDate(const char *text, int32_t *day)
 {
-    Borrow borrows[MAX_BORROWS];
-    int count = loadBorrows(borrows);
+    static const int monthDays[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
 
-    if(count == 0)
+    if(strlen(text) != 10 || text[2] != '/' || text[5] != '/')
+        return -1;
+    for(int i = 0; i < 10; i++)
     {
-        printf("No borrow records found.\n");
-        return;
+        if(i != 2 && i != 5 && !isdigit((unsigned char)text[i]))
+            return -1;
     }
 
-    printf("\n--- All Borrow Records ---\n");
-    for(int i = 0; i < count; i++)
-    {
-        printf("BookID: %d | MemberID: %s | Borrowed: %s | Returned: %s\n",
-               borrows[i].bookID,
-               borrows[i].memberID,
-               borrows[i].borrowDate,
-               borrows[i].returnDate);
-    }
-}
+    int d = (text[0] - '0') * 10 + (text[1] - '0');
+    int m = (text[3] - '0') * 10 + (text[4] - '0');
+    int y = (text[6] - '0') * 1000 + (text[7] - '0') * 100 + (text[8] - '0') * 10 + (text[9] - '0');
+    int leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    if(y == 0 || m < 1 || m > 12 || d < 1 || d > monthDays[m - 1] + (m == 2 && leap))
+        return -1;
 
-/*
-    -------------------------
-    HELPER FUNCTIONS
-    -------------------------
-*/
+    // Days from civil date: count from 1 March so the leap day ends the year
+    int yy  = (m <= 2) ? y - 1 : y;
+    int era = yy / 400;
+    int yoe = yy - era * 400;
+    int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    *day = era * 146097 + doe - 719468;
+    return 0;
+}
 
 /**
- * Validates the member's ID number (should be 11 digits long).
+ * Writes a day number as dd/mm/yyyy, or "-" for DATE_OPEN.
  */
-int isValidMemberID(const char *id)
+void formatDate(int32_t day, char out[11])
 {
-    if(strlen(id) != 11) return 0;
-    for(int i = 0; i < 11; i++)
+    if(day == DATE_OPEN)
     {
-        if(!isdigit((unsigned char)id[i]))
-            return 0;
+        strcpy(out, "-");
+        return;
     }
-    return 1;
+
+    // Civil date from day number (inverse of parseDate)
+    int z   = day + 719468;
+    int era = (z >= 0 ? z : z - 146096) / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp  = (5 * doy + 2) / 153;
+    int d   = doy - (153 * mp + 2) / 5 + 1;
+    int m   = (mp < 10) ? mp + 3 : mp - 9;
+    int y   = yoe + era * 400 + (m <= 2);
+    snprintf(out, 11, "%02u/%02u/%04u", (unsigned)d % 100u, (unsigned)m % 100u, (unsigned)y % 10000u);
 }
 
 /**
- * Clears the input buffer after using scanf, etc.
+ * Prints the command line options.
  */
-void clearInputBuffer()
+void printUsage(const char *program)
 {
-    int c;
-    while((c = getchar()) != '\n' && c != EOF) { }
+    printf("Usage: %s [--loan-limit N] [option]\n", program);
+    printf("  --loan-limit N\n");
+    printf("                Books a member may have on loan at once (default: no limit)\n");
+    printf("  (no option)   Start the interactive menu\n");
+    printf("  --to-binary   Convert the .txt data files to the binary format\n");
+    printf("  --to-text     Convert the binary data files back to .txt files\n");
+    printf("  --checkpoint  Write a snapshot of the loaded store for fast restarts\n");
+    printf("  --archive [--no-compress]\n");
+    printf("                Move returned loans into yearly archive segments under archive/\n");
+    printf("  --batch [file] [--commit-every N]\n");
+    printf("                Run commands from a file (or stdin) without the menu\n");
+    printf("  --serve [socket] [--commit-window us]\n");
+    printf("                Serve batch commands over a Unix domain socket (default %s)\n", SERVER_SOCKET);
+    printf("  --loadgen [--socket path] [--connections N] [--requests N] [--depth N]\n");
+    printf("            [--books N] [--members N] [--writes PCT]\n");
+    printf("                Measure server throughput and latency\n");
+    printf("  --generate <books> [members] [borrows]\n");
+    printf("                Write a generated library to the data files here\n");
+    printf("  --bench [records...]\n");
+    printf("                Time every operation on generated libraries, JSON on stdout\n");
+    printf("  --import-books <file>\n");
+    printf("                Import books from a CSV/TSV file (ID, title, author)\n");
+    printf("  --import-members <file>\n");
+    printf("                Import members from a CSV/TSV file (TC ID, name, phone)\n");
+    printf("  --export <books|members|borrows> [file] [key=value...]\n");
+    printf("                Write the matching records as data file lines (default stdout)\n");
+    printf("  --analytics [--threads N] [--top N] [from] [to]\n");
+    printf("                Most borrowed books, busiest members, loans per month, loan length\n");
+    printf("  --bench-parse [file]\n");
+    printf("                Compare fscanf and streaming parser speed on a books file\n");
+    printf("  --stress [threads]\n");
+    printf("                Run the multi-thread/multi-desk test in a scratch directory\n");
+}
+
+/**
+ * Returns a monotonic timestamp in seconds.
+ */
+double nowSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }